@@ -0,0 +1,129 @@
+// Call overhead benchmark: calls per second for a small function with and
+// without inlining, a larger function that is never inlined, and tail and
+// non-tail recursion.
+//
+//   call_bench [repetitions]
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "evaluvator/evaluator.h"
+#include "runtime/output.h"
+#include "semantics/semantic.h"
+#include "semantics/range_analysis.h"
+#include "semantics/frame_layout.h"
+#include "optimizer/inliner.h"
+#include "optimizer/loop_optimizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+struct Workload {
+    const char* name;
+    const char* source;
+    long long calls; // Function calls per run, counted before inlining
+    bool inlining;
+};
+
+static const char* smallFunction =
+    "fn scale(x: i32, k: i32) -> i32 {\n"
+    "    return x * k + 1\n"
+    "}\n"
+    "let total = 0\n"
+    "for i in range(50000) {\n"
+    "    total = total + scale(i, 3) % 7\n"
+    "}\n"
+    "print total\n";
+
+static const Workload workloads[] = {
+    {"small function, not inlined", smallFunction, 50000, false},
+    {"small function, inlined", smallFunction, 50000, true},
+    {"two-statement function",
+     "fn clamp(x: i32, hi: i32) -> i32 {\n"
+     "    if x > hi {\n"
+     "        return hi\n"
+     "    }\n"
+     "    return x\n"
+     "}\n"
+     "let total = 0\n"
+     "for i in range(50000) {\n"
+     "    total = total + clamp(i % 100, 50)\n"
+     "}\n"
+     "print total\n",
+     50000, true},
+    {"tail recursion",
+     "fn count(n: i32, acc: i32) -> i32 {\n"
+     "    if n == 0 {\n"
+     "        return acc\n"
+     "    }\n"
+     "    return count(n - 1, acc + n % 3)\n"
+     "}\n"
+     "print count(100000, 0)\n",
+     100001, true},
+    {"non-tail recursion",
+     "fn fib(n: i32) -> i32 {\n"
+     "    if n < 2 {\n"
+     "        return n\n"
+     "    }\n"
+     "    return fib(n - 1) + fib(n - 2)\n"
+     "}\n"
+     "print fib(20)\n",
+     21891, true},
+};
+
+static double runOnce(const Workload& workload) {
+    string source = workload.source;
+    Lexer lexer(source);
+    Parser parser(lexer);
+    vector<unique_ptr<Stmt>> program = parser.parseProgram();
+
+    SymbolTable semanticSymbols;
+    SemanticAnalyzer semanticAnalyzer(semanticSymbols);
+    semanticAnalyzer.analyze(program);
+    if (workload.inlining) {
+        Inliner inliner;
+        inliner.inlineCalls(program);
+    }
+    LoopOptimizer loopOptimizer;
+    loopOptimizer.optimize(program);
+    RangeAnalyzer rangeAnalyzer;
+    rangeAnalyzer.analyze(program);
+    FrameLayout frameLayout;
+    frameLayout.layout(program);
+
+    Evaluator evaluator;
+    auto begin = chrono::steady_clock::now();
+    evaluator.evalProgram(program);
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    int repetitions = argc > 1 ? atoi(argv[1]) : 5;
+    if (repetitions <= 0) {
+        cerr << "Usage: " << argv[0] << " [repetitions]\n";
+        return 1;
+    }
+
+    // Programs print their result; keep that out of the report
+    ostringstream sink;
+    streambuf* console = cout.rdbuf();
+
+    cerr << left << setw(32) << "workload" << right << setw(16) << "calls/s" << "\n";
+    for (const Workload& workload : workloads) {
+        double best = 0.0;
+        for (int i = 0; i < repetitions; ++i) {
+            standardOutput().setTarget(sink.rdbuf());
+            double seconds = runOnce(workload);
+            standardOutput().setTarget(console);
+            sink.str("");
+            double rate = workload.calls / seconds;
+            if (rate > best) best = rate;
+        }
+        cerr << left << setw(32) << workload.name << right << fixed << setprecision(0) << setw(16) << best
+             << "\n" << defaultfloat;
+    }
+    return 0;
+}
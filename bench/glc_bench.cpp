@@ -0,0 +1,245 @@
+// Front-end and evaluator throughput on generated programs. Each workload is
+// generated at the requested scale, then lexed, parsed, analyzed and run
+// separately, keeping the best of several repetitions. Results are printed
+// as JSON so runs on different commits can be compared.
+//
+//   glc_bench [--scale N] [--repetitions R] [--emit DIR]
+//
+// --emit writes the generated programs to DIR as <workload>.g instead of
+// measuring them.
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "evaluvator/evaluator.h"
+#include "runtime/output.h"
+#include "semantics/semantic.h"
+#include "semantics/const_eval.h"
+#include "semantics/range_analysis.h"
+#include "semantics/frame_layout.h"
+#include "optimizer/inliner.h"
+#include "optimizer/loop_optimizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+struct Workload {
+    const char* name;
+    string (*generate)(int scale);
+};
+
+// `scale` lets, each reading the one before
+static string generateLets(int scale) {
+    ostringstream out;
+    out << "let v0 = 1\n";
+    for (int i = 1; i < scale; ++i) {
+        out << "let v" << i << " = v" << i - 1 << " * 3 % 1000 + " << i % 17 << "\n";
+    }
+    out << "print v" << scale - 1 << "\n";
+    return out.str();
+}
+
+// Expressions nested 32 deep, scale / 8 of them
+static string generateDeepExpressions(int scale) {
+    ostringstream out;
+    int count = max(1, scale / 8);
+    for (int i = 0; i < count; ++i) {
+        string expr = to_string(i % 100);
+        for (int depth = 0; depth < 32; ++depth) {
+            switch (depth % 3) {
+                case 0: expr = "(" + expr + " + " + to_string(depth + 1) + ")"; break;
+                case 1: expr = "(" + expr + " * 3)"; break;
+                default: expr = "(" + expr + " % 97)"; break;
+            }
+        }
+        out << "let e" << i << " = " << expr << "\n";
+    }
+    out << "print e" << count - 1 << "\n";
+    return out.str();
+}
+
+// Ten list literals of `scale` elements each, summed
+static string generateListLiterals(int scale) {
+    ostringstream out;
+    for (int list = 0; list < 10; ++list) {
+        out << "let l" << list << " = [";
+        for (int i = 0; i < scale; ++i) {
+            out << (i ? ", " : "") << (i * 7 + list) % 1000;
+        }
+        out << "]\n";
+        out << "print l" << list << ".sum()\n";
+    }
+    return out.str();
+}
+
+// Slicing and string methods, straight-line and in a loop of `scale` passes
+static string generateStrings(int scale) {
+    ostringstream out;
+    out << "let text = \"the quick brown fox jumps over the lazy dog\"\n";
+    for (int i = 0; i < max(1, scale / 4); ++i) {
+        int start = i % 30;
+        out << "let s" << i << " = text[" << start << ":" << start + 10 << "]." << (i % 2 ? "upper" : "lower")
+            << "()\n";
+    }
+    out << "let word = \"\"\n"
+        << "let hits = 0\n"
+        << "for i in range(" << scale << ") {\n"
+        << "    word = text[i % 30:i % 30 + 8]\n"
+        << "    if word.upper().contains(\"O\") {\n"
+        << "        hits = hits + 1\n"
+        << "    }\n"
+        << "    hits = hits + word.len()\n"
+        << "}\n"
+        << "print hits\n";
+    return out.str();
+}
+
+static const Workload workloads[] = {
+    {"lets", generateLets},
+    {"deep_expressions", generateDeepExpressions},
+    {"list_literals", generateListLiterals},
+    {"strings", generateStrings},
+};
+
+static double timeOnce(const function<void()>& body) {
+    auto begin = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+static vector<unique_ptr<Stmt>> parse(const string& source) {
+    Lexer lexer(source);
+    Parser parser(lexer);
+    return parser.parseProgram();
+}
+
+static void analyze(vector<unique_ptr<Stmt>>& program) {
+    SymbolTable symbols;
+    SemanticAnalyzer analyzer(symbols);
+    analyzer.analyze(program);
+}
+
+// The rest of the pipeline glc runs before evaluation
+static void optimize(vector<unique_ptr<Stmt>>& program) {
+    ConstEvaluator constEvaluator;
+    constEvaluator.evaluate(program);
+    Inliner inliner;
+    inliner.inlineCalls(program);
+    LoopOptimizer loopOptimizer;
+    loopOptimizer.optimize(program);
+    RangeAnalyzer rangeAnalyzer;
+    rangeAnalyzer.analyze(program);
+    FrameLayout frameLayout;
+    frameLayout.layout(program);
+}
+
+static size_t countStatements(const vector<unique_ptr<Stmt>>& body) {
+    size_t count = 0;
+    for (const auto& stmt : body) {
+        count++;
+        if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            count += countStatements(whileStmt->body);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            count += countStatements(forStmt->body);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            count += countStatements(ifStmt->then_body) + countStatements(ifStmt->else_body);
+        } else if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+            count += countStatements(fn->body);
+        }
+    }
+    return count;
+}
+
+static void printPhase(const char* name, double seconds, double bytes, double items, const char* itemName) {
+    cout << "\"" << name << "\": {\"seconds\": " << seconds << ", \"mb_per_s\": " << bytes / seconds / 1e6
+         << ", \"" << itemName << "_per_s\": " << items / seconds << "}";
+}
+
+int main(int argc, char** argv) {
+    int scale = 2000;
+    int repetitions = 5;
+    string emitDir;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (arg == "--emit" && i + 1 < argc) {
+            emitDir = argv[++i];
+        } else {
+            scale = 0;
+            break;
+        }
+    }
+    if (scale <= 0 || repetitions <= 0) {
+        cerr << "Usage: " << argv[0] << " [--scale N] [--repetitions R] [--emit DIR]\n";
+        return 1;
+    }
+
+    if (!emitDir.empty()) {
+        for (const Workload& workload : workloads) {
+            string path = emitDir + "/" + workload.name + ".g";
+            ofstream file(path);
+            file << workload.generate(scale);
+            if (!file) {
+                cerr << "Error: Could not write " << path << "\n";
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Programs print their result; keep that out of the report
+    ostringstream sink;
+    streambuf* console = cout.rdbuf();
+
+    cout << "{\"scale\": " << scale << ", \"repetitions\": " << repetitions << ", \"workloads\": [";
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w) {
+        const Workload& workload = workloads[w];
+        string source = workload.generate(scale);
+
+        size_t tokens = 0;
+        size_t statements = 0;
+        double best[4] = {1e30, 1e30, 1e30, 1e30};
+        for (int i = 0; i < repetitions; ++i) {
+            best[0] = min(best[0], timeOnce([&] {
+                Lexer lexer(source);
+                tokens = 1;
+                while (lexer.nextToken().kind != TokenKind::EndOfFile) tokens++;
+            }));
+
+            vector<unique_ptr<Stmt>> program;
+            best[1] = min(best[1], timeOnce([&] { program = parse(source); }));
+            statements = countStatements(program);
+            best[2] = min(best[2], timeOnce([&] { analyze(program); }));
+
+            optimize(program);
+            Evaluator evaluator;
+            standardOutput().setTarget(sink.rdbuf());
+            best[3] = min(best[3], timeOnce([&] { evaluator.evalProgram(program); }));
+            standardOutput().setTarget(console);
+            sink.str("");
+        }
+
+        double bytes = (double)source.size();
+        cout << (w ? ", " : "") << "{\"name\": \"" << workload.name << "\", \"source_bytes\": " << source.size()
+             << ", \"tokens\": " << tokens << ", \"statements\": " << statements << ", ";
+        printPhase("lex", best[0], bytes, tokens, "tokens");
+        cout << ", ";
+        // Includes the lexing the parser does as it goes
+        printPhase("parse", best[1], bytes, statements, "statements");
+        cout << ", ";
+        printPhase("analyze", best[2], bytes, statements, "statements");
+        cout << ", ";
+        cout << "\"evaluate\": {\"seconds\": " << best[3] << "}}";
+    }
+    cout << "]}\n";
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Loop benchmark: runs a few loop-heavy programs with the loop optimizer off
+// and on and reports iterations per second for each.
+//
+//   loop_bench [repetitions]
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "evaluvator/evaluator.h"
+#include "runtime/output.h"
+#include "semantics/semantic.h"
+#include "semantics/range_analysis.h"
+#include "semantics/frame_layout.h"
+#include "optimizer/loop_optimizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+struct Workload {
+    const char* name;
+    const char* source;
+    long long iterations; // Loop body executions per run
+};
+
+static const Workload workloads[] = {
+    {"invariant string methods",
+     "let s = \"The quick brown fox\"\n"
+     "let n = 3\n"
+     "let total = 0\n"
+     "for i in range(20000) {\n"
+     "    total = total + s.upper().len() * n + s.contains(\"fox\") + i\n"
+     "}\n"
+     "print total\n",
+     20000},
+    {"index arithmetic",
+     "let total = 0\n"
+     "for i in range(20000) {\n"
+     "    let a = i * 4\n"
+     "    let b = i * 4 + 1\n"
+     "    total = total + a + b + i * 4\n"
+     "}\n"
+     "print total\n",
+     20000},
+    {"list indexing",
+     "let xs = range(2000).map(it * 3)\n"
+     "let total = 0\n"
+     "let round = 0\n"
+     "while round < 10 {\n"
+     "    for i in range(xs.len()) {\n"
+     "        total = total + xs[i] % 7\n"
+     "    }\n"
+     "    round = round + 1\n"
+     "}\n"
+     "print total\n",
+     20000},
+    {"nested loops",
+     "let width = 150\n"
+     "let height = 150\n"
+     "let total = 0\n"
+     "for y in range(height) {\n"
+     "    for x in range(width) {\n"
+     "        total = total + (width * height - y * width) % 11 + x\n"
+     "    }\n"
+     "}\n"
+     "print total\n",
+     22500},
+};
+
+static double runOnce(const Workload& workload, bool optimize) {
+    string source = workload.source;
+    Lexer lexer(source);
+    Parser parser(lexer);
+    vector<unique_ptr<Stmt>> program = parser.parseProgram();
+
+    SymbolTable semanticSymbols;
+    SemanticAnalyzer semanticAnalyzer(semanticSymbols);
+    semanticAnalyzer.analyze(program);
+    if (optimize) {
+        LoopOptimizer loopOptimizer;
+        loopOptimizer.optimize(program);
+    }
+    RangeAnalyzer rangeAnalyzer;
+    rangeAnalyzer.analyze(program);
+    FrameLayout frameLayout;
+    frameLayout.layout(program);
+
+    Evaluator evaluator;
+    auto begin = chrono::steady_clock::now();
+    evaluator.evalProgram(program);
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    int repetitions = argc > 1 ? atoi(argv[1]) : 5;
+    if (repetitions <= 0) {
+        cerr << "Usage: " << argv[0] << " [repetitions]\n";
+        return 1;
+    }
+
+    // Programs print their result; keep that out of the report
+    ostringstream sink;
+    streambuf* console = cout.rdbuf();
+
+    cerr << left << setw(28) << "workload" << right << setw(16) << "off (iter/s)" << setw(16)
+         << "on (iter/s)" << setw(10) << "speedup" << "\n";
+    for (const Workload& workload : workloads) {
+        double best[2] = {0.0, 0.0};
+        for (int optimize = 0; optimize < 2; ++optimize) {
+            for (int i = 0; i < repetitions; ++i) {
+                standardOutput().setTarget(sink.rdbuf());
+                double seconds = runOnce(workload, optimize == 1);
+                standardOutput().setTarget(console);
+                sink.str("");
+                double rate = workload.iterations / seconds;
+                if (rate > best[optimize]) best[optimize] = rate;
+            }
+        }
+        cerr << left << setw(28) << workload.name << right << fixed << setprecision(0) << setw(16) << best[0]
+             << setw(16) << best[1] << setprecision(2) << setw(9) << best[1] / best[0] << "x\n"
+             << defaultfloat;
+    }
+    return 0;
+}
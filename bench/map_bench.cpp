@@ -0,0 +1,95 @@
+// Map benchmark: lookups per second in the HashMap behind map[K, V] and in
+// std::unordered_map, for vocabularies of a few sizes, looking up keys that
+// are present and keys that are not.
+//
+//   map_bench [repetitions]
+
+#include "runtime/hash_map.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Lookups per measurement, spread over the probe keys in a shuffled order
+static const size_t kLookups = 4000000;
+
+// Word-like keys of 3 to 12 characters
+static vector<string> makeKeys(size_t count, mt19937& random) {
+    uniform_int_distribution<int> length(3, 12);
+    uniform_int_distribution<int> letter('a', 'z');
+    vector<string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        string key = to_string(i) + "_";
+        int extra = length(random);
+        for (int j = 0; j < extra; ++j) key += (char)letter(random);
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+template <typename Lookup>
+static double lookupsPerSecond(const vector<string>& probes, int repetitions, Lookup lookup) {
+    double best = 0.0;
+    long long found = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < kLookups; ++i) {
+            found += lookup(probes[i % probes.size()]);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        best = max(best, kLookups / seconds);
+    }
+    // Keeps the lookups from being optimized away
+    if (found == -1) cerr << found;
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int repetitions = argc > 1 ? atoi(argv[1]) : 5;
+    if (repetitions <= 0) {
+        cerr << "Usage: " << argv[0] << " [repetitions]\n";
+        return 1;
+    }
+
+    mt19937 random(42);
+    cerr << left << setw(24) << "workload" << right << setw(18) << "HashMap/s" << setw(18) << "unordered_map/s"
+         << setw(10) << "speedup" << "\n";
+    for (size_t size : {1000, 50000, 1000000}) {
+        vector<string> keys = makeKeys(size, random);
+        HashMap<int32_t> table;
+        unordered_map<string, int32_t> standard;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            table.set(keys[i], (int32_t)i);
+            standard[keys[i]] = (int32_t)i;
+        }
+
+        vector<string> hits = keys;
+        shuffle(hits.begin(), hits.end(), random);
+        vector<string> misses = makeKeys(size, random);
+        for (string& key : misses) key += "?";
+
+        for (bool hit : {true, false}) {
+            const vector<string>& probes = hit ? hits : misses;
+            double ours = lookupsPerSecond(probes, repetitions, [&](const string& key) {
+                const int32_t* value = table.find(key);
+                return value ? *value : 0;
+            });
+            double theirs = lookupsPerSecond(probes, repetitions, [&](const string& key) {
+                auto found = standard.find(key);
+                return found != standard.end() ? found->second : 0;
+            });
+            string name = to_string(size) + " keys, " + (hit ? "hits" : "misses");
+            cerr << left << setw(24) << name << right << fixed << setprecision(0) << setw(18) << ours << setw(18)
+                 << theirs << setprecision(2) << setw(9) << ours / theirs << "x\n" << defaultfloat;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+// String benchmark: throughput of the kernels behind the string methods
+// against the std::string code they replaced, on a few megabytes of
+// word-like text. The replace baseline is the old in-place loop, which
+// moves the rest of the string on every match that changes its length.
+//
+//   string_bench [megabytes] [repetitions]
+
+#include "runtime/string_kernels.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Lowercase words of 2 to 9 letters, with `marker` after about every
+// markerEvery bytes
+static string makeText(size_t bytes, const string& marker, size_t markerEvery, mt19937& random) {
+    uniform_int_distribution<int> length(2, 9);
+    uniform_int_distribution<int> letter('a', 'z');
+    string text;
+    text.reserve(bytes + 16);
+    size_t nextMarker = markerEvery;
+    while (text.size() < bytes) {
+        int letters = length(random);
+        for (int i = 0; i < letters; ++i) text += (char)letter(random);
+        text += ' ';
+        if (text.size() >= nextMarker) {
+            text += marker;
+            text += ' ';
+            nextMarker += markerEvery;
+        }
+    }
+    return text;
+}
+
+template <typename Run>
+static double megabytesPerSecond(size_t bytes, int repetitions, Run run) {
+    double best = 0.0;
+    size_t sink = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        auto begin = chrono::steady_clock::now();
+        sink += run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        best = max(best, bytes / 1e6 / seconds);
+    }
+    // Keeps the work from being optimized away
+    if (sink == 1) cerr << sink;
+    return best;
+}
+
+static void report(const string& name, double ours, double theirs) {
+    cerr << left << setw(26) << name << right << fixed << setprecision(0) << setw(14) << ours << setw(14) << theirs
+         << setprecision(2) << setw(9) << ours / theirs << "x\n" << defaultfloat;
+}
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : 8;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+    if (megabytes <= 0 || repetitions <= 0) {
+        cerr << "Usage: " << argv[0] << " [megabytes] [repetitions]\n";
+        return 1;
+    }
+
+    mt19937 random(42);
+    const string marker = "needle";
+    string text = makeText((size_t)megabytes << 20, marker, 16384, random);
+    size_t bytes = text.size();
+    cerr << bytes / 1e6 << " MB of text, one marker per 16 KB\n";
+    cerr << left << setw(26) << "method" << right << setw(14) << "kernel MB/s" << setw(14) << "std MB/s" << setw(10)
+         << "speedup" << "\n";
+
+    report("upper",
+           megabytesPerSecond(bytes, repetitions, [&] {
+               string out(text.size(), '\0');
+               asciiUpper(text.data(), &out[0], text.size());
+               return out.size();
+           }),
+           megabytesPerSecond(bytes, repetitions, [&] {
+               string out = text;
+               transform(out.begin(), out.end(), out.begin(), ::toupper);
+               return out.size();
+           }));
+
+    // Absent needles: the whole text is searched
+    for (const string& needle : { string("#"), string("x#"), string("wq#z"), string("abcdefghijklmnop") }) {
+        report("contains \"" + needle + "\"",
+               megabytesPerSecond(bytes, repetitions, [&] { return findText(text, needle); }),
+               megabytesPerSecond(bytes, repetitions, [&] { return text.find(needle); }));
+    }
+
+    report("count \"" + marker + "\"",
+           megabytesPerSecond(bytes, repetitions, [&] { return countText(text, marker); }),
+           megabytesPerSecond(bytes, repetitions, [&] {
+               size_t count = 0;
+               for (size_t at = text.find(marker); at != string::npos; at = text.find(marker, at + marker.size())) {
+                   count++;
+               }
+               return count;
+           }));
+
+    report("split \" \"",
+           megabytesPerSecond(bytes, repetitions, [&] {
+               vector<string> parts;
+               size_t begin = 0;
+               for (size_t at = findText(text, " "); at != string::npos; at = findText(text, " ", begin)) {
+                   parts.emplace_back(text, begin, at - begin);
+                   begin = at + 1;
+               }
+               return parts.size();
+           }),
+           megabytesPerSecond(bytes, repetitions, [&] {
+               vector<string> parts;
+               size_t begin = 0;
+               for (size_t at = text.find(' '); at != string::npos; at = text.find(' ', begin)) {
+                   parts.emplace_back(text, begin, at - begin);
+                   begin = at + 1;
+               }
+               return parts.size();
+           }));
+
+    report("replace \"" + marker + "\"",
+           megabytesPerSecond(bytes, repetitions, [&] { return replaceText(text, marker, "pin").size(); }),
+           megabytesPerSecond(bytes, repetitions, [&] {
+               string out = text;
+               size_t pos = 0;
+               while ((pos = out.find(marker, pos)) != string::npos) {
+                   out.replace(pos, marker.size(), "pin");
+                   pos += 3;
+               }
+               return out.size();
+           }));
+    return 0;
+}
@@ -0,0 +1,12 @@
+let c: i32 = 1
+let total: i32 = 0
+
+fn bump() {
+    c = c + 1
+}
+
+for i in range(5) {
+    total = total + i * c + i * c
+    bump()
+}
+print(total)
@@ -0,0 +1,192 @@
+#include "exotic.h"
+#include "../driver/compile.h"
+#include "../evaluvator/evaluator.h"
+#include "../evaluvator/values.h"
+#include "../runtime/output.h"
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct exotic_program {
+    // Names in statements and layout point into it, so it goes last
+    InternTable names;
+    vector<unique_ptr<Stmt>> statements;
+    // Maps the names of globals to their ids
+    FrameLayout layout;
+};
+
+struct exotic_state {
+    const exotic_program* program;
+    StringSink sink;
+    OutputBuffer output{&sink};
+    unique_ptr<Evaluator> evaluator;
+
+    explicit exotic_state(const exotic_program* program)
+        : program(program), evaluator(make_unique<Evaluator>(output)) {}
+};
+
+static thread_local string lastError;
+
+static exotic_status fail(exotic_status status, const string& message) {
+    lastError = message;
+    return status;
+}
+
+int exotic_api_version(void) {
+    return EXOTIC_API_VERSION;
+}
+
+const char* exotic_last_error(void) {
+    return lastError.c_str();
+}
+
+exotic_status exotic_compile(const char* source, size_t length, unsigned flags, exotic_program** program) {
+    if (!source || !program) {
+        return fail(EXOTIC_INVALID_ARGUMENT, "exotic_compile needs a source and somewhere to put the program");
+    }
+    *program = nullptr;
+    CompileOptions options;
+    options.inlining = !(flags & EXOTIC_NO_INLINE);
+    options.loopOpt = !(flags & EXOTIC_NO_LOOP_OPT);
+    try {
+        auto compiled = make_unique<exotic_program>();
+        InternScope scope(compiled->names);
+        compiled->statements = compile(string(source, length), options, &compiled->layout);
+        *program = compiled.release();
+        return EXOTIC_OK;
+    } catch (const exception& error) {
+        // A CompileError, or a RuntimeError from evaluating a const
+        return fail(EXOTIC_COMPILE_ERROR, error.what());
+    }
+}
+
+void exotic_program_free(exotic_program* program) {
+    delete program;
+}
+
+exotic_state* exotic_state_new(const exotic_program* program) {
+    if (!program) {
+        fail(EXOTIC_INVALID_ARGUMENT, "exotic_state_new needs a program");
+        return nullptr;
+    }
+    return new (nothrow) exotic_state(program);
+}
+
+void exotic_state_reset(exotic_state* state) {
+    if (!state) return;
+    state->output.flush();
+    state->sink.text.clear();
+    state->evaluator = make_unique<Evaluator>(state->output);
+}
+
+void exotic_state_free(exotic_state* state) {
+    delete state;
+}
+
+exotic_status exotic_run(exotic_state* state) {
+    if (!state) {
+        return fail(EXOTIC_INVALID_ARGUMENT, "exotic_run needs a state");
+    }
+    exotic_status status = EXOTIC_OK;
+    try {
+        state->evaluator->evalProgram(state->program->statements);
+    } catch (const exception& error) {
+        state->evaluator->recover();
+        status = fail(EXOTIC_RUNTIME_ERROR, error.what());
+    }
+    state->output.flush();
+    return status;
+}
+
+const char* exotic_output(const exotic_state* state, size_t* length) {
+    if (!state) {
+        if (length) *length = 0;
+        return "";
+    }
+    if (length) *length = state->sink.text.size();
+    return state->sink.text.c_str();
+}
+
+void exotic_clear_output(exotic_state* state) {
+    if (state) state->sink.text.clear();
+}
+
+static exotic_status findGlobal(const exotic_state* state, const char* name, const Symbol*& value) {
+    if (!state || !name) {
+        return fail(EXOTIC_INVALID_ARGUMENT, "reading a global needs a state and a name");
+    }
+    // A name the program never mentions isn't added to its table
+    optional<Interned> interned = state->program->names.find(name);
+    int id = interned ? state->program->layout.findGlobal(*interned) : -1;
+    if (id < 0) {
+        return fail(EXOTIC_NOT_FOUND, string("the program has no global named ") + name);
+    }
+    value = &state->evaluator->global(id);
+    return EXOTIC_OK;
+}
+
+static exotic_type typeOf(const Symbol& value) {
+    TypeKind kind = value.type.kind;
+    if (isIntegerKind(kind)) return EXOTIC_INT;
+    if (isNumericKind(kind)) return EXOTIC_FLOAT;
+    if (kind == TypeKind::String) return EXOTIC_STRING;
+    if (kind == TypeKind::List) return EXOTIC_LIST;
+    return EXOTIC_NONE;
+}
+
+static exotic_status wrongType(const char* name, const char* wanted) {
+    return fail(EXOTIC_WRONG_TYPE, string(name) + " is not " + wanted);
+}
+
+exotic_type exotic_global_type(const exotic_state* state, const char* name) {
+    const Symbol* global;
+    return findGlobal(state, name, global) == EXOTIC_OK ? typeOf(*global) : EXOTIC_NONE;
+}
+
+exotic_status exotic_get_int(const exotic_state* state, const char* name, int64_t* value) {
+    const Symbol* global;
+    if (exotic_status status = findGlobal(state, name, global)) return status;
+    if (typeOf(*global) != EXOTIC_INT) return wrongType(name, "an integer");
+    if (value) *value = global->int_value;
+    return EXOTIC_OK;
+}
+
+exotic_status exotic_get_float(const exotic_state* state, const char* name, double* value) {
+    const Symbol* global;
+    if (exotic_status status = findGlobal(state, name, global)) return status;
+    exotic_type type = typeOf(*global);
+    if (type != EXOTIC_INT && type != EXOTIC_FLOAT) return wrongType(name, "a number");
+    if (value) *value = numericValue(*global);
+    return EXOTIC_OK;
+}
+
+exotic_status exotic_get_string(const exotic_state* state, const char* name, const char** value,
+                                size_t* length) {
+    const Symbol* global;
+    if (exotic_status status = findGlobal(state, name, global)) return status;
+    if (typeOf(*global) != EXOTIC_STRING) return wrongType(name, "a string");
+    if (value) *value = global->string_value.c_str();
+    if (length) *length = global->string_value.size();
+    return EXOTIC_OK;
+}
+
+exotic_status exotic_get_list(const exotic_state* state, const char* name, double* values, size_t capacity,
+                              size_t* length) {
+    const Symbol* global;
+    if (exotic_status status = findGlobal(state, name, global)) return status;
+    const Type* element = global->type.element;
+    if (typeOf(*global) != EXOTIC_LIST || (element && !isNumericKind(element->kind))) {
+        return wrongType(name, "a list of numbers");
+    }
+    size_t count = listLength(*global);
+    if (length) *length = count;
+    for (size_t i = 0; i < count && i < capacity; ++i) {
+        values[i] = numericValue(listElement(*global, i));
+    }
+    return EXOTIC_OK;
+}
@@ -0,0 +1,115 @@
+#ifndef EXOTIC_H
+#define EXOTIC_H
+
+/*
+ * C API of libexotic, for running .g programs inside another process.
+ *
+ * A program is compiled once and can then be run any number of times. Each
+ * run happens in a state, which holds the program's globals and the text
+ * its print statements wrote. Run in a new or reset state, a program starts
+ * from scratch; run again in the same state, it sees the globals the last
+ * run left behind. After a run, globals are read back by name.
+ *
+ *     exotic_program* program;
+ *     if (exotic_compile(source, strlen(source), 0, &program) != EXOTIC_OK) {
+ *         fprintf(stderr, "%s\n", exotic_last_error());
+ *     }
+ *     exotic_state* state = exotic_state_new(program);
+ *     if (exotic_run(state) == EXOTIC_OK) {
+ *         int64_t total;
+ *         exotic_get_int(state, "total", &total);
+ *     }
+ *     exotic_state_free(state);
+ *     exotic_program_free(program);
+ *
+ * A program is never changed by running it, so one program may run in
+ * several states at once on different threads. A state is used by one
+ * thread at a time. Errors never end the process: every call that can fail
+ * returns a status, with the message in exotic_last_error().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Changes only when existing functions change meaning */
+#define EXOTIC_API_VERSION 1
+
+typedef struct exotic_program exotic_program;
+typedef struct exotic_state exotic_state;
+
+typedef enum {
+    EXOTIC_OK = 0,
+    EXOTIC_COMPILE_ERROR,
+    EXOTIC_RUNTIME_ERROR,
+    /* The program has no top-level binding of that name */
+    EXOTIC_NOT_FOUND,
+    /* The binding holds another type than the one asked for */
+    EXOTIC_WRONG_TYPE,
+    EXOTIC_INVALID_ARGUMENT
+} exotic_status;
+
+/* A binding the program has not reached yet reads as the int 0 */
+typedef enum {
+    /* No such binding */
+    EXOTIC_NONE = 0,
+    /* i8 to i64 */
+    EXOTIC_INT,
+    /* f16 to f64 and q8 */
+    EXOTIC_FLOAT,
+    EXOTIC_STRING,
+    EXOTIC_LIST
+} exotic_type;
+
+/* Flags for exotic_compile, matching glc --no-inline and --no-loop-opt */
+#define EXOTIC_NO_INLINE 1u
+#define EXOTIC_NO_LOOP_OPT 2u
+
+/* EXOTIC_API_VERSION of the library, which may be newer than the header */
+int exotic_api_version(void);
+
+/* Message of the last call on this thread that failed */
+const char* exotic_last_error(void);
+
+exotic_status exotic_compile(const char* source, size_t length, unsigned flags, exotic_program** program);
+/* Every state of the program must be freed first */
+void exotic_program_free(exotic_program* program);
+
+exotic_state* exotic_state_new(const exotic_program* program);
+/* Forgets the globals and the output, as if the state were new */
+void exotic_state_reset(exotic_state* state);
+void exotic_state_free(exotic_state* state);
+
+/*
+ * Runs the state's program. After a runtime error the globals bound so far
+ * are kept, and the state can run again.
+ */
+exotic_status exotic_run(exotic_state* state);
+
+/* What print statements wrote in every run since the state was new or reset */
+const char* exotic_output(const exotic_state* state, size_t* length);
+void exotic_clear_output(exotic_state* state);
+
+exotic_type exotic_global_type(const exotic_state* state, const char* name);
+exotic_status exotic_get_int(const exotic_state* state, const char* name, int64_t* value);
+/* Integers are converted */
+exotic_status exotic_get_float(const exotic_state* state, const char* name, double* value);
+/* Valid until the state runs again, is reset or is freed */
+exotic_status exotic_get_string(const exotic_state* state, const char* name, const char** value,
+                                size_t* length);
+/*
+ * Copies up to capacity elements of a list of numbers into values and sets
+ * length to the length of the list, so a first call with capacity 0 sizes
+ * the buffer.
+ */
+exotic_status exotic_get_list(const exotic_state* state, const char* name, double* values, size_t capacity,
+                              size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
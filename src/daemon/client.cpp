@@ -0,0 +1,59 @@
+// Runs a program on a glc --daemon, taking the same arguments as glc. The
+// daemon writes the program's output straight to this process's stdout and
+// stderr, and its exit status becomes this process's.
+//
+//   glc_client [--socket PATH] <glc arguments>...
+
+#include "protocol.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    string socketPath = defaultSocketPath();
+    DaemonRequest request;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg.rfind("--socket=", 0) == 0) {
+            socketPath = arg.substr(9);
+        } else {
+            request.args.push_back(arg);
+        }
+    }
+    if (request.args.empty()) {
+        cerr << "Usage: " << argv[0] << " [--socket PATH] <glc arguments>...\n";
+        return 1;
+    }
+
+    char directory[PATH_MAX];
+    if (!getcwd(directory, sizeof(directory))) {
+        cerr << "Error: Could not read the working directory: " << strerror(errno) << "\n";
+        return 1;
+    }
+    request.directory = directory;
+
+    string error;
+    int socket = connectToSocket(socketPath, error);
+    if (socket < 0) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    const int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    if (!sendRequest(socket, request, fds)) {
+        cerr << "Error: could not send the request to the daemon on " << socketPath << "\n";
+        return 1;
+    }
+    int status;
+    if (!receiveStatus(socket, status)) {
+        cerr << "Error: the daemon closed the connection before the program finished\n";
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,247 @@
+#include "protocol.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char kRequestMagic[4] = {'G', 'L', 'C', 'R'};
+static const uint32_t kProtocolVersion = 1;
+// Far more than any command line
+static const uint32_t kMaxRequestBytes = 1 << 20;
+
+string defaultSocketPath() {
+    const char* socket = getenv("EXOTIC_SOCKET");
+    if (socket && *socket) {
+        return socket;
+    }
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return string(runtime) + "/glc.sock";
+    }
+    return "/tmp/glc-" + to_string(getuid()) + ".sock";
+}
+
+static bool makeAddress(const string& path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+int connectToSocket(const string& path, string& error) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        error = "socket path '" + path + "' is empty or too long";
+        return -1;
+    }
+    // Anyone can create /tmp/glc-<uid>.sock before the daemon does, and
+    // whoever listens on it gets this process's descriptors
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) {
+        error = "no glc daemon is listening on " + path + " (start one with glc --daemon)";
+        return -1;
+    }
+    if (!S_ISSOCK(info.st_mode) || info.st_uid != getuid()) {
+        error = path + " is not a socket owned by this user";
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = string("could not create a socket: ") + strerror(errno);
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "no glc daemon is listening on " + path + " (start one with glc --daemon)";
+        close(fd);
+        return -1;
+    }
+    ucred peer;
+    socklen_t length = sizeof(peer);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != getuid()) {
+        error = "the daemon on " + path + " is run by another user";
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int listenOnSocket(const string& path, string& error) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        error = "socket path '" + path + "' is empty or too long";
+        return -1;
+    }
+    string ignored;
+    int running = connectToSocket(path, ignored);
+    if (running >= 0) {
+        close(running);
+        error = "a daemon is already listening on " + path;
+        return -1;
+    }
+    // Left behind by a daemon that was killed
+    unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = string("could not create a socket: ") + strerror(errno);
+        return -1;
+    }
+    // Whoever can connect can run programs as this user
+    mode_t mask = umask(0077);
+    bool bound = bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(fd, SOMAXCONN) != 0) {
+        error = "could not listen on " + path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = read(fd, data, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+static void putString(string& out, const string& text) {
+    uint32_t length = (uint32_t)text.size();
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out += text;
+}
+
+bool sendRequest(int socket, const DaemonRequest& request, const int fds[3]) {
+    // magic | version | body size | body, where body is the directory and
+    // the arguments, each a length and its bytes
+    string body;
+    putString(body, request.directory);
+    for (const string& arg : request.args) {
+        putString(body, arg);
+    }
+    uint32_t header[2] = {kProtocolVersion, (uint32_t)body.size()};
+    string message(kRequestMagic, sizeof(kRequestMagic));
+    message.append(reinterpret_cast<const char*>(header), sizeof(header));
+    message += body;
+
+    // The descriptors travel with the first byte
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    iovec first = {const_cast<char*>(message.data()), 1};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &first;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != 1) return false;
+    return writeAll(socket, message.data() + 1, message.size() - 1);
+}
+
+bool receiveRequest(int socket, DaemonRequest& request, int fds[3]) {
+    char magic[sizeof(kRequestMagic)];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    iovec first = {magic, 1};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &first;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t got;
+    do {
+        got = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    if (got != 1) return false;
+
+    // The control buffer has room for three descriptors and no more
+    int received = 0;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds, CMSG_DATA(cmsg), received * sizeof(int));
+    }
+    auto closeFds = [&] {
+        for (int i = 0; i < received; ++i) close(fds[i]);
+    };
+    if (received != 3 || (msg.msg_flags & MSG_CTRUNC)) {
+        closeFds();
+        return false;
+    }
+
+    uint32_t header[2];
+    if (!readAll(socket, magic + 1, sizeof(magic) - 1) ||
+        memcmp(magic, kRequestMagic, sizeof(magic)) != 0 ||
+        !readAll(socket, reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != kProtocolVersion || header[1] > kMaxRequestBytes) {
+        closeFds();
+        return false;
+    }
+    string body(header[1], '\0');
+    if (!readAll(socket, &body[0], body.size())) {
+        closeFds();
+        return false;
+    }
+
+    vector<string> strings;
+    size_t at = 0;
+    while (at < body.size()) {
+        uint32_t length;
+        if (body.size() - at < sizeof(length)) break;
+        memcpy(&length, body.data() + at, sizeof(length));
+        at += sizeof(length);
+        if (body.size() - at < length) break;
+        strings.push_back(body.substr(at, length));
+        at += length;
+    }
+    if (at != body.size() || strings.empty()) {
+        closeFds();
+        return false;
+    }
+    request.directory = strings[0];
+    request.args.assign(strings.begin() + 1, strings.end());
+    return true;
+}
+
+bool sendStatus(int socket, int status) {
+    int32_t value = status;
+    return writeAll(socket, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool receiveStatus(int socket, int& status) {
+    int32_t value;
+    if (!readAll(socket, reinterpret_cast<char*>(&value), sizeof(value))) return false;
+    status = value;
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include <vector>
+
+// What glc --daemon and glc_client say to each other over a Unix domain
+// socket. The client sends one request, the command line it was given and
+// its working directory, and passes its stdin, stdout and stderr along with
+// it, so the program the daemon runs writes straight to the client's
+// terminal or pipes. When the program exits the daemon answers with its
+// exit status and closes the connection. A client that goes away first
+// takes the program with it.
+struct DaemonRequest {
+    std::string directory;
+    std::vector<std::string> args;
+};
+
+// $EXOTIC_SOCKET, else glc.sock in $XDG_RUNTIME_DIR, else /tmp/glc-<uid>.sock
+std::string defaultSocketPath();
+
+// A listening socket only the current user can connect to, or -1 with a
+// message in error. A socket file no daemon answers on is replaced.
+int listenOnSocket(const std::string& path, std::string& error);
+// A socket connected to a daemon run by the current user, or -1 with a
+// message in error. The socket file must also belong to the current user.
+int connectToSocket(const std::string& path, std::string& error);
+
+bool sendRequest(int socket, const DaemonRequest& request, const int fds[3]);
+// fds receives the client's stdin, stdout and stderr
+bool receiveRequest(int socket, DaemonRequest& request, int fds[3]);
+
+bool sendStatus(int socket, int status);
+// False if the daemon hung up without answering
+bool receiveStatus(int socket, int& status);
+
+#endif
@@ -0,0 +1,162 @@
+#include "compile.h"
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../semantics/symbol_table.h"
+#include "../semantics/semantic.h"
+#include "../semantics/range_analysis.h"
+#include "../semantics/const_eval.h"
+#include "../optimizer/inliner.h"
+#include "../optimizer/loop_optimizer.h"
+#include "../util/phase_timer.h"
+#include <iostream>
+#include <unordered_set>
+
+using namespace std;
+
+struct AstCounts {
+    uint64_t nodes = 0;
+    uint64_t locals = 0;
+    // List element types, each allocated on its own
+    unordered_set<const Type*> types;
+};
+
+static void countType(const Type& type, AstCounts& counts) {
+    for (const Type* element = type.element; element; element = element->element) {
+        counts.types.insert(element);
+    }
+}
+
+static void countExpr(const Expr* expr, AstCounts& counts) {
+    if (!expr) return;
+    counts.nodes++;
+    countType(expr->type, counts);
+    countExpr(expr->left.get(), counts);
+    countExpr(expr->right.get(), counts);
+    countExpr(expr->start.get(), counts);
+    countExpr(expr->end.get(), counts);
+    for (const auto& element : expr->elements) countExpr(element.get(), counts);
+    for (const auto& arg : expr->args) countExpr(arg.get(), counts);
+}
+
+static void countBlock(const vector<unique_ptr<Stmt>>& body, AstCounts& counts) {
+    for (const auto& stmt : body) {
+        counts.nodes++;
+        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
+            countType(letStmt->declared_type, counts);
+            countType(letStmt->storage_type, counts);
+            countExpr(letStmt->expr.get(), counts);
+        } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt.get())) {
+            countExpr(printStmt->expr.get(), counts);
+        } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt.get())) {
+            countExpr(assignStmt->expr.get(), counts);
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            countExpr(whileStmt->condition.get(), counts);
+            countBlock(whileStmt->body, counts);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            countExpr(forStmt->iterable.get(), counts);
+            countBlock(forStmt->body, counts);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            countExpr(ifStmt->condition.get(), counts);
+            countBlock(ifStmt->then_body, counts);
+            countBlock(ifStmt->else_body, counts);
+        } else if (auto returnStmt = dynamic_cast<const ReturnStmt*>(stmt.get())) {
+            countExpr(returnStmt->expr.get(), counts);
+        } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt.get())) {
+            countExpr(exprStmt->expr.get(), counts);
+        } else if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+            counts.locals += fn->frame_size;
+            countBlock(fn->body, counts);
+        }
+    }
+}
+
+vector<unique_ptr<Stmt>> compile(const string& source, const CompileOptions& options, FrameLayout* layout) {
+    PhaseTimer* phases = options.phases;
+    auto phase = [&](const char* name) {
+        if (phases) phases->start(name);
+    };
+    if (phases) {
+        // The parser lexes as it goes, so the lexer is timed on a pass of its own
+        phase("lex");
+        Lexer tokenizer(source);
+        uint64_t tokens = 1;
+        while (tokenizer.nextToken().kind != TokenKind::EndOfFile) {
+            tokens++;
+        }
+        phases->count("tokens", tokens);
+    }
+
+    phase("parse");
+    Lexer lexer(source);
+    Parser parser(lexer);
+    vector<unique_ptr<Stmt>> program = parser.parseProgram();
+    if (phases) {
+        AstCounts counts;
+        countBlock(program, counts);
+        phases->count("ast_nodes", counts.nodes);
+    }
+
+    // Semantic Analysis
+    phase("semantic");
+    SymbolTable semanticSymbols;
+    if (options.inputBinding) {
+        Symbol input;
+        input.type = listType(new Type(f64Type()));
+        semanticSymbols.set("input", input);
+    }
+    SemanticAnalyzer semanticAnalyzer(semanticSymbols);
+    semanticAnalyzer.analyze(program);
+
+    // Compile-time evaluation of const bindings
+    phase("const-eval");
+    ConstEvaluator constEvaluator;
+    constEvaluator.evaluate(program);
+
+    // Inlining of small functions
+    if (options.inlining) {
+        phase("inline");
+        Inliner inliner;
+        inliner.inlineCalls(program);
+        if (options.optReport) {
+            inliner.printReport(cerr);
+        }
+    }
+
+    // Loop optimizations
+    if (options.loopOpt) {
+        phase("loop-opt");
+        LoopOptimizer loopOptimizer;
+        loopOptimizer.optimize(program);
+        if (options.optReport) {
+            loopOptimizer.printReport(cerr);
+        }
+    }
+
+    // Storage narrowing
+    phase("range-analysis");
+    RangeAnalyzer rangeAnalyzer;
+    rangeAnalyzer.analyze(program);
+    if (options.narrowingReport) {
+        rangeAnalyzer.printReport(cerr);
+    }
+
+    // Resolve every name to a frame slot or global id
+    phase("frame-layout");
+    FrameLayout ownLayout;
+    FrameLayout& frameLayout = layout ? *layout : ownLayout;
+    if (options.inputBinding) {
+        frameLayout.declareGlobal("input");
+    }
+    frameLayout.layout(program);
+
+    if (phases) {
+        phases->stop();
+        AstCounts counts;
+        countBlock(program, counts);
+        phases->count("ast_nodes_optimized", counts.nodes);
+        phases->count("list_types", counts.types.size());
+        phases->count("globals", frameLayout.globalCount());
+        phases->count("function_locals", counts.locals);
+    }
+    return program;
+}
@@ -0,0 +1,34 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include "../parser/ast.h"
+#include "../semantics/frame_layout.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class PhaseTimer;
+
+struct CompileOptions {
+    bool inlining = true;
+    bool loopOpt = true;
+    bool optReport = false;
+    bool narrowingReport = false;
+    // Declares the global `input`, a list[f64] the caller binds before the
+    // program runs, with id kInputGlobalId
+    bool inputBinding = false;
+    // Times every pass when set
+    PhaseTimer* phases = nullptr;
+};
+
+const int kInputGlobalId = 0;
+
+// Runs the front end and every pass, leaving the program ready to evaluate.
+// Throws CompileError, or RuntimeError from evaluating a const. Global ids
+// are assigned by layout when given, so the caller can look names up in it.
+// Names go into the InternTable current on this thread, which must outlive
+// the program; see InternScope.
+std::vector<std::unique_ptr<Stmt>> compile(const std::string& source, const CompileOptions& options,
+                                           FrameLayout* layout = nullptr);
+
+#endif
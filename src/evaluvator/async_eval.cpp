@@ -0,0 +1,118 @@
+#include "evaluator.h"
+#include "../runtime/device.h"
+#include <deque>
+#include <unordered_map>
+
+using namespace std;
+
+// Asynchronous execution: every let becomes a kernel that depends on the
+// kernels producing the globals it reads, so independent bindings overlap on
+// the device. Prints go through one in-order stream to keep output ordered.
+// Any other statement is a barrier executed on the host.
+
+static void collectGlobals(const Expr* expr, vector<int>& ids) {
+    if (!expr) return;
+    if (expr->kind == ExprKind::Identifier && expr->storage == Storage::Global) {
+        ids.push_back(expr->slot);
+    }
+    collectGlobals(expr->left.get(), ids);
+    collectGlobals(expr->right.get(), ids);
+    collectGlobals(expr->start.get(), ids);
+    collectGlobals(expr->end.get(), ids);
+    for (const auto& arg : expr->args) collectGlobals(arg.get(), ids);
+    for (const auto& element : expr->elements) collectGlobals(element.get(), ids);
+}
+
+// User functions may read or assign any global, and write_async may change
+// a file another binding reads, neither of which the dependency tracking
+// above can see
+static bool callsUserFunction(const Expr* expr) {
+    if (!expr) return false;
+    if (expr->kind == ExprKind::Call && (expr->function || expr->name == "write_async")) return true;
+    if (callsUserFunction(expr->left.get()) || callsUserFunction(expr->right.get()) ||
+        callsUserFunction(expr->start.get()) || callsUserFunction(expr->end.get())) {
+        return true;
+    }
+    for (const auto& arg : expr->args) {
+        if (callsUserFunction(arg.get())) return true;
+    }
+    for (const auto& element : expr->elements) {
+        if (callsUserFunction(element.get())) return true;
+    }
+    return false;
+}
+
+void Evaluator::evalProgramAsync(const std::vector<std::unique_ptr<Stmt>>& program, Device& device) {
+    struct Binding {
+        shared_ptr<Event> producer;
+        const Symbol* value;
+    };
+    // Keyed by global id
+    unordered_map<int, Binding> bindings;
+    // Deque so slots keep their address while kernels are still writing them
+    deque<Symbol> slots;
+    Stream output(device);
+
+    auto inputsOf = [&](const Expr* expr, vector<shared_ptr<Event>>& dependencies,
+                        vector<pair<int, const Symbol*>>& inputs) {
+        vector<int> ids;
+        collectGlobals(expr, ids);
+        for (int id : ids) {
+            auto it = bindings.find(id);
+            if (it == bindings.end()) continue; // Bound before this run, read from globals
+            dependencies.push_back(it->second.producer);
+            inputs.emplace_back(id, it->second.value);
+        }
+    };
+
+    for (const auto& stmt : program) {
+        auto letStmt = dynamic_cast<const LetStmt*>(stmt.get());
+        auto printStmt = dynamic_cast<const PrintStmt*>(stmt.get());
+        if (letStmt && !callsUserFunction(letStmt->expr.get())) {
+            vector<shared_ptr<Event>> dependencies;
+            vector<pair<int, const Symbol*>> inputs;
+            inputsOf(letStmt->expr.get(), dependencies, inputs);
+
+            slots.emplace_back();
+            Symbol* out = &slots.back();
+            auto event = device.enqueue("let " + letStmt->name, [this, letStmt, inputs, out] {
+                Evaluator worker(this);
+                for (const auto& input : inputs) {
+                    worker.shadow[input.first] = *input.second;
+                }
+                Symbol result = worker.evalExpr(letStmt->expr.get());
+                if (letStmt->storageType().kind != TypeKind::Unknown) {
+                    result = worker.convertSymbol(result, letStmt->storageType());
+                }
+                *out = std::move(result);
+            }, dependencies);
+            bindings[letStmt->slot] = Binding{event, out};
+        } else if (printStmt && !callsUserFunction(printStmt->expr.get())) {
+            vector<shared_ptr<Event>> dependencies;
+            vector<pair<int, const Symbol*>> inputs;
+            inputsOf(printStmt->expr.get(), dependencies, inputs);
+
+            output.enqueue("print", [this, printStmt, inputs] {
+                Evaluator worker(this);
+                for (const auto& input : inputs) {
+                    worker.shadow[input.first] = *input.second;
+                }
+                worker.evalPrintStmt(printStmt);
+            }, dependencies);
+        } else {
+            // Control flow, assignments, functions and anything calling one
+            // run on the host once everything before them has finished
+            device.synchronize();
+            for (const auto& binding : bindings) {
+                bind(Storage::Global, binding.first, *binding.second.value);
+            }
+            bindings.clear();
+            execute(stmt.get());
+        }
+    }
+
+    device.synchronize();
+    for (const auto& binding : bindings) {
+        bind(Storage::Global, binding.first, *binding.second.value);
+    }
+}
@@ -0,0 +1,521 @@
+#include "batch.h"
+#include "evaluator.h"
+#include "../runtime/dense.h"
+#include "../runtime/output.h"
+#include "../runtime/thread_pool.h"
+#include "../util/diagnostics.h"
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+
+using namespace std;
+
+// Records per chunk: enough for the column loops to amortize their setup,
+// few enough that the columns of a chunk stay in cache
+const size_t kBatchChunk = 1024;
+
+bool readRecords(istream& in, RecordBatch& records, string& error) {
+    string line;
+    size_t lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        size_t count = 0;
+        const char* at = line.c_str();
+        while (true) {
+            while (*at == ',' || *at == ' ' || *at == '\t' || *at == '\r') at++;
+            if (!*at) break;
+            char* end;
+            double value = strtod(at, &end);
+            if (end == at || (*end && *end != ',' && *end != ' ' && *end != '\t' && *end != '\r')) {
+                size_t length = 0;
+                while (at[length] && at[length] != ',' && at[length] != ' ' && at[length] != '\t') length++;
+                error = "line " + to_string(lineNumber) + ": '" + string(at, length) + "' is not a number";
+                return false;
+            }
+            records.values.push_back(value);
+            count++;
+            at = end;
+        }
+        if (count > 0) {
+            records.offsets.push_back(records.values.size());
+        }
+    }
+    return true;
+}
+
+enum class ColumnOp {
+    Int,
+    Float,
+    // input[k] of every record
+    Input,
+    ToFloat,
+    // Float to int, as a let with an integer type converts
+    Truncate,
+    // Wraps ints to intValue bits, for i8 and i16 lets
+    Narrow,
+    RoundF32,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    And,
+    Or,
+    Neg,
+    Not
+};
+
+struct ColumnStep {
+    ColumnOp op;
+    // The operands are float columns; both operands always have one kind
+    bool floats = false;
+    int target = -1;
+    int left = -1;
+    int right = -1;
+    // Int constant, input index or Narrow's width
+    int intValue = 0;
+    double floatValue = 0.0;
+};
+
+// A program compiled to steps over columns, each holding one value per
+// record. Every expression gets a column of its own, either ints or
+// doubles, so a step is one loop over the records.
+struct ColumnProgram {
+    vector<ColumnStep> steps;
+    vector<bool> floatColumns;
+    // Columns printed, in statement order
+    vector<int> prints;
+};
+
+// Builds a ColumnProgram, giving up on anything but the straight-line
+// arithmetic it knows. Every column kind follows the evaluator: arithmetic
+// on a float and anything is f64, the rest is i32, so the output matches
+// running each record on its own digit for digit.
+class ColumnCompiler {
+public:
+    ColumnCompiler(ColumnProgram& columns, int inputId) : columns(columns), inputId(inputId) {}
+
+    bool compileProgram(const vector<unique_ptr<Stmt>>& program) {
+        for (const auto& stmt : program) {
+            if (dynamic_cast<const FunctionDecl*>(stmt.get())) {
+                // Only reachable through calls, which aren't vectorized
+                continue;
+            }
+            if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
+                if (letStmt->storage != Storage::Global || letStmt->slot == inputId) return false;
+                int column = compileExpr(letStmt->expr.get());
+                if (column < 0) return false;
+                column = store(column, letStmt->storageType());
+                if (column < 0) return false;
+                globals[letStmt->slot] = column;
+            } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt.get())) {
+                int column = compileExpr(printStmt->expr.get());
+                if (column < 0) return false;
+                columns.prints.push_back(column);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    ColumnProgram& columns;
+    int inputId;
+    // Column of each global bound so far
+    unordered_map<int, int> globals;
+
+    int add(ColumnStep step, bool floatResult) {
+        step.target = (int)columns.floatColumns.size();
+        columns.floatColumns.push_back(floatResult);
+        columns.steps.push_back(step);
+        return step.target;
+    }
+
+    bool isFloat(int column) const { return columns.floatColumns[column]; }
+
+    int toFloat(int column) {
+        if (isFloat(column)) return column;
+        ColumnStep step;
+        step.op = ColumnOp::ToFloat;
+        step.left = column;
+        return add(step, true);
+    }
+
+    // What coerce does to a value bound with this type
+    int store(int column, const Type& type) {
+        ColumnStep step;
+        step.left = column;
+        switch (type.kind) {
+            case TypeKind::Unknown:
+            case TypeKind::F64:
+                return type.kind == TypeKind::F64 ? toFloat(column) : column;
+            case TypeKind::F32:
+                step.op = ColumnOp::RoundF32;
+                step.left = toFloat(column);
+                return add(step, true);
+            case TypeKind::I8:
+            case TypeKind::I16:
+            case TypeKind::I32:
+            case TypeKind::I64:
+                if (isFloat(column)) {
+                    step.op = ColumnOp::Truncate;
+                    step.left = add(step, false);
+                }
+                if (type.kind == TypeKind::I8 || type.kind == TypeKind::I16) {
+                    step.op = ColumnOp::Narrow;
+                    step.intValue = type.kind == TypeKind::I8 ? 8 : 16;
+                    return add(step, false);
+                }
+                return step.left;
+            default:
+                return -1;
+        }
+    }
+
+    // An integer literal, or one negated as in input[-1]
+    static bool literalIndex(const Expr* index, int& value) {
+        if (!index) return false;
+        if (index->kind == ExprKind::Unary && index->op == "-" && literalIndex(index->left.get(), value)) {
+            value = -value;
+            return true;
+        }
+        value = index->int_value;
+        return index->kind == ExprKind::NumberLiteral && isIntegerKind(index->type.kind);
+    }
+
+    int compileExpr(const Expr* expr) {
+        ColumnStep step;
+        switch (expr->kind) {
+            case ExprKind::NumberLiteral:
+                if (isIntegerKind(expr->type.kind)) {
+                    step.op = ColumnOp::Int;
+                    step.intValue = expr->int_value;
+                    return add(step, false);
+                }
+                if (isFloatKind(expr->type.kind)) {
+                    step.op = ColumnOp::Float;
+                    step.floatValue = expr->double_value;
+                    return add(step, true);
+                }
+                return -1;
+
+            case ExprKind::Identifier: {
+                if (expr->storage != Storage::Global) return -1;
+                auto found = globals.find(expr->slot);
+                return found != globals.end() ? found->second : -1;
+            }
+
+            case ExprKind::StringSlice: {
+                const Expr* list = expr->left.get();
+                if (!expr->single_index || list->kind != ExprKind::Identifier ||
+                    list->storage != Storage::Global || list->slot != inputId ||
+                    !literalIndex(expr->start.get(), step.intValue)) {
+                    return -1;
+                }
+                step.op = ColumnOp::Input;
+                return add(step, true);
+            }
+
+            case ExprKind::Unary: {
+                int operand = compileExpr(expr->left.get());
+                if (operand < 0) return -1;
+                step.left = operand;
+                if (expr->op == "-") {
+                    step.op = ColumnOp::Neg;
+                    step.floats = isFloat(operand);
+                    return add(step, step.floats);
+                }
+                // ! reads the int a float doesn't have
+                if (expr->op != "!" || isFloat(operand)) return -1;
+                step.op = ColumnOp::Not;
+                return add(step, false);
+            }
+
+            case ExprKind::Binary:
+                return compileBinary(expr);
+
+            default:
+                return -1;
+        }
+    }
+
+    int compileBinary(const Expr* expr) {
+        static const unordered_map<string, ColumnOp> arithmetic = {
+            {"+", ColumnOp::Add}, {"-", ColumnOp::Sub}, {"*", ColumnOp::Mul}, {"/", ColumnOp::Div}};
+        static const unordered_map<string, ColumnOp> comparisons = {
+            {"==", ColumnOp::Eq}, {"!=", ColumnOp::Ne}, {"<", ColumnOp::Lt},
+            {"<=", ColumnOp::Le}, {">", ColumnOp::Gt}, {">=", ColumnOp::Ge}};
+        static const unordered_map<string, ColumnOp> integerOnly = {
+            {"//", ColumnOp::Div}, {"%", ColumnOp::Mod}, {"&&", ColumnOp::And}, {"||", ColumnOp::Or}};
+
+        int left = compileExpr(expr->left.get());
+        if (left < 0) return -1;
+        int right = compileExpr(expr->right.get());
+        if (right < 0) return -1;
+        ColumnStep step;
+        step.left = left;
+        step.right = right;
+
+        auto computed = arithmetic.find(expr->op);
+        auto compared = comparisons.find(expr->op);
+        if (computed != arithmetic.end() || compared != comparisons.end()) {
+            bool isArithmetic = computed != arithmetic.end();
+            step.op = isArithmetic ? computed->second : compared->second;
+            step.floats = isFloat(left) || isFloat(right);
+            if (step.floats) {
+                step.left = toFloat(left);
+                step.right = toFloat(right);
+            }
+            return add(step, isArithmetic && step.floats);
+        }
+
+        // These read the ints of their operands, which a float doesn't have
+        auto found = integerOnly.find(expr->op);
+        if (found == integerOnly.end() || isFloat(left) || isFloat(right)) return -1;
+        step.op = found->second;
+        return add(step, false);
+    }
+};
+
+// The values of one chunk's columns
+struct ColumnData {
+    vector<int> ints;
+    vector<double> floats;
+};
+
+template <typename Op>
+static void intLoop(vector<int>& out, const vector<int>& a, const vector<int>& b, size_t count, Op op) {
+    for (size_t i = 0; i < count; ++i) out[i] = op(a[i], b[i]);
+}
+
+template <typename Op>
+static void floatLoop(vector<double>& out, const vector<double>& a, const vector<double>& b, size_t count,
+                      Op op) {
+    for (size_t i = 0; i < count; ++i) out[i] = op(a[i], b[i]);
+}
+
+template <typename Op>
+static void compareLoop(vector<int>& out, const ColumnData& a, const ColumnData& b, bool floats, size_t count,
+                        Op op) {
+    if (floats) {
+        for (size_t i = 0; i < count; ++i) out[i] = op(a.floats[i], b.floats[i]) ? 1 : 0;
+    } else {
+        for (size_t i = 0; i < count; ++i) out[i] = op(a.ints[i], b.ints[i]) ? 1 : 0;
+    }
+}
+
+// i32 arithmetic wraps, as the evaluator's does in practice
+static int wrap(uint32_t value) {
+    return (int)value;
+}
+
+static bool hasZero(const vector<int>& values, size_t count) {
+    bool zero = false;
+    for (size_t i = 0; i < count; ++i) zero |= values[i] == 0;
+    return zero;
+}
+
+BatchRunner::BatchRunner(const vector<unique_ptr<Stmt>>& program, int inputId)
+    : program(program), inputId(inputId) {
+    auto compiled = make_unique<ColumnProgram>();
+    if (ColumnCompiler(*compiled, inputId).compileProgram(program)) {
+        columns = std::move(compiled);
+    }
+}
+
+BatchRunner::~BatchRunner() = default;
+
+bool BatchRunner::runScalar(const RecordBatch& records, size_t begin, size_t end, OutputBuffer& output,
+                            string& error) {
+    // Shared by every record's list, like the types the parser allocates
+    static Type* const element = new Type(f64Type());
+    for (size_t i = begin; i < end; ++i) {
+        Symbol input;
+        input.type = listType(element);
+        input.dense = makeDenseArray(f64Type(), vector<double>(records.values.begin() + records.offsets[i],
+                                                               records.values.begin() + records.offsets[i + 1]));
+        Evaluator evaluator(output);
+        evaluator.setGlobal(inputId, std::move(input));
+        try {
+            evaluator.evalProgram(program);
+        } catch (const RuntimeError& failure) {
+            error = string(failure.what()) + " (record " + to_string(i + 1) + ")";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchRunner::runVectorized(const RecordBatch& records, size_t begin, size_t end, OutputBuffer& output) {
+    size_t count = end - begin;
+    vector<ColumnData> data(columns->floatColumns.size());
+    for (size_t c = 0; c < data.size(); ++c) {
+        if (columns->floatColumns[c]) {
+            data[c].floats.resize(count);
+        } else {
+            data[c].ints.resize(count);
+        }
+    }
+
+    for (const ColumnStep& step : columns->steps) {
+        ColumnData& out = data[step.target];
+        const ColumnData* a = step.left >= 0 ? &data[step.left] : nullptr;
+        const ColumnData* b = step.right >= 0 ? &data[step.right] : nullptr;
+        switch (step.op) {
+            case ColumnOp::Int:
+                fill(out.ints.begin(), out.ints.end(), step.intValue);
+                break;
+            case ColumnOp::Float:
+                fill(out.floats.begin(), out.floats.end(), step.floatValue);
+                break;
+            case ColumnOp::Input:
+                for (size_t i = 0; i < count; ++i) {
+                    size_t offset = records.offsets[begin + i];
+                    long long length = (long long)(records.offsets[begin + i + 1] - offset);
+                    long long index = step.intValue < 0 ? step.intValue + length : step.intValue;
+                    // The evaluator reports the record
+                    if (index < 0 || index >= length) return false;
+                    out.floats[i] = records.values[offset + index];
+                }
+                break;
+            case ColumnOp::ToFloat:
+                for (size_t i = 0; i < count; ++i) out.floats[i] = a->ints[i];
+                break;
+            case ColumnOp::Truncate:
+                for (size_t i = 0; i < count; ++i) out.ints[i] = (int)(long long)a->floats[i];
+                break;
+            case ColumnOp::Narrow:
+                if (step.intValue == 8) {
+                    for (size_t i = 0; i < count; ++i) out.ints[i] = (int8_t)a->ints[i];
+                } else {
+                    for (size_t i = 0; i < count; ++i) out.ints[i] = (int16_t)a->ints[i];
+                }
+                break;
+            case ColumnOp::RoundF32:
+                for (size_t i = 0; i < count; ++i) out.floats[i] = (float)a->floats[i];
+                break;
+            case ColumnOp::Add:
+                if (step.floats) {
+                    floatLoop(out.floats, a->floats, b->floats, count, [](double x, double y) { return x + y; });
+                } else {
+                    intLoop(out.ints, a->ints, b->ints, count,
+                            [](int x, int y) { return wrap((uint32_t)x + (uint32_t)y); });
+                }
+                break;
+            case ColumnOp::Sub:
+                if (step.floats) {
+                    floatLoop(out.floats, a->floats, b->floats, count, [](double x, double y) { return x - y; });
+                } else {
+                    intLoop(out.ints, a->ints, b->ints, count,
+                            [](int x, int y) { return wrap((uint32_t)x - (uint32_t)y); });
+                }
+                break;
+            case ColumnOp::Mul:
+                if (step.floats) {
+                    floatLoop(out.floats, a->floats, b->floats, count, [](double x, double y) { return x * y; });
+                } else {
+                    intLoop(out.ints, a->ints, b->ints, count,
+                            [](int x, int y) { return wrap((uint32_t)x * (uint32_t)y); });
+                }
+                break;
+            case ColumnOp::Div:
+                if (step.floats) {
+                    floatLoop(out.floats, a->floats, b->floats, count, [](double x, double y) { return x / y; });
+                } else {
+                    // The evaluator reports the record
+                    if (hasZero(b->ints, count)) return false;
+                    intLoop(out.ints, a->ints, b->ints, count, [](int x, int y) { return x / y; });
+                }
+                break;
+            case ColumnOp::Mod:
+                if (hasZero(b->ints, count)) return false;
+                intLoop(out.ints, a->ints, b->ints, count, [](int x, int y) { return x % y; });
+                break;
+            case ColumnOp::Eq:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x == y; });
+                break;
+            case ColumnOp::Ne:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x != y; });
+                break;
+            case ColumnOp::Lt:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x < y; });
+                break;
+            case ColumnOp::Le:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x <= y; });
+                break;
+            case ColumnOp::Gt:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x > y; });
+                break;
+            case ColumnOp::Ge:
+                compareLoop(out.ints, *a, *b, step.floats, count, [](auto x, auto y) { return x >= y; });
+                break;
+            case ColumnOp::And:
+                intLoop(out.ints, a->ints, b->ints, count, [](int x, int y) { return (x && y) ? 1 : 0; });
+                break;
+            case ColumnOp::Or:
+                intLoop(out.ints, a->ints, b->ints, count, [](int x, int y) { return (x || y) ? 1 : 0; });
+                break;
+            case ColumnOp::Neg:
+                if (step.floats) {
+                    for (size_t i = 0; i < count; ++i) out.floats[i] = -a->floats[i];
+                } else {
+                    for (size_t i = 0; i < count; ++i) out.ints[i] = wrap(0u - (uint32_t)a->ints[i]);
+                }
+                break;
+            case ColumnOp::Not:
+                for (size_t i = 0; i < count; ++i) out.ints[i] = !a->ints[i];
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        for (int column : columns->prints) {
+            if (columns->floatColumns[column]) {
+                output.writeDouble(data[column].floats[i]);
+            } else {
+                output.writeInt(data[column].ints[i]);
+            }
+            output.newline();
+        }
+    }
+    return true;
+}
+
+void BatchRunner::run(const RecordBatch& records, OutputBuffer& output) {
+    ThreadPool& pool = defaultThreadPool();
+    size_t chunks = (records.size() + kBatchChunk - 1) / kBatchChunk;
+    // Chunks run a wave at a time, so only one wave's output is held at once
+    size_t wave = pool.size() * 4;
+
+    for (size_t first = 0; first < chunks; first += wave) {
+        size_t last = min(chunks, first + wave);
+        vector<StringSink> texts(last - first);
+        vector<string> errors(last - first);
+        pool.parallelFor(last - first, 1, [&](size_t from, size_t to) {
+            for (size_t chunk = from; chunk < to; ++chunk) {
+                size_t begin = (first + chunk) * kBatchChunk;
+                size_t end = min(records.size(), begin + kBatchChunk);
+                OutputBuffer text(&texts[chunk]);
+                if (!columns || !runVectorized(records, begin, end, text)) {
+                    runScalar(records, begin, end, text, errors[chunk]);
+                }
+            }
+        });
+
+        for (size_t chunk = 0; chunk < texts.size(); ++chunk) {
+            output.write(texts[chunk].text);
+            if (!errors[chunk].empty()) {
+                output.flush();
+                throw RuntimeError(errors[chunk]);
+            }
+        }
+    }
+    output.flush();
+}
@@ -0,0 +1,69 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "../parser/ast.h"
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+class OutputBuffer;
+struct ColumnProgram;
+
+// Input records of a batch run, stored back to back: record i is
+// values[offsets[i]] up to values[offsets[i + 1]]
+struct RecordBatch {
+    std::vector<double> values;
+    std::vector<size_t> offsets{0};
+
+    size_t size() const { return offsets.size() - 1; }
+};
+
+// One record per non-empty line, numbers separated by commas or whitespace.
+// False with a message naming the line if a field is not a number.
+bool readRecords(std::istream& in, RecordBatch& records, std::string& error);
+
+// Runs one program once per record, each run starting from fresh globals
+// with the record bound to the global `input` as a list[f64]. Records are
+// split into chunks spread over the thread pool, and their output is
+// written in record order.
+//
+// A program of lets and prints over numbers, input[k] with a literal k and
+// the arithmetic, comparison and logical operators is vectorized: each
+// statement is evaluated for a whole chunk at once, one column per
+// expression, in tight loops over the records. Such a program has no
+// control flow, so every record takes the same path. A chunk where an
+// integer division by zero or an index outside a record turns up runs again
+// record by record, so errors come from the evaluator itself. Any other
+// program always runs record by record.
+class BatchRunner {
+public:
+    // inputId is the global id of `input`
+    BatchRunner(const std::vector<std::unique_ptr<Stmt>>& program, int inputId);
+    ~BatchRunner();
+
+    BatchRunner(const BatchRunner&) = delete;
+    BatchRunner& operator=(const BatchRunner&) = delete;
+
+    bool vectorized() const { return columns != nullptr; }
+    // Throws the RuntimeError of the first record that fails, with the
+    // record's number added, after writing the output of the records
+    // before it and what the failing record printed
+    void run(const RecordBatch& records, OutputBuffer& output);
+
+private:
+    const std::vector<std::unique_ptr<Stmt>>& program;
+    int inputId;
+    // Null unless the program is vectorized
+    std::unique_ptr<ColumnProgram> columns;
+
+    // Runs records [begin, end) and writes their output. False if one
+    // failed, with its message in error.
+    bool runScalar(const RecordBatch& records, size_t begin, size_t end, OutputBuffer& output,
+                   std::string& error);
+    // False, having written nothing, if the chunk must run record by record
+    bool runVectorized(const RecordBatch& records, size_t begin, size_t end, OutputBuffer& output);
+};
+
+#endif
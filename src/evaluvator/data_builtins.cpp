@@ -0,0 +1,240 @@
+#include "evaluator.h"
+#include "values.h"
+#include "../runtime/async_io.h"
+#include "../runtime/csv.h"
+#include "../runtime/dense.h"
+#include "../runtime/mapped_file.h"
+#include "../semantics/semantic.h"
+#include "../util/diagnostics.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+using namespace std;
+
+// Builtins that bring data files into a program. load_array maps the file
+// and the list points into the mapping, so a file of any size loads in
+// constant time and only the pages the program touches are ever read.
+// read_csv streams the file and keeps one column, packed at its type's
+// width. read_async and write_async start the transfer and return a future
+// at once, so a program can fetch its next file while working on this one;
+// await blocks until the transfer is done.
+
+static shared_ptr<const MappedFile> mapFile(const Expr* expr, const string& path) {
+    string error;
+    auto file = MappedFile::open(path, error);
+    if (!file) runtimeError(expr->line, error);
+    return file;
+}
+
+static TensorHeader readHeader(const Expr* expr, const string& path, const unsigned char* data, size_t size) {
+    TensorHeader header;
+    string error;
+    if (!readTensorHeader(data, size, header, error)) {
+        runtimeError(expr->line, path + ": " + error);
+    }
+    return header;
+}
+
+// The elements of a tensor file's contents, flattened, or of raw contents
+// read as elements. The list points into data, which owner keeps alive.
+static Symbol denseView(const Expr* expr, const Type& listType, const string& path, const unsigned char* data,
+                        size_t size, shared_ptr<const void> owner) {
+    const Type& element = *listType.element;
+    size_t offset = 0;
+    size_t bytes = size;
+    if (hasTensorHeader(data, size)) {
+        TensorHeader header = readHeader(expr, path, data, size);
+        if (header.element.kind != element.kind) {
+            runtimeError(expr->line, path + " holds " + typeToString(header.element) + " elements, not " +
+                                         typeToString(element));
+        }
+        offset = header.dataOffset;
+        bytes -= offset;
+    }
+    size_t width = denseElementSize(element.kind);
+    if (bytes % width != 0) {
+        runtimeError(expr->line, path + " is " + to_string(bytes) + " bytes, not a whole number of " +
+                                     typeToString(element) + " elements");
+    }
+
+    // Elements are read in place, which assumes a little-endian host
+    auto array = make_shared<DenseArray>();
+    array->element = element;
+    array->count = bytes / width;
+    array->external = data + offset;
+    array->owner = std::move(owner);
+    Symbol result;
+    result.type = listType;
+    result.dense = array;
+    return result;
+}
+
+// load_array(path, "f32")
+static Symbol loadArray(const Expr* expr, const string& path) {
+    auto file = mapFile(expr, path);
+    return denseView(expr, expr->type, path, file->data(), file->size(), file);
+}
+
+// load_shape(path): the dimensions in a tensor file's header
+static Symbol loadShape(const Expr* expr, const string& path) {
+    auto file = mapFile(expr, path);
+    if (!hasTensorHeader(file->data(), file->size())) {
+        runtimeError(expr->line, path + " has no tensor header");
+    }
+    TensorHeader header = readHeader(expr, path, file->data(), file->size());
+    Symbol result;
+    result.type = expr->type;
+    vector<double> dims;
+    for (uint64_t dim : header.shape) {
+        if (dim > (uint64_t)INT_MAX) {
+            runtimeError(expr->line, path + " has a dimension of " + to_string(dim) + ", more than an i32 holds");
+        }
+        dims.push_back((double)dim);
+    }
+    result.dense = makeDenseArray(i32Type(), dims);
+    return result;
+}
+
+// read_csv(path, column, "type"): one column, by index, or by name when the
+// first record is a header. By index, a first record whose field isn't a
+// number is taken for a header and skipped when reading numbers; string
+// columns keep every record, so a file with a header should name the column.
+static Symbol readCsv(const Expr* expr, const string& path, const Symbol& column) {
+    const Type& element = *expr->type.element;
+    CsvReader reader;
+    string error;
+    if (!reader.open(path, error)) runtimeError(expr->line, error);
+
+    size_t index = 0;
+    if (column.type.kind == TypeKind::String) {
+        vector<string> names;
+        if (!reader.next(names)) runtimeError(expr->line, path + " has no header");
+        while (index < names.size() && names[index] != column.string_value) index++;
+        if (index == names.size()) {
+            runtimeError(expr->line, path + " has no column named " + column.string_value);
+        }
+    } else {
+        if (column.int_value < 0) runtimeError(expr->line, "read_csv column index must not be negative");
+        index = (size_t)column.int_value;
+    }
+
+    Symbol result;
+    result.type = expr->type;
+    bool strings = element.kind == TypeKind::String;
+    bool integers = isIntegerKind(element.kind);
+    shared_ptr<DenseArray> array;
+    if (!strings) {
+        array = make_shared<DenseArray>();
+        array->element = element;
+    }
+    // Only the first record read by index can be a header
+    bool mayBeHeader = column.type.kind != TypeKind::String;
+    string field;
+    bool found;
+    while (reader.next(index, field, found)) {
+        bool first = mayBeHeader;
+        mayBeHeader = false;
+        auto where = [&] { return path + " line " + to_string(reader.line()); };
+        if (!found) {
+            runtimeError(expr->line, where() + " has no column " + to_string(index));
+        }
+        if (strings) {
+            Symbol value;
+            value.type = stringType();
+            value.string_value = field;
+            result.list_values.push_back(std::move(value));
+            continue;
+        }
+        const char* text = field.c_str();
+        while (*text == ' ' || *text == '\t') text++;
+        char* end;
+        errno = 0;
+        double value = integers ? (double)strtoll(text, &end, 10) : strtod(text, &end);
+        while (*end == ' ' || *end == '\t') end++;
+        if (end == text || *end || (integers && errno == ERANGE)) {
+            if (first) continue;
+            runtimeError(expr->line, where() + ": '" + field + "' is not " +
+                                         (integers ? "an integer" : "a number"));
+        }
+        appendDense(*array, value);
+    }
+    if (!reader.error().empty()) {
+        runtimeError(expr->line, "could not read " + path + ": " + reader.error());
+    }
+    result.dense = array;
+    return result;
+}
+
+// A future for request. It remembers the path for messages about the
+// contents, and for a write the length await gives back.
+static Symbol futureOf(const Expr* expr, const string& path, shared_ptr<IoRequest> request, int written = 0) {
+    Symbol result;
+    result.type = expr->type;
+    result.string_value = path;
+    result.int_value = written;
+    result.io = std::move(request);
+    return result;
+}
+
+// write_async(path, data): a string's bytes, or a list's elements packed at
+// its element type's width
+static Symbol writeAsync(const Expr* expr, const string& path, const Symbol& data) {
+    AsyncIo& io = AsyncIo::instance();
+    if (data.type.kind == TypeKind::String) {
+        auto text = make_shared<const string>(data.string_value);
+        auto bytes = reinterpret_cast<const unsigned char*>(text->data());
+        return futureOf(expr, path, io.write(path, bytes, text->size(), text), (int)text->size());
+    }
+    shared_ptr<const DenseArray> array = data.dense;
+    if (!array || array->element.kind != data.type.element->kind) {
+        vector<double> values;
+        if (array) {
+            for (size_t i = 0; i < array->count; ++i) values.push_back(array->valueAt(i));
+        } else if (data.range) {
+            for (size_t i = 0; i < data.range->size(); ++i) values.push_back((double)data.range->at(i));
+        } else {
+            for (const Symbol& element : data.list_values) values.push_back(numericValue(element));
+        }
+        array = makeDenseArray(*data.type.element, values);
+    }
+    size_t size = array->count * denseElementSize(array->element.kind);
+    return futureOf(expr, path, io.write(path, array->data(), size, array), (int)array->count);
+}
+
+// await(future): the file read, or the length written
+static Symbol awaitFuture(const Expr* expr, const Symbol& future) {
+    IoRequest& request = *future.io;
+    request.wait();
+    if (!request.error().empty()) runtimeError(expr->line, request.error());
+    Symbol result;
+    result.type = expr->type;
+    if (expr->type.kind == TypeKind::String) {
+        result.string_value.assign(reinterpret_cast<const char*>(request.data()), request.size());
+    } else if (expr->type.kind == TypeKind::List) {
+        result = denseView(expr, expr->type, future.string_value, request.data(), request.size(), future.io);
+    } else {
+        result.int_value = future.int_value;
+    }
+    return result;
+}
+
+Symbol Evaluator::evalDataBuiltin(const Expr* expr) {
+    if (expr->name == "await") {
+        return awaitFuture(expr, evalExpr(expr->args[0].get()));
+    }
+    string path = evalExpr(expr->args[0].get()).string_value;
+    if (expr->name == "read_async") {
+        return futureOf(expr, path, AsyncIo::instance().read(path));
+    }
+    if (expr->name == "write_async") {
+        return writeAsync(expr, path, evalExpr(expr->args[1].get()));
+    }
+    if (expr->name == "load_array") {
+        return loadArray(expr, path);
+    }
+    if (expr->name == "load_shape") {
+        return loadShape(expr, path);
+    }
+    return readCsv(expr, path, evalExpr(expr->args[1].get()));
+}
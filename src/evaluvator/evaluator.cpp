@@ -1,19 +1,237 @@
 #include "evaluator.h"
-#include <iostream>
+#include "values.h"
+#include "../runtime/numeric.h"
+#include "../runtime/output.h"
+#include "../runtime/string_kernels.h"
+#include "profiler.h"
+#include "../util/diagnostics.h"
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <algorithm>
 
 using namespace std;
 
-Evaluator::Evaluator(SymbolTable& symbols) : symbols(symbols) {}
+Evaluator::Evaluator() : output(standardOutput()) {}
+
+Evaluator::Evaluator(OutputBuffer& output) : output(output) {}
+
+Evaluator::Evaluator(const Evaluator* outer) : Evaluator(outer, outer->output) {}
+
+Evaluator::Evaluator(const Evaluator* outer, OutputBuffer& output)
+    : output(output), budget(outer->budget),
+      outerGlobals(outer->outerGlobals ? outer->outerGlobals : &outer->globals), shadow(outer->shadow) {
+    auto begin = outer->stack.begin() + outer->frameBase;
+    stack.assign(begin, begin + outer->frameSize);
+    frameSize = outer->frameSize;
+    element[0] = outer->element[0];
+    element[1] = outer->element[1];
+}
+
+// What reading a global before anything is bound to it gives
+static const Symbol& unboundValue() {
+    static const Symbol value = [] {
+        Symbol unbound;
+        unbound.type = i32Type();
+        return unbound;
+    }();
+    return value;
+}
+
+const Symbol& Evaluator::global(int id) const {
+    if (!shadow.empty()) {
+        auto found = shadow.find(id);
+        if (found != shadow.end()) return found->second;
+    }
+    const vector<Symbol>& table = outerGlobals ? *outerGlobals : globals;
+    if (id >= 0 && (size_t)id < table.size()) return table[id];
+    return unboundValue();
+}
+
+void Evaluator::recover() {
+    stack.clear();
+    frameBase = 0;
+    frameSize = 0;
+    callDepth = 0;
+    returning = false;
+    returnValue = Symbol();
+    tailCallee = nullptr;
+    tailArgs.clear();
+    element[0] = Symbol();
+    element[1] = Symbol();
+}
+
+static double roundToFloatKind(TypeKind kind, double value) {
+    switch (kind) {
+        case TypeKind::F32: return (float)value;
+        case TypeKind::F16: return halfToFloat(floatToHalf((float)value));
+        case TypeKind::BF16: return bfloat16ToFloat(floatToBFloat16((float)value));
+        default: return value;
+    }
+}
+
+static bool rangeFits(const LazyRange& range, TypeKind kind) {
+    if (range.size() == 0) return true;
+    long long first = range.at(0);
+    long long last = range.at(range.size() - 1);
+    long long lo = first < last ? first : last;
+    long long hi = first < last ? last : first;
+    switch (kind) {
+        case TypeKind::I8: return lo >= -128 && hi <= 127;
+        case TypeKind::I16: return lo >= -32768 && hi <= 32767;
+        default: return lo >= INT32_MIN && hi <= INT32_MAX;
+    }
+}
+
+// Converts a value to the declared type of the binding it is stored in
+Symbol Evaluator::convertSymbol(const Symbol& value, const Type& target) {
+    if (isIntegerKind(target.kind) && isNumericKind(value.type.kind)) {
+        long long whole = isFloatValue(value) ? (long long)numericValue(value) : value.int_value;
+        Symbol result = value;
+        result.type = target;
+        if (target.kind == TypeKind::I8) {
+            result.int_value = (int8_t)whole;
+        } else if (target.kind == TypeKind::I16) {
+            result.int_value = (int16_t)whole;
+        } else {
+            result.int_value = (int)whole;
+        }
+        return result;
+    }
+
+    if (isFloatKind(target.kind) && isNumericKind(value.type.kind)) {
+        Symbol result = value;
+        result.type = target;
+        result.double_value = roundToFloatKind(target.kind, numericValue(value));
+        return result;
+    }
+
+    if (target.kind == TypeKind::Q8 && isNumericKind(value.type.kind)) {
+        Symbol result = value;
+        result.type = target;
+        result.int_value = quantizeQ8((float)numericValue(value), (float)target.scale, target.zero_point);
+        return result;
+    }
+
+    if (target.kind == TypeKind::List && target.element && value.type.kind == TypeKind::List) {
+        if (value.range && isIntegerKind(target.element->kind) && rangeFits(*value.range, target.element->kind)) {
+            Symbol result = value;
+            result.type = target;
+            return result;
+        }
+
+        Symbol result;
+        result.type = target;
+        if (isDenseKind(target.element->kind)) {
+            result.dense = makeDenseArray(*target.element, listNumbers(value));
+        } else {
+            for (const auto& element : value.list_values) {
+                result.list_values.push_back(convertSymbol(element, *target.element));
+            }
+        }
+        return result;
+    }
+
+    if (target.kind == TypeKind::Map && value.type.kind == TypeKind::Map) {
+        return convertMap(value, target);
+    }
+
+    return value;
+}
 
 void Evaluator::evalProgram(const std::vector<std::unique_ptr<Stmt>>& program) {
     for (const auto& stmt : program) {
-        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
-            Symbol result = evalExpr(letStmt->expr.get());
-            symbols.set(letStmt->name, result);
-        } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt.get())) {
-            evalPrintStmt(printStmt);
+        execute(stmt.get());
+    }
+}
+
+void Evaluator::setStepLimit(uint64_t steps, size_t depth) {
+    ownBudget = std::make_unique<StepBudget>();
+    ownBudget->steps = steps;
+    ownBudget->depth = depth;
+    budget = ownBudget.get();
+}
+
+void Evaluator::executeBlock(const std::vector<std::unique_ptr<Stmt>>& body) {
+    for (const auto& stmt : body) {
+        step(stmt->line);
+        execute(stmt.get());
+        if (returning) return;
+    }
+}
+
+// Converts in place, skipping values that already have the target's representation
+void Evaluator::coerce(Symbol& value, const Type& target) {
+    if (target.kind == TypeKind::Unknown) return;
+    if (value.type.kind == target.kind && target.kind != TypeKind::List && target.kind != TypeKind::Q8 &&
+        target.kind != TypeKind::Map) {
+        return;
+    }
+    value = convertSymbol(value, target);
+}
+
+void Evaluator::bind(Storage storage, int slot, Symbol value) {
+    if (storage == Storage::Local) {
+        stack[frameBase + slot] = std::move(value);
+    } else if (storage == Storage::Element) {
+        element[slot] = std::move(value);
+    } else if (outerGlobals) {
+        shadow[slot] = std::move(value);
+    } else {
+        if ((size_t)slot >= globals.size()) {
+            globals.resize(slot + 1, unboundValue());
+        }
+        globals[slot] = std::move(value);
+    }
+}
+
+void Evaluator::execute(const Stmt* stmt) {
+    if (profiler) {
+        profiler->enter(stmt);
+        executeStmt(stmt);
+        profiler->leave();
+    } else {
+        executeStmt(stmt);
+    }
+}
+
+void Evaluator::executeStmt(const Stmt* stmt) {
+    if (auto letStmt = dynamic_cast<const LetStmt*>(stmt)) {
+        Symbol result = evalExpr(letStmt->expr.get());
+        coerce(result, letStmt->storageType());
+        bind(letStmt->storage, letStmt->slot, std::move(result));
+    } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt)) {
+        evalPrintStmt(printStmt);
+    } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt)) {
+        if (updateMapInPlace(assignStmt)) return;
+        Symbol result = evalExpr(assignStmt->expr.get());
+        coerce(result, assignStmt->target_type);
+        bind(assignStmt->storage, assignStmt->slot, std::move(result));
+    } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt)) {
+        while (isTruthy(evalExpr(whileStmt->condition.get()))) {
+            step(whileStmt->line);
+            executeBlock(whileStmt->body);
+            if (returning) break;
+        }
+    } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt)) {
+        // The iterable is evaluated once; ranges are walked without materializing
+        Symbol iterable = evalExpr(forStmt->iterable.get());
+        size_t count = listLength(iterable);
+        for (size_t i = 0; i < count; ++i) {
+            step(forStmt->line);
+            bind(forStmt->storage, forStmt->slot, listElement(iterable, i));
+            executeBlock(forStmt->body);
+            if (returning) break;
+        }
+    } else if (auto returnStmt = dynamic_cast<const ReturnStmt*>(stmt)) {
+        executeReturn(returnStmt);
+    } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt)) {
+        evalExpr(exprStmt->expr.get());
+    } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt)) {
+        if (isTruthy(evalExpr(ifStmt->condition.get()))) {
+            executeBlock(ifStmt->then_body);
+        } else {
+            executeBlock(ifStmt->else_body);
         }
     }
 }
@@ -21,7 +239,7 @@ void Evaluator::evalProgram(const std::vector<std::unique_ptr<Stmt>>& program) {
 void Evaluator::evalPrintStmt(const PrintStmt* stmt) {
     Symbol value = evalExpr(stmt->expr.get());
     printSymbol(value);
-    cout << endl;
+    output.newline();
 }
 
 void Evaluator::printSymbol(const Symbol& value) {
@@ -29,27 +247,64 @@ void Evaluator::printSymbol(const Symbol& value) {
         case TypeKind::I32:
         case TypeKind::I8:
         case TypeKind::I16:
-            cout << value.int_value;
+        case TypeKind::I64:
+            output.writeInt(value.int_value);
             break;
         case TypeKind::F32:
         case TypeKind::F64:
-            cout << value.double_value;
+        case TypeKind::F16:
+        case TypeKind::BF16:
+        case TypeKind::Q8:
+            output.writeDouble(numericValue(value));
             break;
         case TypeKind::String:
-            cout << value.string_value;
+            output.write(value.string_value);
             break;
         case TypeKind::List:
-            cout << "[";
+            output.write('[');
+            // Ranges and dense arrays are formatted straight from their storage
+            if (value.range) {
+                size_t count = value.range->size();
+                for (size_t i = 0; i < count; ++i) {
+                    if (i > 0) output.write(", ", 2);
+                    output.writeInt(value.range->at(i));
+                }
+            } else if (value.dense) {
+                const DenseArray& array = *value.dense;
+                bool integers = isIntegerKind(array.element.kind);
+                for (size_t i = 0; i < array.count; ++i) {
+                    if (i > 0) output.write(", ", 2);
+                    if (integers) {
+                        output.writeInt((long long)array.valueAt(i));
+                    } else {
+                        output.writeDouble(array.valueAt(i));
+                    }
+                }
+            }
             for (size_t i = 0; i < value.list_values.size(); ++i) {
+                if (i > 0) output.write(", ", 2);
                 printSymbol(value.list_values[i]);
-                if (i < value.list_values.size() - 1) {
-                    cout << ", ";
-                }
             }
-            cout << "]";
+            output.write(']');
+            break;
+        case TypeKind::Map: {
+            output.write('{');
+            bool first = true;
+            if (value.map) value.map->forEach([&](string_view key, const Symbol& element) {
+                if (!first) output.write(", ", 2);
+                first = false;
+                printSymbol(mapKeySymbol(key, *value.type.key));
+                output.write(": ", 2);
+                printSymbol(element);
+            });
+            output.write('}');
+            break;
+        }
+        case TypeKind::Future:
+            output.write("<future>");
             break;
         default:
-            cout << "Unknown type to print";
+            output.write("Unknown type to print");
             break;
     }
 }
@@ -57,12 +312,12 @@ void Evaluator::printSymbol(const Symbol& value) {
 Symbol Evaluator::evalExpr(const Expr* expr) {
     switch (expr->kind) {
         case ExprKind::NumberLiteral: {
+            // Source literals are i32 or f64; folded constants keep their own type
             Symbol sym;
-            if (expr->type.kind == TypeKind::F64) {
-                sym.type = f64Type();
+            sym.type = expr->type;
+            if (isFloatKind(expr->type.kind)) {
                 sym.double_value = expr->double_value;
             } else {
-                sym.type = i32Type();
                 sym.int_value = expr->int_value;
             }
             return sym;
@@ -75,9 +330,12 @@ Symbol Evaluator::evalExpr(const Expr* expr) {
             return sym;
         }
         
-        case ExprKind::Identifier: {
-            return symbols.get(expr->string_value);
-        }
+        case ExprKind::Identifier:
+            switch (expr->storage) {
+                case Storage::Local: return stack[frameBase + expr->slot];
+                case Storage::Element: return element[expr->slot];
+                default: return global(expr->slot);
+            }
         
         case ExprKind::Binary:
             return evalBinary(expr);
@@ -90,21 +348,16 @@ Symbol Evaluator::evalExpr(const Expr* expr) {
             
         case ExprKind::MethodCall:
             return evalMethodCall(expr);
+
+        case ExprKind::Call:
+            // User calls skip evalCall's frame, which deep recursion would pay on every level
+            return expr->function ? callFunction(expr) : evalCall(expr);
+
+        case ExprKind::MapLiteral:
+            return evalMapLiteral(expr);
             
-        case ExprKind::ListLiteral: {
-            Symbol sym;
-            sym.type = listType(nullptr); // Placeholder, will set actual element type below
-            
-            if (!expr->elements.empty()) {
-                for (const auto& elementExpr : expr->elements) {
-                    sym.list_values.push_back(evalExpr(elementExpr.get()));
-                }
-                sym.type = listType(new Type(sym.list_values[0].type));
-            } else {
-                sym.type = listType(new Type(i32Type())); // Default for empty list
-            }
-            return sym;
-        }
+        case ExprKind::ListLiteral:
+            return evalListLiteral(expr);
     }
     
     Symbol err;
@@ -113,6 +366,33 @@ Symbol Evaluator::evalExpr(const Expr* expr) {
     return err;
 }
 
+Symbol Evaluator::evalListLiteral(const Expr* expr) {
+    Symbol sym;
+    if (expr->type.kind == TypeKind::List && expr->type.element &&
+        (expr->type.element->kind == TypeKind::I8 || expr->type.element->kind == TypeKind::I16)) {
+        // Range analysis proved every element fits; skip the per-element Symbols
+        vector<double> values;
+        values.reserve(expr->elements.size());
+        for (const auto& elementExpr : expr->elements) {
+            values.push_back(numericValue(evalExpr(elementExpr.get())));
+        }
+        sym.type = expr->type;
+        sym.dense = makeDenseArray(*expr->type.element, values);
+        return sym;
+    }
+    sym.type = listType(nullptr); // Placeholder, will set actual element type below
+    
+    if (!expr->elements.empty()) {
+        for (const auto& elementExpr : expr->elements) {
+            sym.list_values.push_back(evalExpr(elementExpr.get()));
+        }
+        sym.type = listType(new Type(sym.list_values[0].type));
+    } else {
+        sym.type = listType(new Type(i32Type())); // Default for empty list
+    }
+    return sym;
+}
+
 Symbol Evaluator::evalBinary(const Expr* expr) {
     Symbol left = evalExpr(expr->left.get());
     Symbol right = evalExpr(expr->right.get());
@@ -122,63 +402,66 @@ Symbol Evaluator::evalBinary(const Expr* expr) {
         if (left.type.kind == TypeKind::String || right.type.kind == TypeKind::String) {
             result.type = stringType();
             result.string_value = left.string_value + right.string_value;
-        } else if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
+        } else if (isFloatValue(left) || isFloatValue(right)) {
             result.type = f64Type();
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.double_value = lval + rval;
         } else {
             result.type = i32Type();
             result.int_value = left.int_value + right.int_value;
         }
     } else if (expr->op == "-") {
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
+        if (isFloatValue(left) || isFloatValue(right)) {
             result.type = f64Type();
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.double_value = lval - rval;
         } else {
             result.type = i32Type();
             result.int_value = left.int_value - right.int_value;
         }
     } else if (expr->op == "*") {
-        if (left.type.kind == TypeKind::String && right.type.kind == TypeKind::I32) {
+        if (left.type.kind == TypeKind::String && isIntegerKind(right.type.kind)) {
             result.type = stringType();
             for (int i = 0; i < right.int_value; i++) {
                 result.string_value += left.string_value;
             }
-        } else if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
+        } else if (isFloatValue(left) || isFloatValue(right)) {
             result.type = f64Type();
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.double_value = lval * rval;
         } else {
             result.type = i32Type();
             result.int_value = left.int_value * right.int_value;
         }
     } else if (expr->op == "/") {
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
+        if (isFloatValue(left) || isFloatValue(right)) {
             result.type = f64Type();
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.double_value = lval / rval;
         } else {
+            if (right.int_value == 0) runtimeError(expr->line, "division by zero");
             result.type = i32Type();
             result.int_value = left.int_value / right.int_value;
         }
     } else if (expr->op == "//") { // Add this block for integer division
+        if (right.int_value == 0) runtimeError(expr->line, "division by zero");
         result.type = i32Type();
         result.int_value = left.int_value / right.int_value;
     } else if (expr->op == "%") {
+        if (right.int_value == 0) runtimeError(expr->line, "division by zero");
         result.type = i32Type();
         result.int_value = left.int_value % right.int_value;
     } else if (expr->op == "==") {
         result.type = i32Type();
         if (left.type.kind == TypeKind::String) {
             result.int_value = (left.string_value == right.string_value) ? 1 : 0;
-        } else if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        } else if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval == rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value == right.int_value) ? 1 : 0;
@@ -187,45 +470,45 @@ Symbol Evaluator::evalBinary(const Expr* expr) {
         result.type = i32Type();
         if (left.type.kind == TypeKind::String) {
             result.int_value = (left.string_value != right.string_value) ? 1 : 0;
-        } else if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        } else if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval != rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value != right.int_value) ? 1 : 0;
         }
     } else if (expr->op == "<") {
         result.type = i32Type();
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval < rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value < right.int_value) ? 1 : 0;
         }
     } else if (expr->op == "<=") {
         result.type = i32Type();
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval <= rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value <= right.int_value) ? 1 : 0;
         }
     } else if (expr->op == ">") {
         result.type = i32Type();
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval > rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value > right.int_value) ? 1 : 0;
         }
     } else if (expr->op == ">=") {
         result.type = i32Type();
-        if (left.type.kind == TypeKind::F64 || right.type.kind == TypeKind::F64) {
-            double lval = (left.type.kind == TypeKind::F64) ? left.double_value : left.int_value;
-            double rval = (right.type.kind == TypeKind::F64) ? right.double_value : right.int_value;
+        if (isFloatValue(left) || isFloatValue(right)) {
+            double lval = numericValue(left);
+            double rval = numericValue(right);
             result.int_value = (lval >= rval) ? 1 : 0;
         } else {
             result.int_value = (left.int_value >= right.int_value) ? 1 : 0;
@@ -246,9 +529,9 @@ Symbol Evaluator::evalUnary(const Expr* expr) {
     Symbol result;
     
     if (expr->op == "-") {
-        if (operand.type.kind == TypeKind::F64) {
+        if (isFloatValue(operand)) {
             result.type = f64Type();
-            result.double_value = -operand.double_value;
+            result.double_value = -numericValue(operand);
         } else {
             result.type = i32Type();
             result.int_value = -operand.int_value;
@@ -261,10 +544,105 @@ Symbol Evaluator::evalUnary(const Expr* expr) {
     return result;
 }
 
+Symbol Evaluator::evalCall(const Expr* expr) {
+    if (expr->function) {
+        return callFunction(expr);
+    }
+    if (isDataBuiltin(expr->name)) {
+        return evalDataBuiltin(expr);
+    }
+
+    Symbol result;
+    if (expr->name == "range") {
+        long long bounds[3] = { 0, 0, 1 };
+        if (expr->args.size() == 1) {
+            bounds[1] = evalExpr(expr->args[0].get()).int_value;
+        } else {
+            for (size_t i = 0; i < expr->args.size() && i < 3; ++i) {
+                bounds[i] = evalExpr(expr->args[i].get()).int_value;
+            }
+        }
+        if (bounds[2] == 0) {
+            runtimeError(expr->line, "range step must not be zero");
+        }
+        auto range = make_shared<LazyRange>();
+        range->start = bounds[0];
+        range->stop = bounds[1];
+        range->step = bounds[2];
+        result.type = listType(new Type(i32Type()));
+        result.range = range;
+    }
+    return result;
+}
+
+// x[i] and x[a:b] on lists. Ranges stay lazy: an index is computed and a
+// slice is another range.
+Symbol Evaluator::evalListIndex(const Expr* expr, const Symbol& list) {
+    if (!expr->bounds_check) {
+        // The loop optimizer proved 0 <= index < length
+        return listElement(list, (size_t)evalExpr(expr->start.get()).int_value);
+    }
+
+    long long length = (long long)listLength(list);
+    long long start = 0;
+    long long end = length;
+    if (expr->start) {
+        start = evalExpr(expr->start.get()).int_value;
+        if (start < 0) start += length;
+    }
+
+    if (expr->single_index) {
+        if (start < 0 || start >= length) {
+            runtimeError(expr->line, "list index " + to_string(start) + " out of range for length " +
+                                         to_string(length));
+        }
+        return listElement(list, (size_t)start);
+    }
+
+    if (expr->end) {
+        end = evalExpr(expr->end.get()).int_value;
+        if (end < 0) end += length;
+    }
+    start = max(0LL, min(start, length));
+    end = max(start, min(end, length));
+
+    Symbol result;
+    result.type = list.type;
+    if (list.range) {
+        auto range = make_shared<LazyRange>();
+        range->start = list.range->at((size_t)start);
+        range->step = list.range->step;
+        range->stop = range->start + (end - start) * range->step;
+        result.range = range;
+    } else if (list.dense) {
+        vector<double> values;
+        for (long long i = start; i < end; ++i) {
+            values.push_back(list.dense->valueAt((size_t)i));
+        }
+        result.dense = makeDenseArray(list.dense->element, values);
+    } else {
+        result.list_values.assign(list.list_values.begin() + start, list.list_values.begin() + end);
+    }
+    return result;
+}
+
 Symbol Evaluator::evalStringSlice(const Expr* expr) {
     Symbol str = evalExpr(expr->left.get());
+    if (str.type.kind == TypeKind::List) {
+        return evalListIndex(expr, str);
+    }
+    if (str.type.kind == TypeKind::Map) {
+        return evalMapIndex(expr, str);
+    }
+
     Symbol result;
     result.type = stringType();
+
+    if (!expr->bounds_check) {
+        // Proven in range by the loop optimizer, so no clamping
+        result.string_value.assign(1, str.string_value[evalExpr(expr->start.get()).int_value]);
+        return result;
+    }
     
     int start = 0;
     int end = str.string_value.length();
@@ -278,7 +656,7 @@ Symbol Evaluator::evalStringSlice(const Expr* expr) {
     if (expr->end) {
         Symbol endSym = evalExpr(expr->end.get());
         end = endSym.int_value;
-        if (end == -1) {
+        if (expr->single_index) {
             end = start + 1;
         } else if (end < 0) {
             end = str.string_value.length() + end;
@@ -295,17 +673,31 @@ Symbol Evaluator::evalStringSlice(const Expr* expr) {
 Symbol Evaluator::evalMethodCall(const Expr* expr) {
     Symbol obj = evalExpr(expr->left.get());
     Symbol result;
+
+    if (obj.type.kind == TypeKind::Map) {
+        return evalMapMethod(expr, obj);
+    }
+    if (obj.type.kind == TypeKind::List) {
+        const string& method = expr->method_name;
+        if (method == "map" || method == "filter" || method == "reduce" || method == "sum" || method == "sort") {
+            return evalListBuiltin(expr, obj);
+        }
+        if (method == "len") {
+            result.type = i32Type();
+            result.int_value = (int)listLength(obj);
+            return result;
+        }
+    }
     
-    if (expr->method_name == "upper") {
-        result.type = stringType();
-        result.string_value = obj.string_value;
-        transform(result.string_value.begin(), result.string_value.end(), 
-                  result.string_value.begin(), ::toupper);
-    } else if (expr->method_name == "lower") {
+    if (expr->method_name == "upper" || expr->method_name == "lower") {
         result.type = stringType();
-        result.string_value = obj.string_value;
-        transform(result.string_value.begin(), result.string_value.end(), 
-                  result.string_value.begin(), ::tolower);
+        const string& text = obj.string_value;
+        result.string_value.resize(text.size());
+        if (expr->method_name == "upper") {
+            asciiUpper(text.data(), &result.string_value[0], text.size());
+        } else {
+            asciiLower(text.data(), &result.string_value[0], text.size());
+        }
     } else if (expr->method_name == "len") {
         result.type = i32Type();
         result.int_value = obj.string_value.length();
@@ -313,27 +705,39 @@ Symbol Evaluator::evalMethodCall(const Expr* expr) {
         if (expr->args.size() >= 2) {
             Symbol oldStr = evalExpr(expr->args[0].get());
             Symbol newStr = evalExpr(expr->args[1].get());
-            
-            result.type = stringType();
-            result.string_value = obj.string_value;
-            
-            size_t pos = 0;
-            while ((pos = result.string_value.find(oldStr.string_value, pos)) != string::npos) {
-                result.string_value.replace(pos, oldStr.string_value.length(), newStr.string_value);
-                pos += newStr.string_value.length();
+            if (oldStr.string_value.empty()) {
+                runtimeError(expr->line, "replace pattern must not be empty");
             }
+            result.type = stringType();
+            result.string_value = replaceText(obj.string_value, oldStr.string_value, newStr.string_value);
         }
     } else if (expr->method_name == "contains") {
         if (expr->args.size() >= 1) {
             Symbol search = evalExpr(expr->args[0].get());
             result.type = i32Type();
-            result.int_value = (obj.string_value.find(search.string_value) != string::npos) ? 1 : 0;
+            result.int_value = findText(obj.string_value, search.string_value) != string::npos ? 1 : 0;
         }
     } else if (expr->method_name == "startswith") {
         if (expr->args.size() >= 1) {
             Symbol prefix = evalExpr(expr->args[0].get());
             result.type = i32Type();
-            result.int_value = (obj.string_value.find(prefix.string_value) == 0) ? 1 : 0;
+            const string& text = prefix.string_value;
+            result.int_value = obj.string_value.compare(0, text.length(), text) == 0 ? 1 : 0;
+        }
+    } else if (expr->method_name == "dot") {
+        if (expr->args.size() >= 1) {
+            Symbol other = evalExpr(expr->args[0].get());
+            result.type = f64Type();
+            if (obj.dense && other.dense) {
+                result.double_value = denseDot(*obj.dense, *other.dense);
+            } else {
+                vector<double> a = listNumbers(obj);
+                vector<double> b = listNumbers(other);
+                result.double_value = 0.0;
+                for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+                    result.double_value += a[i] * b[i];
+                }
+            }
         }
     } else if (expr->method_name == "endswith") {
         if (expr->args.size() >= 1) {
@@ -348,6 +752,54 @@ Symbol Evaluator::evalMethodCall(const Expr* expr) {
                 result.int_value = 0;
             }
         }
+    } else if (expr->method_name == "find" || expr->method_name == "count") {
+        if (expr->args.size() >= 1) {
+            Symbol search = evalExpr(expr->args[0].get());
+            result.type = i32Type();
+            if (expr->method_name == "find") {
+                size_t at = findText(obj.string_value, search.string_value);
+                result.int_value = at == string::npos ? -1 : (int)at;
+            } else {
+                if (search.string_value.empty()) {
+                    runtimeError(expr->line, "count pattern must not be empty");
+                }
+                result.int_value = (int)countText(obj.string_value, search.string_value);
+            }
+        }
+    } else if (expr->method_name == "split") {
+        if (expr->args.size() >= 1) {
+            Symbol separator = evalExpr(expr->args[0].get());
+            const string& sep = separator.string_value;
+            if (sep.empty()) {
+                runtimeError(expr->line, "split separator must not be empty");
+            }
+            result.type = expr->type;
+            const string& text = obj.string_value;
+            Symbol piece;
+            piece.type = stringType();
+            size_t begin = 0;
+            for (size_t at = findText(text, sep);; at = findText(text, sep, begin)) {
+                size_t end = at == string::npos ? text.size() : at;
+                piece.string_value.assign(text, begin, end - begin);
+                result.list_values.push_back(piece);
+                if (at == string::npos) break;
+                begin = at + sep.size();
+            }
+        }
+    } else if (expr->method_name == "join") {
+        // sep.join(parts), sized up front so the result is allocated once
+        if (expr->args.size() >= 1) {
+            Symbol parts = evalExpr(expr->args[0].get());
+            const string& sep = obj.string_value;
+            result.type = stringType();
+            size_t total = 0;
+            for (const Symbol& part : parts.list_values) total += part.string_value.size() + sep.size();
+            result.string_value.reserve(total);
+            for (size_t i = 0; i < parts.list_values.size(); ++i) {
+                if (i > 0) result.string_value += sep;
+                result.string_value += parts.list_values[i].string_value;
+            }
+        }
     }
     
     return result;
@@ -3,25 +3,127 @@
 
 #include "../parser/ast.h"
 #include "../semantics/symbol_table.h"
+#include "../util/diagnostics.h"
+#include <atomic>
+#include <functional>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Device;
+class OutputBuffer;
+class Profiler;
+
+// Thrown when an evaluator given a step limit runs past it. reason is e.g.
+// "exceeded 100 steps".
+class StepLimitExceeded : public RuntimeError {
+public:
+    StepLimitExceeded(int line, const std::string& reason)
+        : RuntimeError("Runtime error at line " + std::to_string(line) + ": " + reason), reason(reason) {}
+
+    std::string reason;
+};
 
 class Evaluator {
 public:
-    Evaluator(SymbolTable& symbols);
-    
+    Evaluator();
+    // Prints to output instead of standardOutput()
+    explicit Evaluator(OutputBuffer& output);
+    // Evaluator for a worker thread running a body on behalf of outer. It
+    // reads outer's globals but never writes them: bindings it makes stay in
+    // its own shadow. It starts with a copy of outer's current frame.
+    explicit Evaluator(const Evaluator* outer);
+    // The same, printing to output instead of outer's
+    Evaluator(const Evaluator* outer, OutputBuffer& output);
+
     void evalProgram(const std::vector<std::unique_ptr<Stmt>>& program);
+    void execute(const Stmt* stmt);
+    // Runs independent statements concurrently as kernels on a device
+    void evalProgramAsync(const std::vector<std::unique_ptr<Stmt>>& program, Device& device);
     Symbol evalExpr(const Expr* expr);
     void printSymbol(const Symbol& value);
-    
+    // Value of the global FrameLayout gave this id, i32 0 if still unbound
+    const Symbol& global(int id) const;
+    // Binds a global as a top-level let would, e.g. one the caller declared
+    void setGlobal(int id, Symbol value) { bind(Storage::Global, id, std::move(value)); }
+    // Drops the call frames a RuntimeError unwound through, keeping the
+    // globals, so the evaluator can run more statements
+    void recover();
+    // Reports every statement and call to profiler; workers never do
+    void setProfiler(Profiler* profiler) { this->profiler = profiler; }
+    // Throws StepLimitExceeded once this evaluator and its workers have run
+    // more than steps statements, loop iterations and element bodies between
+    // them, or calls nest deeper than depth. Restarts the count.
+    void setStepLimit(uint64_t steps, size_t depth);
+
 private:
-    SymbolTable& symbols;
-    
+    OutputBuffer& output;
+    Profiler* profiler = nullptr;
+    struct StepBudget {
+        uint64_t steps;
+        size_t depth;
+        std::atomic<uint64_t> taken{0};
+    };
+    // Set by setStepLimit; workers share the budget of the evaluator they
+    // were made from
+    std::unique_ptr<StepBudget> ownBudget;
+    StepBudget* budget = nullptr;
+    // Globals indexed by id; workers read the table of the evaluator they
+    // were made from instead
+    std::vector<Symbol> globals;
+    const std::vector<Symbol>* outerGlobals = nullptr;
+    std::unordered_map<int, Symbol> shadow;
+    // `it` and `acc` of the map/filter/reduce body being run
+    Symbol element[2];
+
+    // Frames of active user function calls, each a contiguous run of slots
+    std::vector<Symbol> stack;
+    size_t frameBase = 0;
+    size_t frameSize = 0;
+    size_t callDepth = 0;
+    // Set by a return statement until the call owning the frame takes over
+    bool returning = false;
+    Symbol returnValue;
+    // Set instead of returnValue by `return f(...)`; the call loop runs f next
+    const FunctionDecl* tailCallee = nullptr;
+    std::vector<Symbol> tailArgs;
+
     Symbol evalBinary(const Expr* expr);
     Symbol evalUnary(const Expr* expr);
     Symbol evalStringSlice(const Expr* expr);
+    Symbol evalListIndex(const Expr* expr, const Symbol& list);
+    Symbol evalCall(const Expr* expr);
+    Symbol evalListLiteral(const Expr* expr);
     Symbol evalMethodCall(const Expr* expr);
+    Symbol evalListBuiltin(const Expr* expr, const Symbol& list);
+    void forEachWorkerChunk(const Expr* body, size_t count,
+                            const std::function<void(Evaluator& worker, size_t begin, size_t end)>& run);
+    Symbol evalDataBuiltin(const Expr* expr);
+    Symbol evalMapLiteral(const Expr* expr);
+    Symbol evalMapIndex(const Expr* expr, const Symbol& map);
+    Symbol evalMapMethod(const Expr* expr, const Symbol& map);
+    // Runs `m = m.set(k, v)` or `m = m.remove(k)` without copying m's
+    // table; false if stmt is not one of those
+    bool updateMapInPlace(const AssignStmt* stmt);
+    Symbol convertMap(const Symbol& value, const Type& target);
     void evalPrintStmt(const PrintStmt* stmt);
+    void executeStmt(const Stmt* stmt);
+    void step(int line) {
+        if (budget && budget->taken.fetch_add(1, std::memory_order_relaxed) >= budget->steps) {
+            throw StepLimitExceeded(line, "exceeded " + std::to_string(budget->steps) + " steps");
+        }
+    }
+    void executeBlock(const std::vector<std::unique_ptr<Stmt>>& body);
+    Symbol convertSymbol(const Symbol& value, const Type& target);
+    void coerce(Symbol& value, const Type& target);
+    void bind(Storage storage, int slot, Symbol value);
+    Symbol callFunction(const Expr* expr);
+    // callFunction on a fresh stack segment, for calls nested too deep for the current one
+    Symbol callOnNewSegment(const Expr* expr);
+    void executeReturn(const ReturnStmt* stmt);
+    Symbol evalBody(const Expr* body, const Symbol& value);
+    Symbol reduceRange(const Expr* body, const Symbol& list, size_t begin, size_t end);
 };
 
 #endif
\ No newline at end of file
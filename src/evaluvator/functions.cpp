@@ -0,0 +1,210 @@
+#include "evaluator.h"
+#include "profiler.h"
+#include "../util/diagnostics.h"
+#include <functional>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Calls to user functions. A call pushes one frame of fn->frame_size slots
+// onto the evaluator's stack and pops it on return; nothing is allocated per
+// call beyond growing that vector. `return f(...)` leaves its arguments in
+// tailArgs, and the call loop below runs f in the same frame, so tail
+// recursion neither deepens the native stack nor grows the frame stack.
+
+// Non-tail recursion nests evalExpr on the native stack, which runs out long
+// before the frame stack would. A call made with less than kStackReserve of
+// the thread's stack left continues on a stack segment of its own, so the
+// depth of recursion is bounded by kMaxSegments segments rather than by the
+// size of whichever thread runs it. Segments are mapped on first use and
+// kept for the thread's next deep call; only the pages touched take memory.
+static const size_t kStackReserve = 256 * 1024;
+static const size_t kSegmentSize = 64 << 20;
+static const size_t kMaxSegments = 16;
+
+static const char* stackLimit() {
+    pthread_attr_t attr;
+    void* low = nullptr;
+    size_t size = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        pthread_attr_getstack(&attr, &low, &size);
+        pthread_attr_destroy(&attr);
+    }
+    return low ? static_cast<const char*>(low) + kStackReserve : nullptr;
+}
+
+namespace {
+
+struct StackSegments {
+    // Below this address the stack in use is running out
+    const char* limit = stackLimit();
+    // Lowest address of every segment mapped so far; the first inUse are active
+    vector<char*> mapped;
+    size_t inUse = 0;
+
+    ~StackSegments() {
+        for (char* segment : mapped) munmap(segment, kSegmentSize);
+    }
+};
+
+// A body run on a segment, and what it threw
+struct SegmentCall {
+    ucontext_t caller;
+    const function<void()>* body;
+    exception_ptr error;
+};
+
+} // namespace
+
+static thread_local StackSegments segments;
+static thread_local SegmentCall* startingCall = nullptr;
+
+static void enterSegment() {
+    SegmentCall* call = startingCall;
+    // Exceptions cannot unwind past the segment's first frame; the caller
+    // rethrows them on its own stack
+    try {
+        (*call->body)();
+    } catch (...) {
+        call->error = current_exception();
+    }
+}
+
+// Runs body on the next segment, mapping it first if needed
+static void runOnSegment(const function<void()>& body) {
+    if (segments.inUse == segments.mapped.size()) {
+        void* memory = mmap(nullptr, kSegmentSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (memory == MAP_FAILED) throw bad_alloc();
+        // Guard page, in case something overruns the reserve
+        mprotect(memory, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+        segments.mapped.push_back(static_cast<char*>(memory));
+    }
+    char* low = segments.mapped[segments.inUse++];
+    const char* outerLimit = segments.limit;
+    segments.limit = low + kStackReserve;
+
+    SegmentCall call;
+    call.body = &body;
+    ucontext_t callee;
+    getcontext(&callee);
+    callee.uc_stack.ss_sp = low;
+    callee.uc_stack.ss_size = kSegmentSize;
+    callee.uc_link = &call.caller;
+    makecontext(&callee, enterSegment, 0);
+    startingCall = &call;
+    swapcontext(&call.caller, &callee);
+
+    segments.limit = outerLimit;
+    segments.inUse--;
+    if (call.error) rethrow_exception(call.error);
+}
+
+// Shared rather than built per call, which would put another Symbol in
+// every call's native frame
+static const Symbol& emptySlot() {
+    static const Symbol slot = [] {
+        Symbol empty;
+        empty.type = i32Type();
+        empty.int_value = 0;
+        empty.double_value = 0.0;
+        return empty;
+    }();
+    return slot;
+}
+
+Symbol Evaluator::callOnNewSegment(const Expr* expr) {
+    if (segments.inUse == kMaxSegments) {
+        runtimeError(expr->line, "recursion too deep calling " + expr->function->name + " (" +
+                                     to_string(callDepth) + " nested calls)");
+    }
+    Symbol result;
+    runOnSegment([&] { result = callFunction(expr); });
+    return result;
+}
+
+Symbol Evaluator::callFunction(const Expr* expr) {
+    // Stacks grow down on every target we build for
+    if (segments.limit && static_cast<const char*>(__builtin_frame_address(0)) < segments.limit) {
+        return callOnNewSegment(expr);
+    }
+
+    const FunctionDecl* fn = expr->function;
+    vector<Symbol> args;
+    args.reserve(expr->args.size());
+    for (size_t i = 0; i < expr->args.size(); ++i) {
+        args.push_back(evalExpr(expr->args[i].get()));
+        coerce(args.back(), fn->params[i].type);
+    }
+
+    callDepth++;
+    if (budget && callDepth > budget->depth) {
+        throw StepLimitExceeded(expr->line, "exceeded " + to_string(budget->depth) + " nested calls");
+    }
+    if (profiler) profiler->enterCall(fn);
+
+    size_t callerBase = frameBase;
+    size_t callerSize = frameSize;
+    size_t base = stack.size();
+    while (true) {
+        stack.resize(base + fn->frame_size, emptySlot());
+        for (size_t i = 0; i < args.size(); ++i) {
+            stack[base + i] = std::move(args[i]);
+        }
+        frameBase = base;
+        frameSize = fn->frame_size;
+
+        executeBlock(fn->body);
+        if (!returning) {
+            if (fn->return_type.kind != TypeKind::Unknown) {
+                runtimeError(fn->line, fn->name + " ended without returning a value");
+            }
+            returnValue = emptySlot();
+        }
+        returning = false;
+        if (!tailCallee) break;
+
+        // The tail callee starts over in this frame
+        if (profiler) {
+            profiler->leaveCall();
+            profiler->enterCall(tailCallee);
+        }
+        fn = tailCallee;
+        tailCallee = nullptr;
+        args.swap(tailArgs);
+        tailArgs.clear();
+        stack.resize(base);
+    }
+
+    stack.resize(base);
+    frameBase = callerBase;
+    frameSize = callerSize;
+    callDepth--;
+    if (profiler) profiler->leaveCall();
+    return std::move(returnValue);
+}
+
+void Evaluator::executeReturn(const ReturnStmt* stmt) {
+    if (stmt->tail_call) {
+        const Expr* call = stmt->expr.get();
+        const FunctionDecl* callee = call->function;
+        // Arguments may make calls of their own, which use tailArgs too
+        vector<Symbol> args;
+        args.reserve(call->args.size());
+        for (size_t i = 0; i < call->args.size(); ++i) {
+            args.push_back(evalExpr(call->args[i].get()));
+            coerce(args.back(), callee->params[i].type);
+        }
+        tailArgs.swap(args);
+        tailCallee = callee;
+    } else if (stmt->expr) {
+        returnValue = evalExpr(stmt->expr.get());
+        coerce(returnValue, stmt->return_type);
+    } else {
+        returnValue = emptySlot();
+    }
+    returning = true;
+}
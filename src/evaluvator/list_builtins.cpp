@@ -0,0 +1,284 @@
+#include "evaluator.h"
+#include "values.h"
+#include "../runtime/output.h"
+#include "../runtime/parallel.h"
+#include <cstring>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+// map/filter/reduce/sum/sort over lists. Large lists are split into chunks
+// that run on the default thread pool; each chunk evaluates the body with its
+// own worker Evaluator, which reads the outer globals and a copy of the
+// calling function's frame when there is one.
+
+Symbol Evaluator::evalBody(const Expr* body, const Symbol& value) {
+    step(body->line);
+    element[0] = value;
+    return evalExpr(body);
+}
+
+Symbol Evaluator::reduceRange(const Expr* body, const Symbol& list, size_t begin, size_t end) {
+    Symbol acc = listElement(list, begin);
+    for (size_t i = begin + 1; i < end; ++i) {
+        element[1] = std::move(acc);
+        acc = evalBody(body, listElement(list, i));
+    }
+    return acc;
+}
+
+// Output of the chunks of one parallel map/filter/reduce, keyed by the
+// first element of each chunk
+struct ChunkOutput {
+    size_t end;
+    bool finished = false;
+    StringSink text;
+    OutputBuffer buffer{&text, 4096};
+
+    explicit ChunkOutput(size_t end) : end(end) {}
+};
+
+// Runs run(worker, begin, end) over the chunks of [0, count), each with a
+// worker Evaluator of its own. A body that calls a user function may print,
+// and workers must not share one OutputBuffer, so when chunks run in
+// parallel each prints into its own buffer. The buffers are written out in
+// list order, which is the order a serial run prints in. If a chunk fails,
+// only the output up to and including that chunk is written.
+void Evaluator::forEachWorkerChunk(const Expr* body, size_t count,
+                                   const function<void(Evaluator& worker, size_t begin, size_t end)>& run) {
+    if (!runsInParallel(count) || !callsFunction(body)) {
+        forEachChunk(count, [&](size_t begin, size_t end) {
+            Evaluator worker(this);
+            run(worker, begin, end);
+        });
+        return;
+    }
+
+    mutex chunksLock;
+    map<size_t, unique_ptr<ChunkOutput>> chunks;
+    auto writeChunks = [&] {
+        size_t next = 0;
+        for (auto& entry : chunks) {
+            if (entry.first != next) break;
+            ChunkOutput& chunk = *entry.second;
+            chunk.buffer.flush();
+            output.write(chunk.text.text);
+            if (!chunk.finished) break;
+            next = chunk.end;
+        }
+    };
+    try {
+        forEachChunk(count, [&](size_t begin, size_t end) {
+            ChunkOutput* chunk;
+            {
+                lock_guard<mutex> guard(chunksLock);
+                chunk = (chunks[begin] = make_unique<ChunkOutput>(end)).get();
+            }
+            Evaluator worker(this, chunk->buffer);
+            run(worker, begin, end);
+            chunk->finished = true;
+        });
+    } catch (...) {
+        writeChunks();
+        throw;
+    }
+    writeChunks();
+}
+
+static shared_ptr<DenseArray> selectDense(const DenseArray& source, const vector<size_t>& indices) {
+    auto array = make_shared<DenseArray>();
+    array->element = source.element;
+    array->count = indices.size();
+    size_t width = denseElementSize(source.element.kind);
+    array->storage.resize(indices.size() * width);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        memcpy(array->storage.data() + i * width, source.data() + indices[i] * width, width);
+    }
+    return array;
+}
+
+// A reduce body that can fold chunks separately and combine their results
+// without changing the answer: acc + it or acc * it over integers, which
+// wrap the same way however the elements are grouped. Any other body is
+// folded serially, left to right.
+static bool isAssociativeFold(const Expr* body, const Symbol& list) {
+    if (body->kind != ExprKind::Binary || (body->op != "+" && body->op != "*")) return false;
+    if (!list.type.element || !isIntegerKind(list.type.element->kind)) return false;
+    auto isElement = [](const Expr* expr, int slot) {
+        return expr->kind == ExprKind::Identifier && expr->storage == Storage::Element && expr->slot == slot;
+    };
+    return (isElement(body->left.get(), 1) && isElement(body->right.get(), 0)) ||
+           (isElement(body->left.get(), 0) && isElement(body->right.get(), 1));
+}
+
+Symbol Evaluator::evalListBuiltin(const Expr* expr, const Symbol& list) {
+    const string& method = expr->method_name;
+    size_t count = listLength(list);
+    Symbol result;
+
+    if (method == "map") {
+        const Expr* body = expr->args[0].get();
+        result.list_values.resize(count);
+        forEachWorkerChunk(body, count, [&](Evaluator& worker, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                result.list_values[i] = worker.evalBody(body, listElement(list, i));
+            }
+        });
+        if (count > 0) {
+            result.type = listType(new Type(result.list_values[0].type));
+        } else {
+            result.type = expr->type;
+        }
+        return result;
+    }
+
+    if (method == "filter") {
+        const Expr* body = expr->args[0].get();
+        mutex keptLock;
+        vector<pair<size_t, vector<size_t>>> chunks;
+        forEachWorkerChunk(body, count, [&](Evaluator& worker, size_t begin, size_t end) {
+            vector<size_t> indices;
+            for (size_t i = begin; i < end; ++i) {
+                if (isTruthy(worker.evalBody(body, listElement(list, i)))) {
+                    indices.push_back(i);
+                }
+            }
+            lock_guard<mutex> guard(keptLock);
+            chunks.emplace_back(begin, std::move(indices));
+        });
+        sort(chunks.begin(), chunks.end(),
+             [](const pair<size_t, vector<size_t>>& a, const pair<size_t, vector<size_t>>& b) {
+                 return a.first < b.first;
+             });
+
+        vector<size_t> indices;
+        for (auto& chunk : chunks) {
+            indices.insert(indices.end(), chunk.second.begin(), chunk.second.end());
+        }
+        result.type = list.type;
+        if (list.range) {
+            vector<double> values;
+            values.reserve(indices.size());
+            for (size_t index : indices) {
+                values.push_back((double)list.range->at(index));
+            }
+            result.dense = makeDenseArray(list.type.element ? *list.type.element : i32Type(), values);
+        } else if (list.dense) {
+            result.dense = selectDense(*list.dense, indices);
+        } else {
+            result.list_values.reserve(indices.size());
+            for (size_t index : indices) {
+                result.list_values.push_back(list.list_values[index]);
+            }
+        }
+        return result;
+    }
+
+    if (method == "reduce") {
+        if (count == 0) {
+            result.type = i32Type();
+            result.int_value = 0;
+            return result;
+        }
+        const Expr* body = expr->args[0].get();
+        if (!runsInParallel(count) || !isAssociativeFold(body, list)) {
+            Evaluator worker(this);
+            return worker.reduceRange(body, list, 0, count);
+        }
+        // Chunks are folded independently and then combined in order
+        vector<pair<size_t, Symbol>> partials;
+        mutex partialsLock;
+        forEachWorkerChunk(body, count, [&](Evaluator& worker, size_t begin, size_t end) {
+            Symbol partial = worker.reduceRange(body, list, begin, end);
+            lock_guard<mutex> guard(partialsLock);
+            partials.emplace_back(begin, partial);
+        });
+        sort(partials.begin(), partials.end(),
+             [](const pair<size_t, Symbol>& a, const pair<size_t, Symbol>& b) { return a.first < b.first; });
+
+        Evaluator combiner(this);
+        result = partials[0].second;
+        for (size_t i = 1; i < partials.size(); ++i) {
+            combiner.element[1] = std::move(result);
+            result = combiner.evalBody(body, partials[i].second);
+        }
+        return result;
+    }
+
+    if (method == "sum") {
+        if (list.range) {
+            result.type = i32Type();
+            result.int_value = (int)list.range->sum();
+            return result;
+        }
+        bool integers = list.type.element ? isIntegerKind(list.type.element->kind)
+                                          : (count > 0 && !isFloatValue(listElement(list, 0)));
+        // Per chunk, keyed by its first element, and added in list order so
+        // a float sum doesn't depend on which chunk finishes first
+        mutex partialsLock;
+        map<size_t, pair<long long, double>> partials;
+        forEachChunk(count, [&](size_t begin, size_t end) {
+            long long intPartial = 0;
+            double floatPartial = 0.0;
+            if (list.dense) {
+                for (size_t i = begin; i < end; ++i) {
+                    double value = list.dense->valueAt(i);
+                    if (integers) intPartial += (long long)value; else floatPartial += value;
+                }
+            } else {
+                for (size_t i = begin; i < end; ++i) {
+                    const Symbol& element = list.list_values[i];
+                    if (integers) intPartial += element.int_value; else floatPartial += numericValue(element);
+                }
+            }
+            lock_guard<mutex> guard(partialsLock);
+            partials[begin] = { intPartial, floatPartial };
+        });
+        long long intTotal = 0;
+        double floatTotal = 0.0;
+        for (const auto& entry : partials) {
+            intTotal += entry.second.first;
+            floatTotal += entry.second.second;
+        }
+        if (integers) {
+            result.type = i32Type();
+            result.int_value = (int)intTotal;
+        } else {
+            result.type = f64Type();
+            result.double_value = floatTotal;
+        }
+        return result;
+    }
+
+    if (method == "sort") {
+        result.type = list.type;
+        if (list.range) {
+            // Already ordered; a descending range is the same range reversed
+            auto range = make_shared<LazyRange>(*list.range);
+            if (range->step < 0 && range->size() > 0) {
+                range->start = list.range->at(list.range->size() - 1);
+                range->step = -list.range->step;
+                range->stop = range->start + (long long)list.range->size() * range->step;
+            }
+            result.range = range;
+        } else if (list.dense) {
+            vector<double> values = listNumbers(list);
+            parallelSort(values, [](double a, double b) { return a < b; });
+            result.dense = makeDenseArray(list.dense->element, values);
+        } else if (count > 0 && list.list_values[0].type.kind == TypeKind::String) {
+            result.list_values = list.list_values;
+            parallelSort(result.list_values, [](const Symbol& a, const Symbol& b) {
+                return a.string_value < b.string_value;
+            });
+        } else {
+            result.list_values = list.list_values;
+            parallelSort(result.list_values, [](const Symbol& a, const Symbol& b) {
+                return numericValue(a) < numericValue(b);
+            });
+        }
+        return result;
+    }
+
+    return result;
+}
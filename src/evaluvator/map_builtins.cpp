@@ -0,0 +1,149 @@
+#include "evaluator.h"
+#include "values.h"
+#include "../semantics/semantic.h"
+#include "../util/diagnostics.h"
+
+using namespace std;
+
+// Maps are values: copies share one table until a copy changes, when it
+// takes a table of its own. Assigning a changed map back to the variable it
+// came from changes the table in place instead, so a map filled one key at
+// a time costs one insert per key rather than one copy.
+
+static string describeKey(const Symbol& key) {
+    if (key.type.kind == TypeKind::String) return "\"" + key.string_value + "\"";
+    return to_string(key.int_value);
+}
+
+Symbol Evaluator::evalMapLiteral(const Expr* expr) {
+    Symbol result;
+    result.type = expr->type;
+    auto table = make_shared<MapTable>();
+    table->reserve(expr->elements.size());
+    string scratch;
+    for (size_t i = 0; i < expr->elements.size(); ++i) {
+        Symbol key = evalExpr(expr->elements[i].get());
+        Symbol value = evalExpr(expr->args[i].get());
+        coerce(value, *expr->type.element);
+        table->set(mapKey(key, scratch), std::move(value));
+    }
+    result.map = table;
+    return result;
+}
+
+Symbol Evaluator::evalMapIndex(const Expr* expr, const Symbol& map) {
+    Symbol key = evalExpr(expr->start.get());
+    string scratch;
+    const Symbol* value = map.map->find(mapKey(key, scratch));
+    if (!value) runtimeError(expr->line, "no key " + describeKey(key) + " in the map");
+    return *value;
+}
+
+Symbol Evaluator::evalMapMethod(const Expr* expr, const Symbol& map) {
+    const string& method = expr->method_name;
+    const MapTable& table = *map.map;
+    Symbol result;
+    result.type = expr->type;
+
+    if (method == "len") {
+        result.int_value = (int)table.size();
+        return result;
+    }
+    if (method == "keys" || method == "values") {
+        bool keys = method == "keys";
+        result.list_values.reserve(table.size());
+        table.forEach([&](string_view key, const Symbol& value) {
+            result.list_values.push_back(keys ? mapKeySymbol(key, *map.type.key) : value);
+        });
+        return result;
+    }
+
+    Symbol key = evalExpr(expr->args[0].get());
+    string scratch;
+    string_view bytes = mapKey(key, scratch);
+    if (method == "has") {
+        result.int_value = table.find(bytes) ? 1 : 0;
+        return result;
+    }
+    if (method == "get") {
+        const Symbol* value = table.find(bytes);
+        if (value) return *value;
+        Symbol fallback = evalExpr(expr->args[1].get());
+        coerce(fallback, *map.type.element);
+        return fallback;
+    }
+
+    // set and remove
+    auto changed = make_shared<MapTable>(table);
+    if (method == "set") {
+        Symbol value = evalExpr(expr->args[1].get());
+        coerce(value, *map.type.element);
+        changed->set(bytes, std::move(value));
+    } else {
+        changed->erase(bytes);
+    }
+    result.type = map.type;
+    result.map = changed;
+    return result;
+}
+
+bool Evaluator::updateMapInPlace(const AssignStmt* stmt) {
+    const Expr* call = stmt->expr.get();
+    if (call->kind != ExprKind::MethodCall || (call->method_name != "set" && call->method_name != "remove")) {
+        return false;
+    }
+    const Expr* object = call->left.get();
+    if (object->kind != ExprKind::Identifier || object->storage != stmt->storage || object->slot != stmt->slot ||
+        stmt->target_type.kind != TypeKind::Map) {
+        return false;
+    }
+    bool local = stmt->storage == Storage::Local;
+    if (!local && (stmt->storage != Storage::Global || outerGlobals || (size_t)stmt->slot >= globals.size())) {
+        return false;
+    }
+
+    // The receiver is read before the arguments, as evalMapMethod would, so
+    // nothing is evaluated twice when this falls back
+    const Symbol& receiver = local ? stack[frameBase + stmt->slot] : globals[stmt->slot];
+    if (!receiver.map) return false;
+    shared_ptr<const MapTable> original = receiver.map;
+
+    // Arguments next: they may call functions, which can move the stack
+    Symbol key = evalExpr(call->args[0].get());
+    Symbol value;
+    if (call->method_name == "set") {
+        value = evalExpr(call->args[1].get());
+        coerce(value, *stmt->target_type.element);
+    }
+    Symbol& target = local ? stack[frameBase + stmt->slot] : globals[stmt->slot];
+    // A call in the arguments may have rebound the map or kept the table;
+    // either way the update applies to a copy of the table read first
+    if (target.map != original || original.use_count() != 2) {
+        target.map = make_shared<MapTable>(*original);
+    }
+    original.reset();
+    // No other value holds the table, so changing it is invisible
+    MapTable& table = const_cast<MapTable&>(*target.map);
+    string scratch;
+    if (call->method_name == "set") {
+        table.set(mapKey(key, scratch), std::move(value));
+    } else {
+        table.erase(mapKey(key, scratch));
+    }
+    return true;
+}
+
+Symbol Evaluator::convertMap(const Symbol& value, const Type& target) {
+    if (sameType(value.type, target)) return value;
+    Symbol result;
+    result.type = target;
+    auto table = make_shared<MapTable>();
+    if (value.map) {
+        table->reserve(value.map->size());
+        value.map->forEach([&](string_view key, const Symbol& element) {
+            table->set(key, convertSymbol(element, *target.element));
+        });
+    }
+    result.map = table;
+    return result;
+}
@@ -0,0 +1,218 @@
+#include "profiler.h"
+#include "../runtime/memory.h"
+#include <algorithm>
+#include <iomanip>
+#include <typeinfo>
+
+using namespace std;
+
+// Function frames are keyed apart from statements at the same position
+static const uint64_t kCallKey = 1ull << 63;
+
+static uint64_t positionKey(int line, int column) {
+    return ((uint64_t)(uint32_t)line << 32) | (uint32_t)column;
+}
+
+static string describe(const Stmt* stmt) {
+    if (auto letStmt = dynamic_cast<const LetStmt*>(stmt)) {
+        return (letStmt->constant ? "const " : "let ") + letStmt->name;
+    } else if (dynamic_cast<const PrintStmt*>(stmt)) {
+        return "print";
+    } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt)) {
+        return assignStmt->name + " =";
+    } else if (dynamic_cast<const WhileStmt*>(stmt)) {
+        return "while";
+    } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt)) {
+        return "for " + forStmt->var;
+    } else if (dynamic_cast<const IfStmt*>(stmt)) {
+        return "if";
+    } else if (dynamic_cast<const ReturnStmt*>(stmt)) {
+        return "return";
+    } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt)) {
+        const Expr* expr = exprStmt->expr.get();
+        if (expr->kind == ExprKind::Call) return expr->name + "()";
+        if (expr->kind == ExprKind::MethodCall) return "." + expr->method_name + "()";
+        return "expression";
+    } else if (auto fn = dynamic_cast<const FunctionDecl*>(stmt)) {
+        return "fn " + fn->name;
+    }
+    return "statement";
+}
+
+Profiler::Profiler() : begin(Clock::now()) {
+    nodes.emplace_back();
+    nodes[0].label = "main";
+    frames.push_back(Frame{0, -1, begin, allocatedBytes()});
+}
+
+void Profiler::enter(const Stmt* stmt) {
+    // Lets hoisted out of a loop keep the loop's position
+    uint64_t key = positionKey(stmt->line, stmt->column) ^ (typeid(*stmt).hash_code() & ~kCallKey);
+    auto found = lineIndex.find(key);
+    size_t index;
+    if (found != lineIndex.end()) {
+        index = found->second;
+    } else {
+        index = lines.size();
+        lineIndex.emplace(key, index);
+        LineStats stats;
+        stats.line = stmt->line;
+        stats.label = describe(stmt);
+        lines.push_back(std::move(stats));
+    }
+    LineStats& stats = lines[index];
+    stats.count++;
+    stats.active++;
+    size_t node = child(frames.back().node, key);
+    if (nodes[node].label.empty()) {
+        nodes[node].label = stats.label + " (line " + to_string(stats.line) + ")";
+    }
+    push(node, (long)index);
+}
+
+void Profiler::leave() {
+    pop();
+}
+
+void Profiler::enterCall(const FunctionDecl* fn) {
+    uint64_t key = positionKey(fn->line, fn->column) | kCallKey;
+    // A direct recursive call goes back to its caller's node, so the tree
+    // grows with the program rather than the depth of the recursion
+    size_t node = nodes.size();
+    for (size_t i = frames.size() - 1; i > 0; --i) {
+        if (frames[i].stats < 0) {
+            if (nodes[frames[i].node].key == key) node = frames[i].node;
+            break;
+        }
+    }
+    if (node == nodes.size()) {
+        node = child(frames.back().node, key);
+    }
+    if (nodes[node].label.empty()) {
+        nodes[node].label = fn->name;
+    }
+    push(node, -1);
+}
+
+void Profiler::leaveCall() {
+    pop();
+}
+
+size_t Profiler::child(size_t node, uint64_t key) {
+    auto found = nodes[node].children.find(key);
+    if (found != nodes[node].children.end()) {
+        return found->second;
+    }
+    size_t index = nodes.size();
+    nodes[node].children.emplace(key, index);
+    nodes.emplace_back();
+    nodes.back().key = key;
+    return index;
+}
+
+void Profiler::push(size_t node, long stats) {
+    frames.push_back(Frame{node, stats, Clock::now(), allocatedBytes()});
+}
+
+void Profiler::pop() {
+    Clock::time_point now = Clock::now();
+    uint64_t bytes = allocatedBytes();
+    Frame frame = frames.back();
+    frames.pop_back();
+
+    uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(now - frame.start).count();
+    uint64_t selfNs = ns > frame.childNs ? ns - frame.childNs : 0;
+    bytes -= frame.startBytes;
+    nodes[frame.node].selfNs += selfNs;
+    if (frame.stats >= 0) {
+        LineStats& stats = lines[frame.stats];
+        stats.selfNs += selfNs;
+        stats.selfBytes += bytes - frame.childBytes;
+        if (--stats.active == 0) {
+            stats.totalNs += ns;
+        }
+    }
+    frames.back().childNs += ns;
+    frames.back().childBytes += bytes;
+}
+
+void Profiler::printReport(ostream& out) const {
+    uint64_t elapsedNs = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - begin).count();
+    uint64_t executed = 0;
+    for (const LineStats& stats : lines) {
+        executed += stats.count;
+    }
+
+    vector<const LineStats*> sorted;
+    for (const LineStats& stats : lines) {
+        sorted.push_back(&stats);
+    }
+    stable_sort(sorted.begin(), sorted.end(),
+                [](const LineStats* a, const LineStats* b) { return a->selfNs > b->selfNs; });
+
+    auto ms = [](uint64_t ns) { return ns / 1e6; };
+    out << "Profile: " << fixed << setprecision(3) << ms(elapsedNs) << " ms, " << executed
+        << " statements executed, " << allocatedBytes() << " bytes allocated\n";
+    out << right << setw(8) << "line" << setw(12) << "count" << setw(12) << "total ms" << setw(12) << "self ms"
+        << setw(14) << "self bytes" << "  statement\n";
+    for (const LineStats* stats : sorted) {
+        out << setw(8) << stats->line << setw(12) << stats->count << setw(12) << ms(stats->totalNs)
+            << setw(12) << ms(stats->selfNs) << setw(14) << stats->selfBytes << "  " << stats->label << "\n";
+    }
+    out << defaultfloat;
+}
+
+void Profiler::writeFolded(ostream& out) const {
+    // Depth first with an explicit stack, since the tree may be deeper
+    // than the native stack. path holds the labels down to the node being
+    // written; each entry remembers how much of it belongs to its parent.
+    struct Pending {
+        size_t node;
+        size_t prefixLength;
+        size_t depth;
+    };
+    vector<Pending> pending = { Pending{0, 0, 1} };
+    string path;
+    while (!pending.empty()) {
+        Pending next = pending.back();
+        pending.pop_back();
+        path.resize(next.prefixLength);
+        if (!path.empty()) path += ';';
+
+        if (next.depth > kMaxFoldedDepth) {
+            uint64_t ns = subtreeNs(next.node);
+            if (ns >= 1000) {
+                out << path << "[truncated] " << ns / 1000 << "\n";
+            }
+            continue;
+        }
+        path += nodes[next.node].label;
+        uint64_t selfNs = nodes[next.node].selfNs;
+        if (next.node == 0) {
+            // The outermost frame is still open
+            uint64_t elapsedNs = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - begin).count();
+            selfNs = elapsedNs > frames[0].childNs ? elapsedNs - frames[0].childNs : 0;
+        }
+        if (selfNs >= 1000) {
+            out << path << " " << selfNs / 1000 << "\n";
+        }
+        for (const auto& entry : nodes[next.node].children) {
+            pending.push_back(Pending{entry.second, path.size(), next.depth + 1});
+        }
+    }
+}
+
+// Self time of node and everything below it
+uint64_t Profiler::subtreeNs(size_t node) const {
+    uint64_t ns = 0;
+    vector<size_t> pending = { node };
+    while (!pending.empty()) {
+        size_t next = pending.back();
+        pending.pop_back();
+        ns += nodes[next].selfNs;
+        for (const auto& entry : nodes[next].children) {
+            pending.push_back(entry.second);
+        }
+    }
+    return ns;
+}
@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "../parser/ast.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Attributes wall time, execution counts and allocated bytes to source
+// statements while a program runs. The evaluator calls enter/leave around
+// every statement it executes and enterCall/leaveCall around every user
+// function call. Statements are keyed by their position, so statements
+// copied by the inliner count towards the lines they were copied from, and
+// statements freed after running (images, --stream) keep their totals.
+// Only the evaluating thread reports: work done by list builtin and device
+// workers counts towards the statement that started it.
+class Profiler {
+public:
+    Profiler();
+
+    void enter(const Stmt* stmt);
+    void leave();
+    void enterCall(const FunctionDecl* fn);
+    void leaveCall();
+
+    // One line per statement, most self time first
+    void printReport(std::ostream& out) const;
+    // Self time in microseconds per call stack, one "frame;frame;... value"
+    // line each, the input format of flame graph tools. A function calling
+    // itself directly shows as one frame; stacks deeper than kMaxFoldedDepth
+    // frames end in a [truncated] frame holding the time below it.
+    void writeFolded(std::ostream& out) const;
+
+    static const size_t kMaxFoldedDepth = 512;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct LineStats {
+        int line = 0;
+        std::string label;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t selfNs = 0;
+        uint64_t selfBytes = 0;
+        // Activations on the stack; recursion adds to totalNs only once
+        int active = 0;
+    };
+
+    // A call stack, as a node of the tree of all stacks seen
+    struct StackNode {
+        std::string label;
+        // The key it is found under in its parent
+        uint64_t key = 0;
+        uint64_t selfNs = 0;
+        std::unordered_map<uint64_t, size_t> children;
+    };
+
+    struct Frame {
+        size_t node;
+        // Index into lines, or -1 for a function call
+        long stats;
+        Clock::time_point start;
+        uint64_t startBytes;
+        uint64_t childNs = 0;
+        uint64_t childBytes = 0;
+    };
+
+    Clock::time_point begin;
+    std::vector<LineStats> lines;
+    std::unordered_map<uint64_t, size_t> lineIndex;
+    std::vector<StackNode> nodes;
+    std::vector<Frame> frames;
+
+    // Created with an empty label for the caller to fill in
+    size_t child(size_t node, uint64_t key);
+    void push(size_t node, long stats);
+    void pop();
+    uint64_t subtreeNs(size_t node) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "values.h"
+#include "../runtime/numeric.h"
+#include <cstring>
+
+using namespace std;
+
+bool isFloatValue(const Symbol& value) {
+    return isFloatKind(value.type.kind) || value.type.kind == TypeKind::Q8;
+}
+
+double numericValue(const Symbol& value) {
+    if (value.type.kind == TypeKind::Q8) {
+        return dequantizeQ8((int8_t)value.int_value, (float)value.type.scale, value.type.zero_point);
+    }
+    if (isFloatKind(value.type.kind)) {
+        return value.double_value;
+    }
+    return value.int_value;
+}
+
+bool isTruthy(const Symbol& value) {
+    if (value.type.kind == TypeKind::String) {
+        return !value.string_value.empty();
+    }
+    return numericValue(value) != 0.0;
+}
+
+size_t listLength(const Symbol& list) {
+    if (list.range) {
+        return list.range->size();
+    }
+    return list.dense ? list.dense->count : list.list_values.size();
+}
+
+Symbol listElement(const Symbol& list, size_t index) {
+    if (list.range) {
+        Symbol element;
+        element.type = list.type.element ? *list.type.element : i32Type();
+        element.int_value = (int)list.range->at(index);
+        return element;
+    }
+    if (!list.dense) {
+        return list.list_values[index];
+    }
+
+    Symbol element;
+    double value = list.dense->valueAt(index);
+    TypeKind kind = list.dense->element.kind;
+    if (isIntegerKind(kind)) {
+        element.type = list.dense->element;
+        element.int_value = (int)value;
+    } else {
+        // Quantized elements come out dequantized
+        element.type = kind == TypeKind::Q8 ? f32Type() : list.dense->element;
+        element.double_value = value;
+    }
+    return element;
+}
+
+vector<double> listNumbers(const Symbol& list) {
+    vector<double> values;
+    if (list.range) {
+        size_t count = list.range->size();
+        values.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back((double)list.range->at(i));
+        }
+    } else if (list.dense) {
+        values.reserve(list.dense->count);
+        for (size_t i = 0; i < list.dense->count; ++i) {
+            values.push_back(list.dense->valueAt(i));
+        }
+    } else {
+        values.reserve(list.list_values.size());
+        for (const auto& element : list.list_values) {
+            values.push_back(numericValue(element));
+        }
+    }
+    return values;
+}
+
+string_view mapKey(const Symbol& key, string& scratch) {
+    if (key.type.kind == TypeKind::String) {
+        return key.string_value;
+    }
+    int64_t value = key.int_value;
+    scratch.assign(reinterpret_cast<const char*>(&value), sizeof(value));
+    return scratch;
+}
+
+Symbol mapKeySymbol(string_view bytes, const Type& keyType) {
+    Symbol key;
+    key.type = keyType;
+    if (keyType.kind == TypeKind::String) {
+        key.string_value.assign(bytes.data(), bytes.size());
+    } else {
+        int64_t value;
+        memcpy(&value, bytes.data(), sizeof(value));
+        key.int_value = (int)value;
+    }
+    return key;
+}
@@ -0,0 +1,25 @@
+#ifndef VALUES_H
+#define VALUES_H
+
+#include "../semantics/symbol_table.h"
+#include <vector>
+
+// Helpers for reading runtime values regardless of how they are stored
+
+// Half precision and quantized values take part in arithmetic as floats
+bool isFloatValue(const Symbol& value);
+double numericValue(const Symbol& value);
+bool isTruthy(const Symbol& value);
+
+// Lists are one Symbol per element, a packed DenseArray or a LazyRange
+size_t listLength(const Symbol& list);
+Symbol listElement(const Symbol& list, size_t index);
+std::vector<double> listNumbers(const Symbol& list);
+
+// Map keys are stored as bytes: a string's own, or an integer's 8 bytes so
+// keys of any integer width find the same entry. scratch backs the bytes of
+// integer keys.
+std::string_view mapKey(const Symbol& key, std::string& scratch);
+Symbol mapKeySymbol(std::string_view bytes, const Type& keyType);
+
+#endif
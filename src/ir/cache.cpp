@@ -0,0 +1,62 @@
+#include "cache.h"
+#include "ir.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+static string cacheDirectory() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) {
+        return string(xdg) + "/exotic";
+    }
+    const char* home = getenv("HOME");
+    if (home && *home) {
+        return string(home) + "/.cache/exotic";
+    }
+    return string();
+}
+
+// mkdir -p
+static bool makeDirectories(const string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == string::npos) return true;
+    }
+}
+
+// Identifies the running compiler, so rebuilding it retires old entries
+static uint64_t compilerStamp() {
+    struct stat info;
+    if (stat("/proc/self/exe", &info) != 0) return 0;
+    uint64_t stamp[3] = {(uint64_t)info.st_mtime, (uint64_t)info.st_size, kImageVersion};
+    return hashBytes(reinterpret_cast<const char*>(stamp), sizeof(stamp));
+}
+
+ProgramCache::ProgramCache(uint64_t sourceKey) : directory(cacheDirectory()) {
+    uint64_t stamp = compilerStamp();
+    key = hashBytes(reinterpret_cast<const char*>(&stamp), sizeof(stamp), sourceKey);
+    if (!directory.empty()) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.gir", (unsigned long long)key);
+        file = directory + name;
+    }
+}
+
+bool ProgramCache::load(ProgramImage& image) const {
+    if (file.empty()) return false;
+    if (image.open(file) && image.sourceHash() == key && image.verify()) return true;
+    // Damaged or unreadable; the caller compiles from source and stores it anew
+    remove(file.c_str());
+    return false;
+}
+
+void ProgramCache::store(const vector<unique_ptr<Stmt>>& program) const {
+    if (file.empty() || !makeDirectories(directory)) return;
+    writeImageFile(file, writeProgramImage(program, key));
+}
@@ -0,0 +1,33 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "../parser/ast.h"
+#include "ir.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Program images of earlier runs, kept in $XDG_CACHE_HOME/exotic (or
+// ~/.cache/exotic) under the hash of the source and of the options that
+// change compilation. A hit is mapped, not read, and skips the front end.
+class ProgramCache {
+public:
+    // sourceKey must change whenever the compiled program would; the
+    // compiler's own identity is mixed in here
+    explicit ProgramCache(uint64_t sourceKey);
+
+    // Opens the entry and checks every statement decodes, so a run never
+    // starts on a damaged image; false, after deleting the entry, if not
+    bool load(ProgramImage& image) const;
+    // Failures are silent; the cache only saves time
+    void store(const std::vector<std::unique_ptr<Stmt>>& program) const;
+
+    const std::string& path() const { return file; }
+
+private:
+    uint64_t key;
+    std::string directory;
+    std::string file;
+};
+
+#endif
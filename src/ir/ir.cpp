@@ -0,0 +1,675 @@
+#include "ir.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace std;
+
+static const char kMagic[4] = {'G', 'L', 'C', 'I'};
+static const uint32_t kNone = 0xffffffffu;
+
+enum class StmtTag : uint8_t {
+    Let,
+    Print,
+    Assign,
+    While,
+    For,
+    If,
+    Function,
+    Return,
+    Expr
+};
+
+// Expr::flags bits
+enum : uint8_t {
+    kSingleIndex = 1,
+    kBoundsCheck = 2,
+    kHasLeft = 4,
+    kHasRight = 8,
+    kHasStart = 16,
+    kHasEnd = 32
+};
+
+// Kinds whose Expr::name is written in place of Expr::string_value
+static bool hasName(ExprKind kind) {
+    return kind == ExprKind::Identifier || kind == ExprKind::Call;
+}
+
+uint64_t hashBytes(const char* data, size_t size, uint64_t seed) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class ImageWriter {
+public:
+    explicit ImageWriter(const vector<unique_ptr<Stmt>>& program) {
+        for (const auto& stmt : program) {
+            if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+                int index = (int)functionIndex.size();
+                functionIndex[fn] = index;
+            }
+        }
+    }
+
+    string write(const vector<unique_ptr<Stmt>>& program, uint64_t sourceHash) {
+        vector<uint32_t> offsets;
+        for (const auto& stmt : program) {
+            offsets.push_back((uint32_t)code.size());
+            writeStmt(stmt.get());
+        }
+
+        ImageHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kImageVersion;
+        header.source_hash = sourceHash;
+
+        string image(sizeof(header), '\0');
+        header.string_count = (uint32_t)strings.size();
+        header.strings_offset = (uint32_t)image.size();
+        for (const string& s : strings) {
+            append(image, (uint32_t)s.size());
+            image += s;
+        }
+        header.type_count = (uint32_t)types.size();
+        header.types_offset = (uint32_t)image.size();
+        for (size_t i = 0; i < types.size(); ++i) {
+            append(image, (uint8_t)types[i].kind);
+            append(image, typeElements[i]);
+            append(image, typeKeys[i]);
+            append(image, types[i].scale);
+            append(image, (int32_t)types[i].zero_point);
+        }
+        header.statement_count = (uint32_t)offsets.size();
+        header.index_offset = (uint32_t)image.size();
+        for (uint32_t offset : offsets) {
+            append(image, offset);
+        }
+        header.code_offset = (uint32_t)image.size();
+        header.code_size = (uint32_t)code.size();
+        image += code;
+        header.content_hash = hashBytes(image.data() + sizeof(header), image.size() - sizeof(header));
+        memcpy(&image[0], &header, sizeof(header));
+        return image;
+    }
+
+private:
+    string code;
+    vector<string> strings;
+    unordered_map<string, uint32_t> stringIndex;
+    vector<Type> types;
+    // Index of each type's element type, kNone if it has none
+    vector<uint32_t> typeElements;
+    // Index of each map type's key type, kNone for other types
+    vector<uint32_t> typeKeys;
+    unordered_map<string, uint32_t> typeIndex;
+    unordered_map<const FunctionDecl*, int> functionIndex;
+
+    template <typename T>
+    static void append(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    void put(T value) {
+        append(code, value);
+    }
+
+    uint32_t internString(const string& s) {
+        auto found = stringIndex.find(s);
+        if (found != stringIndex.end()) return found->second;
+        uint32_t index = (uint32_t)strings.size();
+        strings.push_back(s);
+        stringIndex[s] = index;
+        return index;
+    }
+
+    // Element types are interned before the types containing them, so the
+    // reader can resolve every element index from entries it has already read
+    uint32_t internType(const Type& type) {
+        string key = typeKey(type);
+        auto found = typeIndex.find(key);
+        if (found != typeIndex.end()) return found->second;
+        uint32_t element = type.element ? internType(*type.element) : kNone;
+        uint32_t mapKey = type.key ? internType(*type.key) : kNone;
+        uint32_t index = (uint32_t)types.size();
+        types.push_back(type);
+        typeElements.push_back(element);
+        typeKeys.push_back(mapKey);
+        typeIndex[key] = index;
+        return index;
+    }
+
+    static string typeKey(const Type& type) {
+        string key(1, (char)type.kind);
+        append(key, type.scale);
+        append(key, type.zero_point);
+        if (type.key) key += "[" + typeKey(*type.key) + "]";
+        if (type.element) key += "<" + typeKey(*type.element) + ">";
+        return key;
+    }
+
+    void putString(const string& s) { put(internString(s)); }
+    void putType(const Type& type) { put(internType(type)); }
+
+    void writeExpr(const Expr* expr) {
+        put((uint8_t)expr->kind);
+        putType(expr->type);
+        put((int32_t)expr->line);
+        put((int32_t)expr->column);
+        put((int32_t)expr->int_value);
+        put(expr->double_value);
+        // Identifiers and calls keep their name where a literal keeps its text
+        putString(hasName(expr->kind) ? expr->name.str() : expr->string_value);
+        putString(expr->op);
+        putString(expr->method_name);
+        uint8_t flags = (expr->single_index ? kSingleIndex : 0) | (expr->bounds_check ? kBoundsCheck : 0) |
+                        (expr->left ? kHasLeft : 0) | (expr->right ? kHasRight : 0) |
+                        (expr->start ? kHasStart : 0) | (expr->end ? kHasEnd : 0);
+        put(flags);
+        putBinding(expr->storage, expr->slot);
+        put((int32_t)(expr->function ? functionIndex.at(expr->function) : -1));
+        if (expr->left) writeExpr(expr->left.get());
+        if (expr->right) writeExpr(expr->right.get());
+        if (expr->start) writeExpr(expr->start.get());
+        if (expr->end) writeExpr(expr->end.get());
+        put((uint32_t)expr->elements.size());
+        for (const auto& element : expr->elements) {
+            writeExpr(element.get());
+        }
+        put((uint32_t)expr->args.size());
+        for (const auto& arg : expr->args) {
+            writeExpr(arg.get());
+        }
+    }
+
+    void putBinding(Storage storage, int slot) {
+        put((uint8_t)storage);
+        put((int32_t)slot);
+    }
+
+    void writeOptionalExpr(const Expr* expr) {
+        put((uint8_t)(expr != nullptr));
+        if (expr) writeExpr(expr);
+    }
+
+    void writeBlock(const vector<unique_ptr<Stmt>>& body) {
+        put((uint32_t)body.size());
+        for (const auto& stmt : body) {
+            writeStmt(stmt.get());
+        }
+    }
+
+    void writeHeader(StmtTag tag, const Stmt* stmt) {
+        put((uint8_t)tag);
+        put((int32_t)stmt->line);
+        put((int32_t)stmt->column);
+    }
+
+    void writeStmt(const Stmt* stmt) {
+        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt)) {
+            writeHeader(StmtTag::Let, stmt);
+            putString(letStmt->name);
+            putType(letStmt->declared_type);
+            putType(letStmt->storage_type);
+            putBinding(letStmt->storage, letStmt->slot);
+            put((uint8_t)letStmt->constant);
+            writeExpr(letStmt->expr.get());
+        } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt)) {
+            writeHeader(StmtTag::Print, stmt);
+            writeExpr(printStmt->expr.get());
+        } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt)) {
+            writeHeader(StmtTag::Assign, stmt);
+            putString(assignStmt->name);
+            putType(assignStmt->target_type);
+            putBinding(assignStmt->storage, assignStmt->slot);
+            writeExpr(assignStmt->expr.get());
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt)) {
+            writeHeader(StmtTag::While, stmt);
+            writeExpr(whileStmt->condition.get());
+            writeBlock(whileStmt->body);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt)) {
+            writeHeader(StmtTag::For, stmt);
+            putString(forStmt->var);
+            putBinding(forStmt->storage, forStmt->slot);
+            writeExpr(forStmt->iterable.get());
+            writeBlock(forStmt->body);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt)) {
+            writeHeader(StmtTag::If, stmt);
+            writeExpr(ifStmt->condition.get());
+            writeBlock(ifStmt->then_body);
+            writeBlock(ifStmt->else_body);
+        } else if (auto fn = dynamic_cast<const FunctionDecl*>(stmt)) {
+            writeHeader(StmtTag::Function, stmt);
+            putString(fn->name);
+            put((uint32_t)fn->params.size());
+            for (const Param& param : fn->params) {
+                putString(param.name);
+                putType(param.type);
+            }
+            putType(fn->return_type);
+            put((int32_t)fn->frame_size);
+            writeBlock(fn->body);
+        } else if (auto returnStmt = dynamic_cast<const ReturnStmt*>(stmt)) {
+            writeHeader(StmtTag::Return, stmt);
+            putType(returnStmt->return_type);
+            put((uint8_t)returnStmt->tail_call);
+            writeOptionalExpr(returnStmt->expr.get());
+        } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt)) {
+            writeHeader(StmtTag::Expr, stmt);
+            writeExpr(exprStmt->expr.get());
+        }
+    }
+};
+
+string writeProgramImage(const vector<unique_ptr<Stmt>>& program, uint64_t sourceHash) {
+    ImageWriter writer(program);
+    return writer.write(program, sourceHash);
+}
+
+// Reads never run past the end; the first bad read marks the image corrupt
+// and everything after it decodes as zeros
+class ImageReader {
+public:
+    ImageReader(const char* data, size_t size) : data(data), size(size) {}
+
+    // Header, strings and types; false if this isn't an image we can read
+    bool open() {
+        if (size < sizeof(ImageHeader)) return false;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kImageVersion ||
+            hashBytes(data + sizeof(header), size - sizeof(header)) != header.content_hash) {
+            return false;
+        }
+
+        pos = header.strings_offset;
+        for (uint32_t i = 0; i < header.string_count && ok; ++i) {
+            uint32_t length = get<uint32_t>();
+            if (!fits(length)) break;
+            strings.emplace_back(data + pos, length);
+            pos += length;
+        }
+
+        pos = header.types_offset;
+        for (uint32_t i = 0; i < header.type_count && ok; ++i) {
+            Type type;
+            uint8_t kind = get<uint8_t>();
+            if (kind > (uint8_t)TypeKind::Unknown) ok = false;
+            type.kind = (TypeKind)kind;
+            uint32_t element = get<uint32_t>();
+            uint32_t mapKey = get<uint32_t>();
+            type.scale = get<double>();
+            type.zero_point = get<int32_t>();
+            if (element != kNone) {
+                if (element >= types.size()) ok = false;
+                type.element = ok ? new Type(types[element]) : nullptr;
+            }
+            if (mapKey != kNone) {
+                if (mapKey >= types.size()) ok = false;
+                type.key = ok ? new Type(types[mapKey]) : nullptr;
+            }
+            // The evaluator follows these without checking
+            if ((type.kind == TypeKind::List || type.kind == TypeKind::Map) && !type.element) ok = false;
+            if (type.kind == TypeKind::Map && !type.key) ok = false;
+            types.push_back(type);
+        }
+
+        pos = header.index_offset;
+        if (!fits((uint64_t)header.statement_count * sizeof(uint32_t))) return false;
+        offsets.resize(header.statement_count);
+        memcpy(offsets.data(), data + pos, offsets.size() * sizeof(uint32_t));
+        // Statements are written back to back in order
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            if (offsets[i] >= header.code_size || (i > 0 && offsets[i] <= offsets[i - 1])) return false;
+        }
+        return ok && (uint64_t)header.code_offset + header.code_size <= size;
+    }
+
+    uint64_t sourceHash() const { return header.source_hash; }
+    size_t statementCount() const { return offsets.size(); }
+
+    bool isFunction(size_t index) const {
+        return offsets[index] < header.code_size &&
+               (StmtTag)data[header.code_offset + offsets[index]] == StmtTag::Function;
+    }
+
+    // Null if the statement is corrupt. Functions must be read in order,
+    // since calls name them by position.
+    unique_ptr<Stmt> readStatement(size_t index) {
+        pos = header.code_offset + offsets[index];
+        auto stmt = readStmt();
+        // It must end exactly where the next one starts
+        size_t end = header.code_offset + (index + 1 < offsets.size() ? offsets[index + 1] : header.code_size);
+        if (pos != end) ok = false;
+        return ok ? std::move(stmt) : nullptr;
+    }
+
+    // Points the calls read so far at their functions
+    bool resolveCalls() {
+        for (const auto& call : calls) {
+            if (call.second >= functions.size()) return false;
+            const FunctionDecl* fn = functions[call.second];
+            if (call.first->args.size() != fn->params.size()) return false;
+            call.first->function = fn;
+        }
+        calls.clear();
+        return ok;
+    }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+    ImageHeader header;
+    vector<uint32_t> offsets;
+    // Frame size of the function being read, 0 at the top level
+    int frameSize = 0;
+    vector<string> strings;
+    vector<Type> types;
+    vector<const FunctionDecl*> functions;
+    vector<pair<Expr*, uint32_t>> calls;
+
+    bool fits(size_t bytes) {
+        if (!ok || pos > size || bytes > size - pos) ok = false;
+        return ok;
+    }
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (fits(sizeof(T))) {
+            memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+        }
+        return value;
+    }
+
+    // Local slots index the frame of the function being read. Every global
+    // is named somewhere in the image, so ids can't exceed its size.
+    int getBinding(Storage& storage) {
+        uint8_t kind = get<uint8_t>();
+        int32_t slot = get<int32_t>();
+        storage = (Storage)kind;
+        switch (storage) {
+            case Storage::Unresolved: ok = ok && slot == -1; break;
+            case Storage::Global: ok = ok && slot >= 0 && (size_t)slot < size; break;
+            case Storage::Local: ok = ok && slot >= 0 && slot < frameSize; break;
+            case Storage::Element: ok = ok && (slot == 0 || slot == 1); break;
+            default: ok = false;
+        }
+        return slot;
+    }
+
+    // A count can't exceed the bytes left to hold its items
+    uint32_t getCount() {
+        uint32_t count = get<uint32_t>();
+        if (!fits(count)) return 0;
+        return count;
+    }
+
+    string getString() {
+        uint32_t index = get<uint32_t>();
+        if (index >= strings.size()) {
+            ok = false;
+            return string();
+        }
+        return strings[index];
+    }
+
+    Type getType() {
+        uint32_t index = get<uint32_t>();
+        if (index >= types.size()) {
+            ok = false;
+            return unknownType();
+        }
+        return types[index];
+    }
+
+    unique_ptr<Expr> readExpr() {
+        auto expr = make_unique<Expr>();
+        uint8_t kind = get<uint8_t>();
+        if (kind > (uint8_t)ExprKind::MapLiteral) ok = false;
+        expr->kind = (ExprKind)kind;
+        expr->type = getType();
+        expr->line = get<int32_t>();
+        expr->column = get<int32_t>();
+        expr->int_value = get<int32_t>();
+        expr->double_value = get<double>();
+        if (hasName(expr->kind)) {
+            expr->name = getString();
+        } else {
+            expr->string_value = getString();
+        }
+        expr->op = getString();
+        expr->method_name = getString();
+        uint8_t flags = get<uint8_t>();
+        expr->single_index = (flags & kSingleIndex) != 0;
+        expr->bounds_check = (flags & kBoundsCheck) != 0;
+        expr->slot = getBinding(expr->storage);
+        int32_t function = get<int32_t>();
+        if (function >= 0) calls.push_back({expr.get(), (uint32_t)function});
+        if (!ok) return expr;
+
+        if (flags & kHasLeft) expr->left = readExpr();
+        if (flags & kHasRight) expr->right = readExpr();
+        if (flags & kHasStart) expr->start = readExpr();
+        if (flags & kHasEnd) expr->end = readExpr();
+        uint32_t elements = getCount();
+        for (uint32_t i = 0; i < elements && ok; ++i) {
+            expr->elements.push_back(readExpr());
+        }
+        uint32_t args = getCount();
+        for (uint32_t i = 0; i < args && ok; ++i) {
+            expr->args.push_back(readExpr());
+        }
+
+        // Operands the evaluator takes for granted
+        switch (expr->kind) {
+            case ExprKind::Binary: ok = ok && expr->left && expr->right; break;
+            case ExprKind::Unary:
+            case ExprKind::StringSlice:
+            case ExprKind::MethodCall: ok = ok && expr->left; break;
+            case ExprKind::MapLiteral: ok = ok && expr->elements.size() == expr->args.size(); break;
+            default: break;
+        }
+        return expr;
+    }
+
+    void readBlock(vector<unique_ptr<Stmt>>& body) {
+        uint32_t count = getCount();
+        for (uint32_t i = 0; i < count && ok; ++i) {
+            body.push_back(readStmt());
+        }
+    }
+
+    unique_ptr<Stmt> readStmt() {
+        StmtTag tag = (StmtTag)get<uint8_t>();
+        int line = get<int32_t>();
+        int column = get<int32_t>();
+        unique_ptr<Stmt> stmt;
+
+        switch (tag) {
+            case StmtTag::Let: {
+                auto letStmt = make_unique<LetStmt>();
+                letStmt->name = getString();
+                letStmt->declared_type = getType();
+                letStmt->storage_type = getType();
+                letStmt->slot = getBinding(letStmt->storage);
+                letStmt->constant = get<uint8_t>() != 0;
+                letStmt->expr = readExpr();
+                stmt = std::move(letStmt);
+                break;
+            }
+            case StmtTag::Print: {
+                auto printStmt = make_unique<PrintStmt>();
+                printStmt->expr = readExpr();
+                stmt = std::move(printStmt);
+                break;
+            }
+            case StmtTag::Assign: {
+                auto assignStmt = make_unique<AssignStmt>();
+                assignStmt->name = getString();
+                assignStmt->target_type = getType();
+                assignStmt->slot = getBinding(assignStmt->storage);
+                assignStmt->expr = readExpr();
+                stmt = std::move(assignStmt);
+                break;
+            }
+            case StmtTag::While: {
+                auto whileStmt = make_unique<WhileStmt>();
+                whileStmt->condition = readExpr();
+                readBlock(whileStmt->body);
+                stmt = std::move(whileStmt);
+                break;
+            }
+            case StmtTag::For: {
+                auto forStmt = make_unique<ForStmt>();
+                forStmt->var = getString();
+                forStmt->slot = getBinding(forStmt->storage);
+                forStmt->iterable = readExpr();
+                readBlock(forStmt->body);
+                stmt = std::move(forStmt);
+                break;
+            }
+            case StmtTag::If: {
+                auto ifStmt = make_unique<IfStmt>();
+                ifStmt->condition = readExpr();
+                readBlock(ifStmt->then_body);
+                readBlock(ifStmt->else_body);
+                stmt = std::move(ifStmt);
+                break;
+            }
+            case StmtTag::Function: {
+                auto fn = make_unique<FunctionDecl>();
+                fn->name = getString();
+                uint32_t params = getCount();
+                for (uint32_t i = 0; i < params && ok; ++i) {
+                    Param param;
+                    param.name = getString();
+                    param.type = getType();
+                    fn->params.push_back(param);
+                }
+                fn->return_type = getType();
+                fn->frame_size = get<int32_t>();
+                if (fn->frame_size < (int)fn->params.size()) ok = false;
+                functions.push_back(fn.get());
+                frameSize = fn->frame_size;
+                readBlock(fn->body);
+                frameSize = 0;
+                stmt = std::move(fn);
+                break;
+            }
+            case StmtTag::Return: {
+                auto returnStmt = make_unique<ReturnStmt>();
+                returnStmt->return_type = getType();
+                returnStmt->tail_call = get<uint8_t>() != 0;
+                if (get<uint8_t>()) returnStmt->expr = readExpr();
+                stmt = std::move(returnStmt);
+                break;
+            }
+            case StmtTag::Expr: {
+                auto exprStmt = make_unique<ExprStmt>();
+                exprStmt->expr = readExpr();
+                stmt = std::move(exprStmt);
+                break;
+            }
+            default:
+                ok = false;
+                stmt = make_unique<ExprStmt>();
+                break;
+        }
+        stmt->line = line;
+        stmt->column = column;
+        return stmt;
+    }
+};
+
+ProgramImage::ProgramImage() = default;
+
+ProgramImage::~ProgramImage() {
+    if (data && owned.empty()) munmap(const_cast<char*>(data), size);
+}
+
+bool ProgramImage::open(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const char*>(mapped);
+            size = (size_t)info.st_size;
+        }
+    }
+    close(fd);
+    if (!data) return false;
+    return decode();
+}
+
+bool ProgramImage::load(string image) {
+    if (image.empty()) return false;
+    owned = std::move(image);
+    data = owned.data();
+    size = owned.size();
+    return decode();
+}
+
+bool ProgramImage::decode() {
+    reader.reset(new ImageReader(data, size));
+    if (!reader->open()) return false;
+    // Any statement may call any function, so they are read up front
+    for (size_t i = 0; i < reader->statementCount(); ++i) {
+        if (!reader->isFunction(i)) continue;
+        auto fn = reader->readStatement(i);
+        if (!fn) return false;
+        functions.push_back(std::move(fn));
+    }
+    return reader->resolveCalls();
+}
+
+bool ProgramImage::verify() {
+    for (size_t i = 0; i < statementCount(); ++i) {
+        if (!isFunction(i) && !statement(i)) return false;
+    }
+    return true;
+}
+
+uint64_t ProgramImage::sourceHash() const {
+    return reader->sourceHash();
+}
+
+size_t ProgramImage::statementCount() const {
+    return reader->statementCount();
+}
+
+bool ProgramImage::isFunction(size_t index) const {
+    return reader->isFunction(index);
+}
+
+unique_ptr<Stmt> ProgramImage::statement(size_t index) {
+    auto stmt = reader->readStatement(index);
+    if (!stmt || !reader->resolveCalls()) return nullptr;
+    return stmt;
+}
+
+bool writeImageFile(const string& path, const string& image) {
+    // Written aside and renamed, so a concurrent reader never maps half a file
+    string temporary = path + "." + to_string(getpid()) + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out) return false;
+    bool written = fwrite(image.data(), 1, image.size(), out) == image.size();
+    written = fclose(out) == 0 && written;
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef IR_H
+#define IR_H
+
+#include "../parser/ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary image of a program after every pass has run, holding all the
+// evaluator reads from the AST, so loading one skips lexing, parsing and
+// analysis. Layout:
+//
+//   header | string table | type table | statement offsets | statements
+//
+// Strings and types are stored once and referred to by index. Numbers are
+// in host byte order, so an image runs on machines of the same byte order.
+// Offsets are relative, so an image works wherever it is mapped.
+// Bump kImageVersion whenever the AST, or what a pass writes into it, changes.
+const uint32_t kImageVersion = 5;
+
+struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    // Hash of whatever the image was compiled from, see hashBytes
+    uint64_t source_hash;
+    // hashBytes of everything after the header, so damage is found on open
+    uint64_t content_hash;
+    uint32_t string_count;
+    uint32_t strings_offset;
+    uint32_t type_count;
+    uint32_t types_offset;
+    // One offset into the statement area per top-level statement
+    uint32_t statement_count;
+    uint32_t index_offset;
+    uint32_t code_offset;
+    uint32_t code_size;
+};
+
+// FNV-1a; chain calls by passing the previous result as seed
+uint64_t hashBytes(const char* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+std::string writeProgramImage(const std::vector<std::unique_ptr<Stmt>>& program, uint64_t sourceHash);
+
+// Writes to a temporary file renamed over path, so readers see all or nothing
+bool writeImageFile(const std::string& path, const std::string& image);
+
+class ImageReader;
+
+// An image mapped from disk or held in memory. Functions are decoded when it is opened, since
+// any statement may call them; every other top-level statement is decoded
+// only when asked for, so a run can free each statement once it has
+// executed.
+class ProgramImage {
+public:
+    ProgramImage();
+    ~ProgramImage();
+    ProgramImage(const ProgramImage&) = delete;
+    ProgramImage& operator=(const ProgramImage&) = delete;
+
+    // False if the file is missing, truncated, damaged or from another
+    // image version. Decoding checks the structure but not the types, so
+    // only images written by glc should be run.
+    bool open(const std::string& path);
+    // The same for an image already in memory, which the ProgramImage keeps
+    bool load(std::string image);
+    // Decodes every statement and drops it again; false if any is corrupt,
+    // so a run can be refused before it starts instead of partway through
+    bool verify();
+
+    uint64_t sourceHash() const;
+    size_t statementCount() const;
+    // Functions are owned by the image and are not returned by statement()
+    bool isFunction(size_t index) const;
+    // Null if the statement is corrupt
+    std::unique_ptr<Stmt> statement(size_t index);
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    // Backs data when the image was loaded rather than mapped
+    std::string owned;
+    std::unique_ptr<ImageReader> reader;
+    std::vector<std::unique_ptr<Stmt>> functions;
+
+    bool decode();
+};
+
+#endif
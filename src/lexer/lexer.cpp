@@ -8,22 +8,47 @@ Lexer::Lexer(const string& source):
     line(1),
     column(1){}
 
+Lexer::Lexer(istream& input):
+    input(&input),
+    pos(0),
+    line(1),
+    column(1){}
+
+static const size_t kChunkSize = 64 * 1024;
+
+// Drops what has been read and appends the next chunk until at least
+// needed characters are buffered; false if the input ends first
+bool Lexer::refill(size_t needed){
+    if (!input) {
+        return false;
+    }
+    source.erase(0, pos);
+    pos = 0;
+    while (source.size() < needed && *input) {
+        size_t kept = source.size();
+        source.resize(kept + kChunkSize);
+        input->read(&source[kept], kChunkSize);
+        source.resize(kept + (size_t)input->gcount());
+    }
+    return source.size() >= needed;
+}
+
 char Lexer::peek(){
-    if (pos >= source.size()){
+    if (pos >= source.size() && !refill(1)){
         return '\0';
     }
     return source[pos];
 }
 
 char Lexer::peekNext(){
-    if (pos + 1 >= source.size()){
+    if (pos + 1 >= source.size() && !refill(2)){
         return '\0';
     }
     return source[pos + 1];
 }
 
 char Lexer::advance(){
-    if (pos >= source.size()){
+    if (pos >= source.size() && !refill(1)){
         return '\0';
     }
     char c = source[pos++];
@@ -96,9 +121,33 @@ Token Lexer::nextToken(){
         if (value == "let") {
             return { TokenKind::KeywordLet, value, tokenLine, tokenColumn };
         }
+        if (value == "const") {
+            return { TokenKind::KeywordConst, value, tokenLine, tokenColumn };
+        }
         if (value == "print") {
             return { TokenKind::KeywordPrint, value, tokenLine, tokenColumn };
         }
+        if (value == "while") {
+            return { TokenKind::KeywordWhile, value, tokenLine, tokenColumn };
+        }
+        if (value == "for") {
+            return { TokenKind::KeywordFor, value, tokenLine, tokenColumn };
+        }
+        if (value == "in") {
+            return { TokenKind::KeywordIn, value, tokenLine, tokenColumn };
+        }
+        if (value == "if") {
+            return { TokenKind::KeywordIf, value, tokenLine, tokenColumn };
+        }
+        if (value == "else") {
+            return { TokenKind::KeywordElse, value, tokenLine, tokenColumn };
+        }
+        if (value == "fn") {
+            return { TokenKind::KeywordFn, value, tokenLine, tokenColumn };
+        }
+        if (value == "return") {
+            return { TokenKind::KeywordReturn, value, tokenLine, tokenColumn };
+        }
         if (value == "i8") {
             return { TokenKind::KeywordI8, value, tokenLine, tokenColumn };
         }
@@ -117,12 +166,24 @@ Token Lexer::nextToken(){
         if (value == "f64") {
             return { TokenKind::KeywordF64, value, tokenLine, tokenColumn };
         }
+        if (value == "f16") {
+            return { TokenKind::KeywordF16, value, tokenLine, tokenColumn };
+        }
+        if (value == "bf16") {
+            return { TokenKind::KeywordBF16, value, tokenLine, tokenColumn };
+        }
+        if (value == "q8") {
+            return { TokenKind::KeywordQ8, value, tokenLine, tokenColumn };
+        }
         if (value == "string") {
             return { TokenKind::KeywordString, value, tokenLine, tokenColumn };
         }
         if (value == "list") {
             return { TokenKind::KeywordList, value, tokenLine, tokenColumn };
         }
+        if (value == "future") {
+            return { TokenKind::KeywordFuture, value, tokenLine, tokenColumn };
+        }
 
         return { TokenKind::Identifier, value, tokenLine, tokenColumn };
     }
@@ -130,7 +191,12 @@ Token Lexer::nextToken(){
     advance();
     switch (c) {
     case '+': return { TokenKind::Plus, "+", tokenLine, tokenColumn };
-    case '-': return { TokenKind::Minus, "-", tokenLine, tokenColumn };
+    case '-':
+        if (peek() == '>') {
+            advance();
+            return { TokenKind::Arrow, "->", tokenLine, tokenColumn };
+        }
+        return { TokenKind::Minus, "-", tokenLine, tokenColumn };
     case '*': return { TokenKind::Star, "*", tokenLine, tokenColumn };
     case '/':
         if (peek() == '/') {
@@ -182,6 +248,8 @@ Token Lexer::nextToken(){
     case ')': return { TokenKind::RParen, ")", tokenLine, tokenColumn };
     case '[': return { TokenKind::LBracket, "[", tokenLine, tokenColumn };
     case ']': return { TokenKind::RBracket, "]", tokenLine, tokenColumn };
+    case '{': return { TokenKind::LBrace, "{", tokenLine, tokenColumn };
+    case '}': return { TokenKind::RBrace, "}", tokenLine, tokenColumn };
     case '.': return { TokenKind::Dot, ".", tokenLine, tokenColumn };
     default:
         return { TokenKind::Unknown, std::string(1, c), tokenLine, tokenColumn };
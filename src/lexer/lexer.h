@@ -1,16 +1,21 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <istream>
 #include <string>
 #include "token.h"
 
 class Lexer {
 public:
     Lexer(const std::string& source);
+    // Reads the stream a chunk at a time instead of holding all of it
+    Lexer(std::istream& input);
     Token nextToken();
 
 private:
+    // The whole source, or the unread part of the current chunk when streaming
     std::string source;
+    std::istream* input = nullptr;
     size_t pos;
     int line;
     int column;
@@ -18,6 +23,7 @@ private:
     char peek();
     char peekNext();
     char advance();
+    bool refill(size_t needed);
     void skipWhitespace();
 };
 
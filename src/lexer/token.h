@@ -8,15 +8,27 @@ enum class TokenKind {
     Number,
     String,
     KeywordLet,
+    KeywordConst,
     KeywordPrint,
+    KeywordWhile,
+    KeywordFor,
+    KeywordIn,
+    KeywordIf,
+    KeywordElse,
+    KeywordFn,
+    KeywordReturn,
     KeywordI8,
     KeywordI16,
     KeywordI32,
     KeywordI64,
     KeywordF32,
     KeywordF64,
+    KeywordF16,
+    KeywordBF16,
+    KeywordQ8,
     KeywordString,
     KeywordList,
+    KeywordFuture,
     Plus,
     Minus,
     Star,
@@ -35,6 +47,7 @@ enum class TokenKind {
     Bang,
     AmpersandAmpersand,
     PipePipe,
+    Arrow,
     Colon,
     Semicolon,
     Comma,
@@ -42,6 +55,8 @@ enum class TokenKind {
     RParen,
     LBracket,
     RBracket,
+    LBrace,
+    RBrace,
     Dot,
     EndOfFile,
     Unknown
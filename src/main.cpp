@@ -1,53 +1,883 @@
 #include "lexer/lexer.h"
 #include "parser/parser.h"
 #include "evaluvator/evaluator.h"
+#include "evaluvator/profiler.h"
+#include "evaluvator/batch.h"
 #include "semantics/symbol_table.h"
 #include "semantics/semantic.h"
+#include "semantics/frame_layout.h"
+#include "semantics/const_eval.h"
+#include "optimizer/inliner.h"
+#include "optimizer/loop_optimizer.h"
+#include "driver/compile.h"
+#include "runtime/thread_pool.h"
+#include "runtime/device.h"
+#include "runtime/output.h"
+#include "runtime/memory.h"
+#include "ir/ir.h"
+#include "ir/cache.h"
+#include "util/phase_timer.h"
+#include "util/diagnostics.h"
+#include "daemon/protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <poll.h>
 #include <sstream>
 #include <string>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
 
 using namespace std;
 
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <source_file>\n";
-        return 1;
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--threads N] [--pool-stats] [--device cpu] [--device-stats]\n"
+         << "       [--narrowing-report] [--no-inline] [--no-loop-opt] [--opt-report] [--no-cache]\n"
+         << "       [--stream] [--profile] [--time-phases[=json]]\n"
+         << "       <source_file.g | program.gbc>\n"
+         << "       " << program << " --batch RECORDS [--threads N] [--no-inline] [--no-loop-opt] <source_file.g>\n"
+         << "       " << program << " --compile [--no-inline] [--no-loop-opt] <source_file.g> [-o program.gbc]\n"
+         << "       " << program << " --check | --compile [--threads N] [--no-inline] [--no-loop-opt]\n"
+         << "       <source_file.g | directory>...\n"
+         << "       " << program << " --daemon [--socket PATH]\n";
+}
+
+static bool hasExtension(const string& filename, const string& extension) {
+    return filename.length() > extension.length() &&
+           filename.compare(filename.length() - extension.length(), extension.length(), extension) == 0;
+}
+
+// Compiles and runs one top-level statement at a time and frees it after it
+// runs, so memory doesn't grow with the length of the input and output
+// starts right away. Each pass keeps its state from one statement to the
+// next. Functions must be declared before they are called. Range analysis
+// is skipped, since narrowing a binding needs every later assignment to it.
+static void runStreaming(istream& input, const CompileOptions& options, Profiler* profiler) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+    SymbolTable semanticSymbols;
+    SemanticAnalyzer semanticAnalyzer(semanticSymbols);
+    ConstEvaluator constEvaluator;
+    Inliner inliner;
+    LoopOptimizer loopOptimizer;
+    FrameLayout frameLayout;
+    Evaluator evaluator;
+    evaluator.setProfiler(profiler);
+    // Calls point into function declarations, so those are kept
+    vector<unique_ptr<Stmt>> functions;
+
+    while (unique_ptr<Stmt> stmt = parser.parseNext()) {
+        // The loop optimizer may put lets in front of the statement
+        vector<unique_ptr<Stmt>> unit;
+        unit.push_back(std::move(stmt));
+        semanticAnalyzer.analyze(unit);
+        constEvaluator.evaluate(unit);
+        if (options.inlining) {
+            inliner.inlineCalls(unit);
+        }
+        if (options.loopOpt) {
+            loopOptimizer.optimize(unit);
+        }
+        frameLayout.layout(unit);
+        evaluator.evalProgram(unit);
+
+        for (auto& done : unit) {
+            if (dynamic_cast<const FunctionDecl*>(done.get())) {
+                functions.push_back(std::move(done));
+            }
+        }
     }
 
-    string filename = argv[1];
-    if (filename.length() < 3 || filename.substr(filename.length() - 2) != ".g") {
-        cerr << "Error: Input file must have a .g extension.\n";
-        return 1;
+    if (options.optReport) {
+        inliner.printReport(cerr);
+        loopOptimizer.printReport(cerr);
     }
-    
-    ifstream file(argv[1]);
+}
+
+// Every .g file under each directory, in name order, and the other inputs as given
+static vector<string> expandInputs(const vector<string>& inputs) {
+    vector<string> files;
+    for (const string& input : inputs) {
+        error_code error;
+        if (!filesystem::is_directory(input, error)) {
+            files.push_back(input);
+            continue;
+        }
+        vector<string> found;
+        for (const auto& entry : filesystem::recursive_directory_iterator(input, error)) {
+            if (entry.is_regular_file() && hasExtension(entry.path().string(), ".g")) {
+                found.push_back(entry.path().string());
+            }
+        }
+        sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+static void checkFile(const string& filename, const CompileOptions& options, bool writeImage,
+                      Diagnostics& diagnostics) {
+    if (!hasExtension(filename, ".g")) {
+        diagnostics.error("Input file must have a .g extension");
+        return;
+    }
+    ifstream file(filename);
     if (!file) {
-        cerr << "Error: Could not open file " << argv[1] << "\n";
-        return 1;
+        diagnostics.error("Could not open file");
+        return;
     }
-    
     stringstream buffer;
     buffer << file.rdbuf();
     string source = buffer.str();
-    
-    Lexer lexer(source);
-    Parser parser(lexer);
-    
-    vector<unique_ptr<Stmt>> program = parser.parseProgram();
-    
-    // Semantic Analysis
-    SymbolTable semanticSymbols;
-    SemanticAnalyzer semanticAnalyzer(semanticSymbols);
-    semanticAnalyzer.analyze(program);
-    
+
+    // Each file's names are freed with it
+    InternTable names;
+    InternScope scope(names);
+    try {
+        vector<unique_ptr<Stmt>> program = compile(source, options);
+        if (writeImage) {
+            string imageFile = filename + "bc";
+            if (!writeImageFile(imageFile, writeProgramImage(program, hashBytes(source.data(), source.size())))) {
+                diagnostics.error("Could not write " + imageFile);
+            }
+        }
+    } catch (const CompileError& error) {
+        diagnostics.error(error.what());
+    } catch (const RuntimeError& error) {
+        diagnostics.error(error.what());
+    }
+}
+
+// Compiles many files at once, one per thread pool task, and reports their
+// diagnostics in input order. With writeImages each file.g gets a file.gbc.
+static int runBatch(const vector<string>& files, const CompileOptions& options, bool writeImages) {
+    vector<Diagnostics> results;
+    results.reserve(files.size());
+    for (const string& file : files) {
+        results.emplace_back(file);
+    }
+    defaultThreadPool().parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            checkFile(files[i], options, writeImages, results[i]);
+        }
+    });
+
+    size_t failed = 0;
+    for (const Diagnostics& diagnostics : results) {
+        diagnostics.print(cerr);
+        if (diagnostics.hasErrors()) failed++;
+    }
+    if (failed > 0) {
+        cerr << failed << " of " << files.size() << " files failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Runs the program once per line of recordsFile, with the line's numbers
+// bound to `input`, and reports the throughput on stderr
+static int runRecords(const vector<unique_ptr<Stmt>>& program, const string& recordsFile, PhaseTimer* phases) {
+    if (phases) phases->start("read-records");
+    ifstream file(recordsFile);
+    if (!file) {
+        cerr << "Error: Could not open file " << recordsFile << "\n";
+        return 1;
+    }
+    RecordBatch records;
+    string error;
+    if (!readRecords(file, records, error)) {
+        cerr << "Error: " << recordsFile << " " << error << "\n";
+        return 1;
+    }
+
+    if (phases) phases->start("execute");
+    BatchRunner runner(program, kInputGlobalId);
+    auto started = chrono::steady_clock::now();
+    runner.run(records, standardOutput());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    if (phases) phases->stop();
+
+    ostringstream report;
+    report << "Batch: " << records.size() << " records in " << seconds << " s, "
+           << (seconds > 0 ? (long long)(records.size() / seconds) : 0) << " records/s ("
+           << (runner.vectorized() ? "vectorized" : "record by record") << ", " << defaultThreadPool().size()
+           << " threads)\n";
+    cerr << report.str();
+    return 0;
+}
+
+static int runCommand(int argc, char** argv);
+
+// Programs compiled for daemon requests, under the key ProgramCache uses
+struct DaemonProgram {
+    // Holds the names in image and statements, so it is freed after them
+    InternTable names;
+    ProgramImage image;
+    // The top-level statements other than functions, decoded
+    vector<unique_ptr<Stmt>> statements;
+};
+
+// The most programs the daemon keeps; the oldest goes first
+const size_t kDaemonCachedPrograms = 256;
+
+class DaemonCache {
+public:
+    shared_ptr<const DaemonProgram> find(uint64_t key) {
+        lock_guard<mutex> lock(guard);
+        auto found = programs.find(key);
+        return found != programs.end() ? found->second : nullptr;
+    }
+
+    void add(uint64_t key, shared_ptr<const DaemonProgram> program) {
+        lock_guard<mutex> lock(guard);
+        if (!programs.emplace(key, std::move(program)).second) return;
+        order.push_back(key);
+        if (order.size() > kDaemonCachedPrograms) {
+            programs.erase(order.front());
+            order.pop_front();
+        }
+    }
+
+private:
+    mutex guard;
+    unordered_map<uint64_t, shared_ptr<const DaemonProgram>> programs;
+    deque<uint64_t> order;
+};
+
+// Never destroyed, so a request process that exits doesn't free it first
+static DaemonCache& daemonCache = *new DaemonCache;
+
+// A request the daemon can serve from its cache: running one .g file with
+// options that only change compilation or the thread count. Anything else
+// runs as a fresh glc would.
+struct CachedRequest {
+    string filename;
+    CompileOptions options;
+    long threads = 0;
+};
+
+static bool parseCachedRequest(const vector<string>& args, CachedRequest& request) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        if (arg == "--no-inline") {
+            request.options.inlining = false;
+        } else if (arg == "--no-loop-opt") {
+            request.options.loopOpt = false;
+        } else if (arg == "--threads" && i + 1 < args.size()) {
+            request.threads = strtol(args[++i].c_str(), nullptr, 10);
+            if (request.threads <= 0) return false;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            request.threads = strtol(arg.c_str() + 10, nullptr, 10);
+            if (request.threads <= 0) return false;
+        } else if (arg.rfind("--", 0) == 0 || !request.filename.empty()) {
+            return false;
+        } else {
+            request.filename = arg;
+        }
+    }
+    return hasExtension(request.filename, ".g");
+}
+
+// Runs in the forked request process, with the client's descriptors as
+// stdin, stdout and stderr. A compiled program's image goes to imageFd
+// before it runs, for the daemon to keep.
+static int serveRequest(const DaemonRequest& request, const CachedRequest* cachedRequest, const string& source,
+                        const DaemonProgram* cached, int imageFd) {
+    if (chdir(request.directory.c_str()) != 0) {
+        cerr << "Error: Could not change to " << request.directory << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    if (!cachedRequest) {
+        for (const string& arg : request.args) {
+            if (arg == "--daemon") {
+                cerr << "Error: --daemon can't be run through the daemon\n";
+                return 1;
+            }
+        }
+        vector<char*> argv = {const_cast<char*>("glc")};
+        for (const string& arg : request.args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        return runCommand((int)argv.size() - 1, argv.data());
+    }
+
+    if (cachedRequest->threads > 0) {
+        setConfiguredThreadCount((size_t)cachedRequest->threads);
+    }
+    InternTable names;
+    InternScope scope(names);
+    Evaluator evaluator;
+    if (cached) {
+        evaluator.evalProgram(cached->statements);
+    } else {
+        vector<unique_ptr<Stmt>> program;
+        program = compile(source, cachedRequest->options);
+        string image = writeProgramImage(program, 0);
+        for (size_t written = 0; written < image.size();) {
+            ssize_t count = write(imageFd, image.data() + written, image.size() - written);
+            if (count <= 0) break;
+            written += (size_t)count;
+        }
+        close(imageFd);
+        evaluator.evalProgram(program);
+    }
+    standardOutput().write("Program executed successfully\n");
+    return 0;
+}
+
+// Decodes an image a request process sent back; null if it is incomplete
+static shared_ptr<const DaemonProgram> decodeProgram(string image) {
+    auto program = make_shared<DaemonProgram>();
+    InternScope scope(program->names);
+    if (!program->image.load(std::move(image))) return nullptr;
+    for (size_t i = 0; i < program->image.statementCount(); ++i) {
+        if (program->image.isFunction(i)) continue;
+        program->statements.push_back(program->image.statement(i));
+        if (!program->statements.back()) return nullptr;
+    }
+    return program;
+}
+
+// Serves one connection on a thread of its own. The program runs in a
+// forked process, so a runtime error exiting it or a crash leaves the
+// daemon up, and the compiled programs are shared with it copy-on-write.
+// Other connections' threads may be decoding when it forks, so the child
+// must not need a lock they hold: each decoded program interns its names
+// into its own table, and the process-wide one is held across fork.
+static void serveConnection(int socket) {
+    DaemonRequest request;
+    int fds[3];
+    if (!receiveRequest(socket, request, fds)) {
+        close(socket);
+        return;
+    }
+
+    CachedRequest cachedRequest;
+    bool cacheable = parseCachedRequest(request.args, cachedRequest);
+    string source;
+    uint64_t key = 0;
+    shared_ptr<const DaemonProgram> cached;
+    if (cacheable) {
+        string path = cachedRequest.filename;
+        if (path[0] != '/') path = request.directory + "/" + path;
+        ifstream file(path);
+        stringstream buffer;
+        buffer << file.rdbuf();
+        source = buffer.str();
+        // Unreadable files are reported by a fresh glc
+        cacheable = bool(file);
+        string passes = string(cachedRequest.options.inlining ? "inline " : "") +
+                        (cachedRequest.options.loopOpt ? "loop-opt" : "");
+        key = hashBytes(passes.data(), passes.size(), hashBytes(source.data(), source.size()));
+        cached = cacheable ? daemonCache.find(key) : nullptr;
+    }
+    int imagePipe[2] = {-1, -1};
+    if (cacheable && !cached && pipe2(imagePipe, O_CLOEXEC) != 0) {
+        imagePipe[0] = imagePipe[1] = -1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        for (int i = 0; i < 3; ++i) {
+            dup2(fds[i], i);
+        }
+        // Nothing else the daemon has open, least of all other clients'
+        // pipes, may outlive the daemon's copy
+        int firstClosed = 3;
+        if (imagePipe[1] >= 0) {
+            dup2(imagePipe[1], 3);
+            imagePipe[1] = 3;
+            firstClosed = 4;
+        }
+        if (syscall(SYS_close_range, firstClosed, ~0u, 0) != 0) {
+            for (int fd = firstClosed; fd < 1024; ++fd) close(fd);
+        }
+        signal(SIGPIPE, SIG_DFL);
+        int exitCode = 1;
+        try {
+            exitCode = serveRequest(request, cacheable ? &cachedRequest : nullptr, source, cached.get(),
+                                    imagePipe[1]);
+        } catch (const CompileError& error) {
+            cerr << error.what() << "\n";
+        } catch (const RuntimeError& error) {
+            cerr << error.what() << "\n";
+        }
+        exit(exitCode);
+    }
+    for (int fd : fds) close(fd);
+    if (imagePipe[1] >= 0) close(imagePipe[1]);
+    int status = 1;
+    if (child < 0) {
+        if (imagePipe[0] >= 0) close(imagePipe[0]);
+        sendStatus(socket, status);
+        close(socket);
+        return;
+    }
+
+    // Collect the image and wait for the program, killing it if the client
+    // hangs up first
+    string image;
+    int exitFd = (int)syscall(SYS_pidfd_open, child, 0);
+    bool watching = true;
+    while (imagePipe[0] >= 0 || exitFd >= 0) {
+        pollfd polls[3];
+        nfds_t count = 0;
+        if (imagePipe[0] >= 0) polls[count++] = {imagePipe[0], POLLIN, 0};
+        if (exitFd >= 0) polls[count++] = {exitFd, POLLIN, 0};
+        if (watching) polls[count++] = {socket, POLLIN, 0};
+        if (poll(polls, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (nfds_t i = 0; i < count; ++i) {
+            if (!polls[i].revents) continue;
+            if (polls[i].fd == imagePipe[0]) {
+                char chunk[64 * 1024];
+                ssize_t got = read(imagePipe[0], chunk, sizeof(chunk));
+                if (got > 0) {
+                    image.append(chunk, (size_t)got);
+                } else if (got == 0 || errno != EINTR) {
+                    close(imagePipe[0]);
+                    imagePipe[0] = -1;
+                }
+            } else if (polls[i].fd == exitFd) {
+                close(exitFd);
+                exitFd = -1;
+            } else {
+                kill(child, SIGKILL);
+                watching = false;
+            }
+        }
+    }
+    if (imagePipe[0] >= 0) close(imagePipe[0]);
+    if (exitFd >= 0) close(exitFd);
+
+    int waitStatus;
+    while (waitpid(child, &waitStatus, 0) < 0 && errno == EINTR) {
+    }
+    status = WIFEXITED(waitStatus) ? WEXITSTATUS(waitStatus) : 128 + WTERMSIG(waitStatus);
+    if (!image.empty()) {
+        if (auto program = decodeProgram(std::move(image))) {
+            daemonCache.add(key, std::move(program));
+        }
+    }
+    sendStatus(socket, status);
+    close(socket);
+}
+
+static char daemonSocketPath[256];
+
+static void stopDaemon(int) {
+    unlink(daemonSocketPath);
+    _exit(0);
+}
+
+// Keeps compiled programs in memory between runs and serves glc_client
+// requests until it gets SIGINT or SIGTERM
+static int runDaemon(const string& socketPath) {
+    string error;
+    int listener = listenOnSocket(socketPath, error);
+    if (listener < 0) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    snprintf(daemonSocketPath, sizeof(daemonSocketPath), "%s", socketPath.c_str());
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+    signal(SIGPIPE, SIG_IGN);
+    // Descriptors the clients pass in must not land on 0, 1 or 2
+    for (int fd = 0; fd < 3; ++fd) {
+        if (fcntl(fd, F_GETFD) < 0) open("/dev/null", O_RDWR);
+    }
+    cerr << "glc daemon listening on " << socketPath << "\n";
+
+    while (true) {
+        int socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            cerr << "Error: could not accept a connection: " << strerror(errno) << "\n";
+            unlink(socketPath.c_str());
+            return 1;
+        }
+        ucred peer;
+        socklen_t length = sizeof(peer);
+        if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != getuid()) {
+            close(socket);
+            continue;
+        }
+        thread(serveConnection, socket).detach();
+    }
+}
+
+static int run(int argc, char** argv) {
+    vector<string> inputs;
+    bool poolStats = getenv("EXOTIC_POOL_STATS") != nullptr;
+    string deviceName;
+    bool deviceStats = false;
+    bool narrowingReport = false;
+    bool inlining = true;
+    bool loopOpt = true;
+    bool optReport = false;
+    bool useCache = true;
+    bool compileOnly = false;
+    bool checkOnly = false;
+    bool streaming = false;
+    bool profiling = false;
+    bool daemon = false;
+    string socketPath;
+    // "text" or "json" when timing phases
+    string phaseFormat;
+    string outputFile;
+    string recordsFile;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--threads" || arg.rfind("--threads=", 0) == 0) {
+            string value;
+            if (arg == "--threads") {
+                if (i + 1 >= argc) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                value = argv[++i];
+            } else {
+                value = arg.substr(10);
+            }
+            long threads = strtol(value.c_str(), nullptr, 10);
+            if (threads <= 0) {
+                cerr << "Error: --threads expects a positive number\n";
+                return 1;
+            }
+            setConfiguredThreadCount((size_t)threads);
+        } else if (arg == "--pool-stats") {
+            poolStats = true;
+        } else if (arg == "--device" || arg.rfind("--device=", 0) == 0) {
+            if (arg == "--device") {
+                if (i + 1 >= argc) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                deviceName = argv[++i];
+            } else {
+                deviceName = arg.substr(9);
+            }
+            if (deviceName != "cpu") {
+                cerr << "Error: unknown device '" << deviceName << "' (available: cpu)\n";
+                return 1;
+            }
+        } else if (arg == "--device-stats") {
+            deviceStats = true;
+        } else if (arg == "--narrowing-report") {
+            narrowingReport = true;
+        } else if (arg == "--no-inline") {
+            inlining = false;
+        } else if (arg == "--no-loop-opt") {
+            loopOpt = false;
+        } else if (arg == "--opt-report") {
+            optReport = true;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--stream") {
+            streaming = true;
+        } else if (arg == "--profile") {
+            profiling = true;
+        } else if (arg == "--time-phases" || arg == "--time-phases=text") {
+            phaseFormat = "text";
+        } else if (arg == "--time-phases=json") {
+            phaseFormat = "json";
+        } else if (arg == "--compile") {
+            compileOnly = true;
+        } else if (arg == "-o") {
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            outputFile = argv[++i];
+        } else if (arg == "--check") {
+            checkOnly = true;
+        } else if (arg == "--batch") {
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            recordsFile = argv[++i];
+        } else if (arg == "--daemon") {
+            daemon = true;
+        } else if (arg == "--socket") {
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            socketPath = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (daemon) {
+        if (argc != (socketPath.empty() ? 2 : 4)) {
+            cerr << "Error: --daemon only takes --socket; requests bring their own options\n";
+            return 1;
+        }
+        return runDaemon(socketPath.empty() ? defaultSocketPath() : socketPath);
+    }
+    if (!socketPath.empty()) {
+        cerr << "Error: --socket is only used with --daemon\n";
+        return 1;
+    }
+
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    error_code error;
+    if (checkOnly || inputs.size() > 1 || filesystem::is_directory(inputs[0], error)) {
+        if (!checkOnly && !compileOnly) {
+            cerr << "Error: several inputs or a directory need --check or --compile\n";
+            return 1;
+        }
+        if (checkOnly && compileOnly) {
+            cerr << "Error: --check and --compile can't be combined\n";
+            return 1;
+        }
+        if (!outputFile.empty() || streaming || profiling || !phaseFormat.empty() || optReport ||
+            narrowingReport || !deviceName.empty() || !recordsFile.empty()) {
+            cerr << "Error: checking or compiling several files only takes --threads, --no-inline and "
+                 << "--no-loop-opt\n";
+            return 1;
+        }
+        CompileOptions options;
+        options.inlining = inlining;
+        options.loopOpt = loopOpt;
+        return runBatch(expandInputs(inputs), options, compileOnly);
+    }
+    string filename = inputs[0];
+
+    bool isImage = hasExtension(filename, ".gbc");
+    if (!isImage && !hasExtension(filename, ".g")) {
+        cerr << "Error: Input file must have a .g or .gbc extension.\n";
+        return 1;
+    }
+    if (!compileOnly && !outputFile.empty()) {
+        cerr << "Error: -o is only used with --compile\n";
+        return 1;
+    }
+    if (compileOnly && isImage) {
+        cerr << "Error: " << filename << " is already compiled\n";
+        return 1;
+    }
+    if (streaming && (isImage || compileOnly || !deviceName.empty() || narrowingReport)) {
+        cerr << "Error: --stream runs .g sources directly and can't be combined with --compile, "
+             << "--device or --narrowing-report\n";
+        return 1;
+    }
+
+    if (profiling && (compileOnly || !deviceName.empty())) {
+        cerr << "Error: --profile can't be combined with --compile or --device\n";
+        return 1;
+    }
+
+    if (!recordsFile.empty() && (isImage || compileOnly || streaming || profiling || !deviceName.empty())) {
+        cerr << "Error: --batch runs a .g source and can't be combined with --compile, --stream, "
+             << "--profile or --device\n";
+        return 1;
+    }
+
+    if (!phaseFormat.empty() && streaming) {
+        cerr << "Error: --time-phases can't be combined with --stream, whose phases interleave\n";
+        return 1;
+    }
+
+    // Names the compiled or loaded program uses, freed after it
+    InternTable names;
+    InternScope scope(names);
+
+    unique_ptr<PhaseTimer> phases;
+    if (!phaseFormat.empty()) {
+        phases = make_unique<PhaseTimer>();
+    }
+    auto reportPhases = [&] {
+        if (!phases) return;
+        phases->stop();
+        if (phaseFormat == "json") {
+            phases->printJson(cerr);
+        } else {
+            phases->printText(cerr);
+        }
+    };
+
+    // Wall time, counts and allocations per statement, reported at exit
+    unique_ptr<Profiler> profiler;
+    auto startProfiling = [&] {
+        if (!profiling) return;
+        countAllocations(true);
+        profiler = make_unique<Profiler>();
+    };
+    auto reportProfile = [&]() -> bool {
+        if (!profiler) return true;
+        string foldedFile = filename + ".folded";
+        profiler->printReport(cerr);
+        ofstream folded(foldedFile);
+        profiler->writeFolded(folded);
+        if (!folded) {
+            cerr << "Error: Could not write " << foldedFile << "\n";
+            return false;
+        }
+        cerr << "Call stacks written to " << foldedFile << "\n";
+        return true;
+    };
+
+    vector<unique_ptr<Stmt>> program;
+    ProgramImage image;
+    bool fromImage = false;
+    if (isImage) {
+        if (phases) phases->start("load");
+        if (!image.open(filename) || !image.verify()) {
+            cerr << "Error: " << filename << " is not a program image this glc can run\n";
+            return 1;
+        }
+        fromImage = true;
+    } else {
+        if (phases) phases->start("read");
+        ifstream file(filename);
+        if (!file) {
+            cerr << "Error: Could not open file " << filename << "\n";
+            return 1;
+        }
+
+        CompileOptions options;
+        options.inlining = inlining;
+        options.loopOpt = loopOpt;
+        options.optReport = optReport;
+        options.narrowingReport = narrowingReport;
+        options.inputBinding = !recordsFile.empty();
+        options.phases = phases.get();
+
+        if (streaming) {
+            startProfiling();
+            runStreaming(file, options, profiler.get());
+            standardOutput().write("Program executed successfully\n");
+            return reportProfile() ? 0 : 1;
+        }
+
+        stringstream buffer;
+        buffer << file.rdbuf();
+        string source = buffer.str();
+        uint64_t sourceHash = hashBytes(source.data(), source.size());
+
+        if (compileOnly) {
+            program = compile(source, options);
+            if (outputFile.empty()) {
+                outputFile = filename + "bc";
+            }
+            if (phases) phases->start("write-image");
+            if (!writeImageFile(outputFile, writeProgramImage(program, sourceHash))) {
+                cerr << "Error: Could not write " << outputFile << "\n";
+                return 1;
+            }
+            reportPhases();
+            return 0;
+        }
+
+        // Reports come from the passes themselves, so they need a real compile
+        bool cached = useCache && !optReport && !narrowingReport && !phases;
+        string passes = string(inlining ? "inline " : "") + (loopOpt ? "loop-opt" : "") +
+                        (options.inputBinding ? " input" : "");
+        ProgramCache cache(hashBytes(passes.data(), passes.size(), sourceHash));
+        fromImage = cached && cache.load(image);
+        if (!fromImage) {
+            program = compile(source, options);
+            if (cached) {
+                cache.store(program);
+            }
+        }
+    }
+
     // Evaluation
-    SymbolTable evaluatorSymbols;
-    Evaluator evaluator(evaluatorSymbols);
-    evaluator.evalProgram(program);
+    if (phases && recordsFile.empty()) phases->start("execute");
+    startProfiling();
+    Evaluator evaluator;
+    evaluator.setProfiler(profiler.get());
+    if (fromImage && deviceName.empty() && recordsFile.empty()) {
+        // Each statement is decoded when it is reached and freed after it runs
+        for (size_t i = 0; i < image.statementCount(); ++i) {
+            if (image.isFunction(i)) continue;
+            unique_ptr<Stmt> stmt = image.statement(i);
+            if (!stmt) {
+                cerr << "Error: statement " << i + 1 << " of the program image is corrupt\n";
+                return 1;
+            }
+            evaluator.execute(stmt.get());
+        }
+    } else {
+        if (fromImage) {
+            for (size_t i = 0; i < image.statementCount(); ++i) {
+                if (image.isFunction(i)) continue;
+                program.push_back(image.statement(i));
+                if (!program.back()) {
+                    cerr << "Error: statement " << i + 1 << " of the program image is corrupt\n";
+                    return 1;
+                }
+            }
+        }
+        if (!recordsFile.empty()) {
+            int status = runRecords(program, recordsFile, phases.get());
+            if (status != 0) return status;
+        } else if (!deviceName.empty()) {
+            CpuDevice device(defaultThreadPool());
+            evaluator.evalProgramAsync(program, device);
+            if (deviceStats) {
+                device.printStats(cerr);
+            }
+        } else {
+            evaluator.evalProgram(program);
+        }
+    }
     
-    cout << "Program executed successfully\n";
+    if (phases) phases->stop();
+    standardOutput().write("Program executed successfully\n");
+    reportPhases();
+    if (!reportProfile()) {
+        return 1;
+    }
+
+    if (poolStats && defaultThreadPoolStarted()) {
+        defaultThreadPool().printStats(cerr);
+    }
     
     return 0;
-}
\ No newline at end of file
+}
+
+static int runCommand(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const CompileError& error) {
+        cerr << error.what() << "\n";
+        return 1;
+    } catch (const RuntimeError& error) {
+        cerr << error.what() << "\n";
+        return 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    return runCommand(argc, argv);
+}
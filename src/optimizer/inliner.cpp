@@ -0,0 +1,226 @@
+#include "inliner.h"
+#include "../semantics/semantic.h"
+#include <unordered_map>
+
+using namespace std;
+
+// Larger bodies are cheaper to call than to copy into every call site
+static const size_t kMaxInlineNodes = 24;
+
+static bool isElementBodyMethod(const Expr* expr) {
+    return expr->kind == ExprKind::MethodCall &&
+           (expr->method_name == "map" || expr->method_name == "filter" || expr->method_name == "reduce");
+}
+
+static bool isElementName(const string& name) {
+    return name == "it" || name == "acc";
+}
+
+// Visits the nodes of expr, telling the callback whether each one sits in a
+// map/filter/reduce body
+template <typename Visit>
+static void walk(const Expr* expr, bool inElementBody, Visit&& visit) {
+    if (!expr) return;
+    visit(expr, inElementBody);
+    walk(expr->left.get(), inElementBody, visit);
+    walk(expr->right.get(), inElementBody, visit);
+    walk(expr->start.get(), inElementBody, visit);
+    walk(expr->end.get(), inElementBody, visit);
+    for (const auto& element : expr->elements) {
+        walk(element.get(), inElementBody, visit);
+    }
+    for (size_t i = 0; i < expr->args.size(); ++i) {
+        walk(expr->args[i].get(), inElementBody || (i == 0 && isElementBodyMethod(expr)), visit);
+    }
+}
+
+// Copy of body with parameter references replaced by copies of the arguments
+static unique_ptr<Expr> substitute(const Expr* body, const unordered_map<Interned, const Expr*>& args,
+                                   bool inElementBody) {
+    if (!body) return nullptr;
+    if (body->kind == ExprKind::Identifier && !(inElementBody && isElementName(body->name))) {
+        auto found = args.find(body->name);
+        if (found != args.end()) {
+            return cloneExpr(found->second);
+        }
+    }
+
+    auto copy = make_unique<Expr>(body->line, body->column);
+    copy->kind = body->kind;
+    copy->type = body->type;
+    copy->int_value = body->int_value;
+    copy->double_value = body->double_value;
+    copy->string_value = body->string_value;
+    copy->name = body->name;
+    copy->op = body->op;
+    copy->left = substitute(body->left.get(), args, inElementBody);
+    copy->right = substitute(body->right.get(), args, inElementBody);
+    copy->start = substitute(body->start.get(), args, inElementBody);
+    copy->end = substitute(body->end.get(), args, inElementBody);
+    copy->single_index = body->single_index;
+    copy->bounds_check = body->bounds_check;
+    copy->function = body->function;
+    copy->method_name = body->method_name;
+    for (const auto& element : body->elements) {
+        copy->elements.push_back(substitute(element.get(), args, inElementBody));
+    }
+    for (size_t i = 0; i < body->args.size(); ++i) {
+        bool nested = inElementBody || (i == 0 && isElementBodyMethod(body));
+        copy->args.push_back(substitute(body->args[i].get(), args, nested));
+    }
+    return copy;
+}
+
+static bool containsCall(const Expr* expr) {
+    bool calls = false;
+    walk(expr, false, [&](const Expr* node, bool) {
+        if (node->kind == ExprKind::Call) calls = true;
+    });
+    return calls;
+}
+
+static const Expr* returnedExpr(const FunctionDecl* fn) {
+    if (fn->body.size() != 1) return nullptr;
+    auto returnStmt = dynamic_cast<const ReturnStmt*>(fn->body[0].get());
+    return returnStmt ? returnStmt->expr.get() : nullptr;
+}
+
+bool Inliner::isCandidate(const FunctionDecl* fn) const {
+    const Expr* body = returnedExpr(fn);
+    // The result must not need converting to the return type
+    if (!body || !sameType(body->type, fn->return_type)) return false;
+
+    size_t nodes = 0;
+    bool calls = false;
+    walk(body, false, [&](const Expr* node, bool) {
+        nodes++;
+        if (node->kind == ExprKind::Call && node->function) calls = true;
+    });
+    // Bodies left calling a function are recursive or call something too big
+    return !calls && nodes <= kMaxInlineNodes;
+}
+
+void Inliner::inlineCalls(vector<unique_ptr<Stmt>>& program) {
+    // Functions first, in order, so a small function calling an earlier
+    // small function becomes a candidate itself
+    for (auto& stmt : program) {
+        auto fn = dynamic_cast<FunctionDecl*>(stmt.get());
+        if (!fn) continue;
+        hostLocals.clear();
+        for (const auto& param : fn->params) {
+            hostLocals.insert(param.name);
+        }
+        collectAssignedNames(fn->body, hostLocals);
+        rewriteBlock(fn->body);
+        if (isCandidate(fn)) {
+            candidates.insert(fn);
+        }
+    }
+
+    // Then the top level, which skips the function declarations
+    hostLocals.clear();
+    rewriteBlock(program);
+}
+
+void Inliner::rewriteBlock(vector<unique_ptr<Stmt>>& body) {
+    for (auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<LetStmt*>(stmt.get())) {
+            rewrite(letStmt->expr);
+        } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt.get())) {
+            rewrite(printStmt->expr);
+        } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt.get())) {
+            rewrite(assignStmt->expr);
+        } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt.get())) {
+            rewrite(whileStmt->condition);
+            rewriteBlock(whileStmt->body);
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt.get())) {
+            rewrite(forStmt->iterable);
+            rewriteBlock(forStmt->body);
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get())) {
+            rewrite(ifStmt->condition);
+            rewriteBlock(ifStmt->then_body);
+            rewriteBlock(ifStmt->else_body);
+        } else if (auto returnStmt = dynamic_cast<ReturnStmt*>(stmt.get())) {
+            rewrite(returnStmt->expr);
+            // An inlined tail call is no longer a call
+            const Expr* value = returnStmt->expr.get();
+            returnStmt->tail_call = returnStmt->tail_call && value->kind == ExprKind::Call && value->function;
+        } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt.get())) {
+            for (auto& arg : exprStmt->expr->args) {
+                rewrite(arg);
+            }
+        }
+    }
+}
+
+void Inliner::rewrite(unique_ptr<Expr>& expr) {
+    if (!expr) return;
+    rewrite(expr->left);
+    rewrite(expr->right);
+    rewrite(expr->start);
+    rewrite(expr->end);
+    for (auto& element : expr->elements) {
+        rewrite(element);
+    }
+    for (auto& arg : expr->args) {
+        rewrite(arg);
+    }
+    if (expr->kind == ExprKind::Call && expr->function) {
+        tryInline(expr);
+    }
+}
+
+bool Inliner::tryInline(unique_ptr<Expr>& call) {
+    const FunctionDecl* fn = call->function;
+    if (!candidates.count(fn)) return false;
+    const Expr* body = returnedExpr(fn);
+
+    // Uses of each parameter, inside and outside element bodies, and the
+    // globals the body reads
+    unordered_map<Interned, pair<int, int>> uses;
+    unordered_set<Interned> params;
+    for (const auto& param : fn->params) {
+        params.insert(param.name);
+    }
+    bool capturesLocal = false;
+    walk(body, false, [&](const Expr* node, bool inElementBody) {
+        if (node->kind != ExprKind::Identifier) return;
+        const string& name = node->name;
+        if (inElementBody && isElementName(name)) return;
+        if (params.count(name)) {
+            (inElementBody ? uses[name].second : uses[name].first)++;
+        } else if (hostLocals.count(name)) {
+            capturesLocal = true;
+        }
+    });
+    if (capturesLocal) return false;
+
+    unordered_map<Interned, const Expr*> args;
+    for (size_t i = 0; i < fn->params.size(); ++i) {
+        const Param& param = fn->params[i];
+        const Expr* arg = call->args[i].get();
+        // Arguments are converted to the parameter type on a real call
+        if (!sameType(arg->type, param.type)) return false;
+
+        const pair<int, int>& count = uses[param.name];
+        bool literal = arg->kind == ExprKind::NumberLiteral || arg->kind == ExprKind::StringLiteral;
+        bool simple = literal || arg->kind == ExprKind::Identifier;
+        // The caller's `it` would be captured by a map/filter/reduce body
+        if (arg->kind == ExprKind::Identifier && isElementName(arg->name) && count.second > 0) {
+            return false;
+        }
+        // Anything else is evaluated exactly once, like a real call would.
+        // It is evaluated where the parameter is used rather than before the
+        // body, so it must not call anything whose effects could be reordered.
+        if (!simple && (count.first != 1 || count.second != 0 || containsCall(arg))) return false;
+        args[param.name] = arg;
+    }
+
+    call = substitute(body, args, false);
+    count++;
+    return true;
+}
+
+void Inliner::printReport(ostream& out) const {
+    out << "inliner: " << count << " call(s) inlined\n";
+}
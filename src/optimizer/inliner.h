@@ -0,0 +1,34 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "../parser/ast.h"
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Replaces calls to small non-recursive functions, those whose body is a
+// single `return expr`, with a copy of expr in which the parameters are
+// replaced by the arguments. Must run after SemanticAnalyzer (calls have to
+// be resolved) and before FrameLayout.
+class Inliner {
+public:
+    void inlineCalls(std::vector<std::unique_ptr<Stmt>>& program);
+
+    size_t inlined() const { return count; }
+    void printReport(std::ostream& out) const;
+
+private:
+    size_t count = 0;
+    std::unordered_set<const FunctionDecl*> candidates;
+    // Locals of the function being rewritten; an inlined body must not
+    // mention a global of the same name
+    std::unordered_set<Interned> hostLocals;
+
+    void rewriteBlock(std::vector<std::unique_ptr<Stmt>>& body);
+    void rewrite(std::unique_ptr<Expr>& expr);
+    bool tryInline(std::unique_ptr<Expr>& call);
+    bool isCandidate(const FunctionDecl* fn) const;
+};
+
+#endif
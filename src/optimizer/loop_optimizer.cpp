@@ -0,0 +1,493 @@
+#include "loop_optimizer.h"
+#include <functional>
+#include <map>
+
+using namespace std;
+
+static bool isElementBodyMethod(const string& method) {
+    return method == "map" || method == "filter" || method == "reduce";
+}
+
+static bool isLiteral(const Expr* expr) {
+    return expr->kind == ExprKind::NumberLiteral || expr->kind == ExprKind::StringLiteral;
+}
+
+static bool isIntegerLiteral(const Expr* expr) {
+    return expr->kind == ExprKind::NumberLiteral && isIntegerKind(expr->type.kind);
+}
+
+static unique_ptr<Expr> makeIdentifier(const string& name, const Type& type, int line, int column) {
+    auto expr = make_unique<Expr>(line, column);
+    expr->kind = ExprKind::Identifier;
+    expr->name = name;
+    expr->type = type;
+    return expr;
+}
+
+static unique_ptr<Expr> makeBinary(const string& op, unique_ptr<Expr> left, unique_ptr<Expr> right) {
+    auto expr = make_unique<Expr>(left->line, left->column);
+    expr->kind = ExprKind::Binary;
+    expr->op = op;
+    expr->type = i32Type();
+    expr->left = std::move(left);
+    expr->right = std::move(right);
+    return expr;
+}
+
+static unique_ptr<Expr> makeInteger(int value, int line, int column) {
+    auto expr = make_unique<Expr>(line, column);
+    expr->kind = ExprKind::NumberLiteral;
+    expr->int_value = value;
+    expr->type = i32Type();
+    return expr;
+}
+
+static unique_ptr<LetStmt> makeLet(const string& name, unique_ptr<Expr> value, int line, int column) {
+    auto let = make_unique<LetStmt>();
+    let->name = name;
+    let->expr = std::move(value);
+    let->line = line;
+    let->column = column;
+    return let;
+}
+
+// Calls visit on every expression slot directly owned by statements of body,
+// descending into nested blocks
+static void forEachExprSlot(vector<unique_ptr<Stmt>>& body, const function<void(unique_ptr<Expr>&)>& visit) {
+    for (auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<LetStmt*>(stmt.get())) {
+            visit(letStmt->expr);
+        } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt.get())) {
+            visit(printStmt->expr);
+        } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt.get())) {
+            visit(assignStmt->expr);
+        } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt.get())) {
+            visit(whileStmt->condition);
+            forEachExprSlot(whileStmt->body, visit);
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt.get())) {
+            visit(forStmt->iterable);
+            forEachExprSlot(forStmt->body, visit);
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get())) {
+            visit(ifStmt->condition);
+            forEachExprSlot(ifStmt->then_body, visit);
+            forEachExprSlot(ifStmt->else_body, visit);
+        } else if (auto returnStmt = dynamic_cast<ReturnStmt*>(stmt.get())) {
+            visit(returnStmt->expr);
+        } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt.get())) {
+            visit(exprStmt->expr);
+        }
+    }
+}
+
+// Like forEachExprSlot, but only the slots evaluated on every pass through
+// body: not the branches of an if nor the bodies of nested loops, which
+// may not run at all
+static void forEachUnconditionalSlot(vector<unique_ptr<Stmt>>& body,
+                                     const function<void(unique_ptr<Expr>&)>& visit) {
+    for (auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<LetStmt*>(stmt.get())) {
+            visit(letStmt->expr);
+        } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt.get())) {
+            visit(printStmt->expr);
+        } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt.get())) {
+            visit(assignStmt->expr);
+        } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt.get())) {
+            visit(whileStmt->condition);
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt.get())) {
+            visit(forStmt->iterable);
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get())) {
+            visit(ifStmt->condition);
+        } else if (auto returnStmt = dynamic_cast<ReturnStmt*>(stmt.get())) {
+            visit(returnStmt->expr);
+        } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt.get())) {
+            visit(exprStmt->expr);
+        }
+    }
+}
+
+// Visits every node of an expression tree except the bodies of
+// map/filter/reduce, where `it` and `acc` mean something else
+static void forEachNode(unique_ptr<Expr>& expr, const function<void(unique_ptr<Expr>&)>& visit) {
+    if (!expr) return;
+    visit(expr);
+    if (!expr) return;
+    forEachNode(expr->left, visit);
+    forEachNode(expr->right, visit);
+    forEachNode(expr->start, visit);
+    forEachNode(expr->end, visit);
+    for (auto& element : expr->elements) {
+        forEachNode(element, visit);
+    }
+    bool skipBody = expr->kind == ExprKind::MethodCall && isElementBodyMethod(expr->method_name);
+    for (size_t i = skipBody ? 1 : 0; i < expr->args.size(); ++i) {
+        forEachNode(expr->args[i], visit);
+    }
+}
+
+// String methods that raise a runtime error when their first argument is empty
+static bool needsPattern(const string& method) {
+    return method == "count" || method == "replace" || method == "split";
+}
+
+// Whether expr builds a list or map, which may be arbitrarily large. A
+// range is lazy, and reading a binding copies nothing.
+static bool buildsCollection(const Expr* expr) {
+    if (expr->type.kind != TypeKind::List && expr->type.kind != TypeKind::Map) return false;
+    return expr->kind != ExprKind::Identifier && !(expr->kind == ExprKind::Call && expr->name == "range");
+}
+
+// True when evaluating expr before the loop gives the same value as on every
+// iteration, cannot fail and is cheap, so it is safe to run even if the loop
+// never does
+static bool isInvariant(const Expr* expr, const unordered_set<Interned>& mutated) {
+    if (!expr) return true;
+    if (buildsCollection(expr)) return false;
+
+    switch (expr->kind) {
+        case ExprKind::NumberLiteral:
+        case ExprKind::StringLiteral:
+            return true;
+
+        case ExprKind::Identifier:
+            return !mutated.count(expr->name);
+
+        case ExprKind::Binary: {
+            const string& op = expr->op;
+            bool dividing = op == "/" || op == "//" || op == "%";
+            bool floatResult = isFloatKind(expr->type.kind);
+            if (dividing && !floatResult && !(isIntegerLiteral(expr->right.get()) && expr->right->int_value != 0)) {
+                return false; // Integer division by zero traps
+            }
+            return isInvariant(expr->left.get(), mutated) && isInvariant(expr->right.get(), mutated);
+        }
+
+        case ExprKind::Unary:
+            return isInvariant(expr->left.get(), mutated);
+
+        case ExprKind::StringSlice:
+            if (expr->left->type.kind == TypeKind::List && expr->single_index && expr->bounds_check) {
+                return false; // May raise an out of range error
+            }
+            if (expr->left->type.kind == TypeKind::Map) {
+                return false; // May raise a missing key error
+            }
+            return isInvariant(expr->left.get(), mutated) && isInvariant(expr->start.get(), mutated) &&
+                   isInvariant(expr->end.get(), mutated);
+
+        case ExprKind::MethodCall:
+            if (isElementBodyMethod(expr->method_name) || expr->method_name == "sort") {
+                return false; // A pass over the whole list
+            }
+            if (expr->left->type.kind == TypeKind::String && needsPattern(expr->method_name) &&
+                !(!expr->args.empty() && expr->args[0]->kind == ExprKind::StringLiteral &&
+                  !expr->args[0]->string_value.empty())) {
+                return false; // An empty pattern is a runtime error
+            }
+            if (!isInvariant(expr->left.get(), mutated)) return false;
+            for (const auto& arg : expr->args) {
+                if (!isInvariant(arg.get(), mutated)) return false;
+            }
+            return true;
+
+        case ExprKind::ListLiteral:
+        case ExprKind::MapLiteral:
+            return false; // Builds a collection, see above
+
+        case ExprKind::Call:
+            if (expr->name != "range") return false;
+            if (expr->args.size() == 3 && !(isIntegerLiteral(expr->args[2].get()) && expr->args[2]->int_value != 0)) {
+                return false; // A zero step is a runtime error
+            }
+            for (const auto& arg : expr->args) {
+                if (!isInvariant(arg.get(), mutated)) return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+static bool worthHoisting(const Expr* expr) {
+    if (isLiteral(expr) || expr->kind == ExprKind::Identifier) return false;
+    if (expr->kind == ExprKind::Unary && isLiteral(expr->left.get())) return false;
+    return true;
+}
+
+// A condition under which loop runs at least once, cheap and safe to
+// evaluate one extra time before it; null if there is none
+static unique_ptr<Expr> entryCondition(const Stmt* loop) {
+    static const unordered_set<Interned> nothingMutated;
+    if (auto whileStmt = dynamic_cast<const WhileStmt*>(loop)) {
+        return isInvariant(whileStmt->condition.get(), nothingMutated) ? cloneExpr(whileStmt->condition.get())
+                                                                        : nullptr;
+    }
+    auto forStmt = dynamic_cast<const ForStmt*>(loop);
+    if (!forStmt) return nullptr;
+    const Expr* iterable = forStmt->iterable.get();
+    int line = forStmt->line, column = forStmt->column;
+
+    if (iterable->kind == ExprKind::Identifier) {
+        auto length = make_unique<Expr>(line, column);
+        length->kind = ExprKind::MethodCall;
+        length->method_name = "len";
+        length->type = i32Type();
+        length->left = cloneExpr(iterable);
+        return makeBinary(">", std::move(length), makeInteger(0, line, column));
+    }
+    if (iterable->kind != ExprKind::Call || iterable->name != "range" ||
+        !isInvariant(iterable, nothingMutated)) {
+        return nullptr;
+    }
+    const auto& args = iterable->args;
+    if (args.size() == 1) {
+        return makeBinary("<", makeInteger(0, line, column), cloneExpr(args[0].get()));
+    }
+    bool descending = args.size() == 3 && args[2]->int_value < 0;
+    return makeBinary(descending ? ">" : "<", cloneExpr(args[0].get()), cloneExpr(args[1].get()));
+}
+
+void LoopOptimizer::optimize(vector<unique_ptr<Stmt>>& program) {
+    // A call in a loop may assign any global a function assigns
+    for (const auto& stmt : program) {
+        if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+            collectAssignedNames(fn->body, functionWrites);
+        }
+    }
+
+    eliminateBoundsChecks(program);
+    optimizeBlock(program);
+    for (auto& stmt : program) {
+        if (auto fn = dynamic_cast<FunctionDecl*>(stmt.get())) {
+            eliminateBoundsChecks(fn->body);
+            optimizeBlock(fn->body);
+        }
+    }
+}
+
+void LoopOptimizer::eliminateBoundsChecks(vector<unique_ptr<Stmt>>& block) {
+    for (auto& stmt : block) {
+        if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt.get())) {
+            eliminateBoundsChecks(whileStmt->body);
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get())) {
+            eliminateBoundsChecks(ifStmt->then_body);
+            eliminateBoundsChecks(ifStmt->else_body);
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt.get())) {
+            eliminateBoundsChecks(forStmt->body);
+
+            // for i in range(xs.len()) / range(a, xs.len()[, s]) with literal a >= 0, s > 0
+            const Expr* iterable = forStmt->iterable.get();
+            if (iterable->kind != ExprKind::Call || iterable->name != "range") continue;
+            const auto& args = iterable->args;
+            if (args.size() >= 2 && !(isIntegerLiteral(args[0].get()) && args[0]->int_value >= 0)) continue;
+            if (args.size() == 3 && !(isIntegerLiteral(args[2].get()) && args[2]->int_value > 0)) continue;
+            const Expr* stop = args.size() == 1 ? args[0].get() : args[1].get();
+            if (stop->kind != ExprKind::MethodCall || stop->method_name != "len" || !stop->args.empty() ||
+                stop->left->kind != ExprKind::Identifier) {
+                continue;
+            }
+
+            const string& list = stop->left->name;
+            unordered_set<Interned> assigned;
+            collectAssignedNames(forStmt->body, assigned);
+            if (assigned.count(list) || assigned.count(forStmt->var)) continue;
+            // A function called from the body may rebind the list to a shorter one
+            if (functionWrites.count(list)) {
+                bool calls = false;
+                forEachExprSlot(forStmt->body, [&](unique_ptr<Expr>& slot) {
+                    calls = calls || callsFunction(slot.get());
+                });
+                if (calls) continue;
+            }
+
+            forEachExprSlot(forStmt->body, [&](unique_ptr<Expr>& slot) {
+                forEachNode(slot, [&](unique_ptr<Expr>& node) {
+                    if (node->kind == ExprKind::StringSlice && node->single_index && node->bounds_check &&
+                        node->left->kind == ExprKind::Identifier && node->left->name == list &&
+                        node->start->kind == ExprKind::Identifier && node->start->name == forStmt->var) {
+                        node->bounds_check = false;
+                        counts.boundsChecksRemoved++;
+                    }
+                });
+            });
+        }
+    }
+}
+
+void LoopOptimizer::optimizeBlock(vector<unique_ptr<Stmt>>& block) {
+    for (size_t i = 0; i < block.size(); ++i) {
+        vector<unique_ptr<Stmt>> preheader;
+
+        // Hoisted lets only run when the loop would, so a loop that never
+        // runs doesn't pay for them
+        unique_ptr<Expr> entry = entryCondition(block[i].get());
+        if (auto whileStmt = dynamic_cast<WhileStmt*>(block[i].get())) {
+            counts.loops++;
+            optimizeBlock(whileStmt->body);
+            if (entry) {
+                unordered_set<Interned> mutated = functionWrites;
+                collectAssignedNames(whileStmt->body, mutated);
+                hoistInvariants(whileStmt->body, mutated, preheader);
+                hoist(whileStmt->condition, mutated, preheader);
+            }
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(block[i].get())) {
+            counts.loops++;
+            optimizeBlock(forStmt->body);
+            strengthReduce(forStmt, preheader);
+            if (entry) {
+                unordered_set<Interned> mutated = functionWrites;
+                collectAssignedNames(forStmt->body, mutated);
+                mutated.insert(forStmt->var);
+                hoistInvariants(forStmt->body, mutated, preheader);
+            }
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(block[i].get())) {
+            optimizeBlock(ifStmt->then_body);
+            optimizeBlock(ifStmt->else_body);
+        }
+
+        if (preheader.empty()) continue;
+        for (auto& stmt : preheader) {
+            stmt->line = block[i]->line;
+            stmt->column = block[i]->column;
+        }
+        if (entry) {
+            // if entry { preheader; loop }
+            auto guard = make_unique<IfStmt>();
+            guard->line = block[i]->line;
+            guard->column = block[i]->column;
+            guard->condition = std::move(entry);
+            guard->then_body = std::move(preheader);
+            guard->then_body.push_back(std::move(block[i]));
+            block[i] = std::move(guard);
+            continue;
+        }
+        // Only strength reduction's lets, which are cheap and cannot fail
+        size_t added = preheader.size();
+        block.insert(block.begin() + i, make_move_iterator(preheader.begin()), make_move_iterator(preheader.end()));
+        i += added;
+    }
+}
+
+void LoopOptimizer::strengthReduce(ForStmt* loop, vector<unique_ptr<Stmt>>& preheader) {
+    const Expr* iterable = loop->iterable.get();
+    if (iterable->kind != ExprKind::Call || iterable->name != "range") return;
+    const auto& args = iterable->args;
+    const Expr* start = args.size() >= 2 ? args[0].get() : nullptr;
+    const Expr* step = args.size() == 3 ? args[2].get() : nullptr;
+
+    // A call in the body may assign any global a function assigns
+    unordered_set<Interned> assigned = functionWrites;
+    collectAssignedNames(loop->body, assigned);
+    if (assigned.count(loop->var)) return;
+    auto simpleInvariant = [&](const Expr* expr) {
+        return !expr || isIntegerLiteral(expr) ||
+               (expr->kind == ExprKind::Identifier && expr->name != loop->var &&
+                !assigned.count(expr->name) && isIntegerKind(expr->type.kind));
+    };
+    if (!simpleInvariant(start) || !simpleInvariant(step)) return;
+
+    // The other operand of var * c, or null when expr is not such a product
+    auto factor = [&](const Expr* expr) -> const Expr* {
+        if (expr->kind != ExprKind::Binary || expr->op != "*" || expr->type.kind != TypeKind::I32) return nullptr;
+        const Expr* sides[2] = { expr->left.get(), expr->right.get() };
+        for (int side = 0; side < 2; ++side) {
+            const Expr* var = sides[side];
+            const Expr* other = sides[1 - side];
+            if (var->kind == ExprKind::Identifier && var->name == loop->var &&
+                other->type.kind == TypeKind::I32 && simpleInvariant(other)) {
+                return other;
+            }
+        }
+        return nullptr;
+    };
+    auto key = [](const Expr* constant) {
+        return constant->kind == ExprKind::Identifier ? "$" + constant->name
+                                                       : to_string(constant->int_value);
+    };
+
+    map<Interned, int> uses;
+    forEachExprSlot(loop->body, [&](unique_ptr<Expr>& slot) {
+        forEachNode(slot, [&](unique_ptr<Expr>& node) {
+            if (const Expr* constant = factor(node.get())) uses[key(constant)]++;
+        });
+    });
+
+    for (const auto& entry : uses) {
+        if (entry.second < 2) continue;
+
+        string name = "$sr" + to_string(nextTemp++);
+        unique_ptr<Expr> scale;
+        forEachExprSlot(loop->body, [&](unique_ptr<Expr>& slot) {
+            forEachNode(slot, [&](unique_ptr<Expr>& node) {
+                const Expr* candidate = factor(node.get());
+                if (!candidate || key(candidate) != entry.first) return;
+                if (!scale) scale = cloneExpr(candidate);
+                node = makeIdentifier(name, i32Type(), node->line, node->column);
+            });
+        });
+
+        int line = loop->line, column = loop->column;
+        unique_ptr<Expr> initial = start ? cloneExpr(start) : makeInteger(0, line, column);
+        preheader.push_back(makeLet(name, makeBinary("*", std::move(initial), cloneExpr(scale.get())),
+                                    line, column));
+
+        unique_ptr<Expr> increment;
+        if (isIntegerLiteral(scale.get()) && (!step || isIntegerLiteral(step))) {
+            increment = makeInteger((step ? step->int_value : 1) * scale->int_value, line, column);
+        } else {
+            string stepName = "$sr" + to_string(nextTemp++);
+            unique_ptr<Expr> stepValue = step ? cloneExpr(step) : makeInteger(1, line, column);
+            preheader.push_back(makeLet(stepName, makeBinary("*", std::move(stepValue), std::move(scale)),
+                                        line, column));
+            increment = makeIdentifier(stepName, i32Type(), line, column);
+        }
+
+        auto update = make_unique<AssignStmt>();
+        update->name = name;
+        update->target_type = i32Type();
+        update->expr = makeBinary("+", makeIdentifier(name, i32Type(), line, column), std::move(increment));
+        update->line = line;
+        update->column = column;
+        loop->body.push_back(std::move(update));
+        counts.strengthReduced++;
+    }
+}
+
+void LoopOptimizer::hoistInvariants(vector<unique_ptr<Stmt>>& body, const unordered_set<Interned>& mutated,
+                                    vector<unique_ptr<Stmt>>& preheader) {
+    forEachUnconditionalSlot(body, [&](unique_ptr<Expr>& slot) { hoist(slot, mutated, preheader); });
+}
+
+void LoopOptimizer::hoist(unique_ptr<Expr>& expr, const unordered_set<Interned>& mutated,
+                          vector<unique_ptr<Stmt>>& preheader) {
+    if (!expr) return;
+
+    if (worthHoisting(expr.get()) && isInvariant(expr.get(), mutated)) {
+        string name = "$licm" + to_string(nextTemp++);
+        Type type = expr->type;
+        int line = expr->line, column = expr->column;
+        preheader.push_back(makeLet(name, std::move(expr), line, column));
+        expr = makeIdentifier(name, type, line, column);
+        counts.hoisted++;
+        return;
+    }
+
+    hoist(expr->left, mutated, preheader);
+    // The right side of && and || only runs when the left doesn't decide
+    if (!(expr->kind == ExprKind::Binary && (expr->op == "&&" || expr->op == "||"))) {
+        hoist(expr->right, mutated, preheader);
+    }
+    hoist(expr->start, mutated, preheader);
+    hoist(expr->end, mutated, preheader);
+    for (auto& element : expr->elements) {
+        hoist(element, mutated, preheader);
+    }
+    bool skipBody = expr->kind == ExprKind::MethodCall && isElementBodyMethod(expr->method_name);
+    for (size_t i = skipBody ? 1 : 0; i < expr->args.size(); ++i) {
+        hoist(expr->args[i], mutated, preheader);
+    }
+}
+
+void LoopOptimizer::printReport(ostream& out) const {
+    out << "loop optimizer: " << counts.loops << " loop(s), " << counts.hoisted << " expression(s) hoisted, "
+        << counts.strengthReduced << " product(s) strength-reduced, " << counts.boundsChecksRemoved
+        << " bounds check(s) removed\n";
+}
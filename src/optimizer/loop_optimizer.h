@@ -0,0 +1,45 @@
+#ifndef LOOP_OPTIMIZER_H
+#define LOOP_OPTIMIZER_H
+
+#include "../parser/ast.h"
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct LoopOptStats {
+    size_t loops = 0;
+    size_t hoisted = 0;
+    size_t strengthReduced = 0;
+    size_t boundsChecksRemoved = 0;
+};
+
+// Rewrites while/for loops of an analyzed program in place:
+//  - removes bounds checks on xs[i] when i walks range(xs.len())
+//  - turns repeated i * c into a running sum updated once per iteration
+//  - hoists invariant, cheap, non-trapping expressions into lets before the
+//    loop, guarded by a condition under which the loop runs at least once
+// Must run after SemanticAnalyzer, since it relies on expression types.
+// Introduced bindings are named $licmN / $srN, which source code cannot spell.
+class LoopOptimizer {
+public:
+    void optimize(std::vector<std::unique_ptr<Stmt>>& program);
+
+    const LoopOptStats& stats() const { return counts; }
+    void printReport(std::ostream& out) const;
+
+private:
+    LoopOptStats counts;
+    size_t nextTemp = 0;
+    std::unordered_set<Interned> functionWrites;
+
+    void eliminateBoundsChecks(std::vector<std::unique_ptr<Stmt>>& block);
+    void optimizeBlock(std::vector<std::unique_ptr<Stmt>>& block);
+    void strengthReduce(ForStmt* loop, std::vector<std::unique_ptr<Stmt>>& preheader);
+    void hoistInvariants(std::vector<std::unique_ptr<Stmt>>& body, const std::unordered_set<Interned>& mutated,
+                         std::vector<std::unique_ptr<Stmt>>& preheader);
+    void hoist(std::unique_ptr<Expr>& expr, const std::unordered_set<Interned>& mutated,
+               std::vector<std::unique_ptr<Stmt>>& preheader);
+};
+
+#endif
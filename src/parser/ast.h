@@ -2,9 +2,11 @@
 #define AST_H
 
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 #include "../semantics/types.h"
+#include "../util/interner.h"
 using namespace std;
 
 enum class ExprKind {
@@ -15,7 +17,23 @@ enum class ExprKind {
     Unary,
     StringSlice,
     MethodCall,
-    ListLiteral
+    ListLiteral,
+    Call,
+    // {key: value, ...}: keys in elements, values in args
+    MapLiteral
+};
+
+struct FunctionDecl;
+
+// Where a name lives at run time, chosen by FrameLayout
+enum class Storage : unsigned char {
+    Unresolved,
+    // slot indexes the evaluator's globals
+    Global,
+    // slot indexes the frame of the current call
+    Local,
+    // `it` (slot 0) or `acc` (slot 1) of a map/filter/reduce body
+    Element
 };
 
 struct Expr {
@@ -25,6 +43,8 @@ struct Expr {
     int int_value;
     double double_value;
     string string_value;
+    // Name of an Identifier or Call
+    Interned name;
     
     string op;
     unique_ptr<Expr> left;
@@ -32,32 +52,192 @@ struct Expr {
     
     unique_ptr<Expr> start;
     unique_ptr<Expr> end;
+    // StringSlice written as x[i] rather than x[a:b]
+    bool single_index;
+    // Cleared by the loop optimizer when the index is proven in range
+    bool bounds_check;
+    // Identifier: where its value is read from
+    Storage storage;
+    int slot;
+    // Call: the user function called, null for builtins
+    const FunctionDecl* function;
     
-    string method_name;
+    Interned method_name;
     vector<unique_ptr<Expr>> args;
     vector<unique_ptr<Expr>> elements;
 
     int line;
     int column;
     
-    Expr() : kind(ExprKind::NumberLiteral), int_value(0), double_value(0.0), line(0), column(0) {}
-    Expr(int l, int c) : kind(ExprKind::NumberLiteral), int_value(0), double_value(0.0), line(l), column(c) {}
+    Expr() : kind(ExprKind::NumberLiteral), int_value(0), double_value(0.0), single_index(false), bounds_check(true), storage(Storage::Unresolved), slot(-1), function(nullptr), line(0), column(0) {}
+    Expr(int l, int c) : kind(ExprKind::NumberLiteral), int_value(0), double_value(0.0), single_index(false), bounds_check(true), storage(Storage::Unresolved), slot(-1), function(nullptr), line(l), column(c) {}
 };
 
+// Deep copy of an expression tree, analysis results included
+inline unique_ptr<Expr> cloneExpr(const Expr* expr) {
+    if (!expr) return nullptr;
+    auto copy = make_unique<Expr>(expr->line, expr->column);
+    copy->kind = expr->kind;
+    copy->type = expr->type;
+    copy->int_value = expr->int_value;
+    copy->double_value = expr->double_value;
+    copy->string_value = expr->string_value;
+    copy->name = expr->name;
+    copy->op = expr->op;
+    copy->left = cloneExpr(expr->left.get());
+    copy->right = cloneExpr(expr->right.get());
+    copy->start = cloneExpr(expr->start.get());
+    copy->end = cloneExpr(expr->end.get());
+    copy->single_index = expr->single_index;
+    copy->bounds_check = expr->bounds_check;
+    copy->storage = expr->storage;
+    copy->slot = expr->slot;
+    copy->function = expr->function;
+    copy->method_name = expr->method_name;
+    for (const auto& arg : expr->args) copy->args.push_back(cloneExpr(arg.get()));
+    for (const auto& element : expr->elements) copy->elements.push_back(cloneExpr(element.get()));
+    return copy;
+}
+
+// Builtin functions that read or write data files: load_array(path,
+// "type"), load_shape(path), read_csv(path, column, "type"), and the
+// asynchronous read_async(path, "type"), write_async(path, data) and
+// await(future). Their results depend on the files at run time, so they are
+// never evaluated while compiling.
+inline bool isDataBuiltin(const string& name) {
+    return name == "load_array" || name == "load_shape" || name == "read_csv" || name == "read_async" ||
+           name == "write_async" || name == "await";
+}
+
+// True when expr calls a user function anywhere, map/filter/reduce bodies included
+inline bool callsFunction(const Expr* expr) {
+    if (!expr) return false;
+    if (expr->kind == ExprKind::Call && expr->function) return true;
+    if (callsFunction(expr->left.get()) || callsFunction(expr->right.get()) || callsFunction(expr->start.get()) ||
+        callsFunction(expr->end.get())) {
+        return true;
+    }
+    for (const auto& element : expr->elements) {
+        if (callsFunction(element.get())) return true;
+    }
+    for (const auto& arg : expr->args) {
+        if (callsFunction(arg.get())) return true;
+    }
+    return false;
+}
+
 struct Stmt {
+    int line = 0;
+    int column = 0;
+
     virtual ~Stmt() = default;
 };
 
 struct LetStmt : public Stmt {
-    string name;
+    Interned name;
     Type declared_type;
+    // Narrower representation chosen by range analysis, Unknown if none
+    Type storage_type;
     unique_ptr<Expr> expr;
+    // Global id or frame slot of the binding, see Storage
+    Storage storage = Storage::Unresolved;
+    int slot = -1;
+    // Declared with const; ConstEvaluator replaces expr with its value
+    bool constant = false;
+
+    LetStmt() : declared_type(unknownType()), storage_type(unknownType()) {}
 
-    LetStmt() : declared_type(unknownType()) {}
+    const Type& storageType() const {
+        return storage_type.kind != TypeKind::Unknown ? storage_type : declared_type;
+    }
 };
 
 struct PrintStmt : public Stmt {
     unique_ptr<Expr> expr;
 };
 
+struct AssignStmt : public Stmt {
+    Interned name;
+    unique_ptr<Expr> expr;
+    // Type of the binding being assigned, filled in by semantic analysis
+    Type target_type;
+    Storage storage = Storage::Unresolved;
+    int slot = -1;
+
+    AssignStmt() : target_type(unknownType()) {}
+};
+
+struct WhileStmt : public Stmt {
+    unique_ptr<Expr> condition;
+    vector<unique_ptr<Stmt>> body;
+};
+
+struct ForStmt : public Stmt {
+    Interned var;
+    unique_ptr<Expr> iterable;
+    vector<unique_ptr<Stmt>> body;
+    Storage storage = Storage::Unresolved;
+    int slot = -1;
+};
+
+struct IfStmt : public Stmt {
+    unique_ptr<Expr> condition;
+    vector<unique_ptr<Stmt>> then_body;
+    vector<unique_ptr<Stmt>> else_body;
+};
+
+struct Param {
+    Interned name;
+    Type type;
+};
+
+// fn name(a: T, ...) -> R { ... }. Only allowed at the top level.
+struct FunctionDecl : public Stmt {
+    Interned name;
+    vector<Param> params;
+    // Unknown when the function returns no value
+    Type return_type;
+    vector<unique_ptr<Stmt>> body;
+    // Slots per call: parameters first, then every other local. Set by FrameLayout.
+    int frame_size = 0;
+
+    FunctionDecl() : return_type(unknownType()) {}
+};
+
+struct ReturnStmt : public Stmt {
+    // Null for a bare `return` in a function without a return type
+    unique_ptr<Expr> expr;
+    // Return type of the enclosing function, filled in by semantic analysis
+    Type return_type;
+    // `return f(...)` that reuses the current frame instead of nesting a call
+    bool tail_call = false;
+
+    ReturnStmt() : return_type(unknownType()) {}
+};
+
+// A call evaluated for its effects, e.g. `log(x)`
+struct ExprStmt : public Stmt {
+    unique_ptr<Expr> expr;
+};
+
+// Names a block may rebind: assignment targets, lets and loop variables,
+// including those in nested blocks
+inline void collectAssignedNames(const vector<unique_ptr<Stmt>>& body, unordered_set<Interned>& names) {
+    for (const auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
+            names.insert(letStmt->name);
+        } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt.get())) {
+            names.insert(assignStmt->name);
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            collectAssignedNames(whileStmt->body, names);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            names.insert(forStmt->var);
+            collectAssignedNames(forStmt->body, names);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            collectAssignedNames(ifStmt->then_body, names);
+            collectAssignedNames(ifStmt->else_body, names);
+        }
+    }
+}
+
 #endif
\ No newline at end of file
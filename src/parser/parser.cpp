@@ -1,5 +1,5 @@
 #include "parser.h"
-#include <iostream>
+#include "../util/diagnostics.h"
 #include <cstdlib>
 
 using namespace std;
@@ -15,21 +15,23 @@ void Parser::advance() {
 
 void Parser::expect(TokenKind kind) {
     if (current.kind != kind) {
-        cerr << "Parse error at line " << current.line << ", column " << current.column 
-             << ": expected different token\n";
-        exit(1);
+        compileError("Parse error at line " + to_string(current.line) + ", column " + to_string(current.column) +
+                     ": expected different token");
     }
     advance();
 }
 
+// `let name[: type] = expr`, or the same with `const`
 unique_ptr<LetStmt> Parser::parseLet() {
-    expect(TokenKind::KeywordLet);
+    bool constant = current.kind == TokenKind::KeywordConst;
+    advance();
 
     string name = current.text;
     expect(TokenKind::Identifier);
 
     auto stmt = make_unique<LetStmt>();
     stmt->name = name;
+    stmt->constant = constant;
 
     if (current.kind == TokenKind::Colon) {
         advance(); // Consume the colon
@@ -228,6 +230,8 @@ unique_ptr<Expr> Parser::parsePostfix() {
                     node->end = make_unique<Expr>(current.line, current.column); // Also update this internal expr
                     node->end->kind = ExprKind::NumberLiteral;
                     node->end->int_value = -1;
+                    node->end->type = i32Type();
+                    node->single_index = true;
                     expr = std::move(node);
                 }
             }
@@ -242,7 +246,7 @@ unique_ptr<Expr> Parser::parsePostfix() {
             
             if (current.kind != TokenKind::RParen) {
                 args.push_back(parseExpr());
-                while (current.kind == TokenKind::Plus) {
+                while (current.kind == TokenKind::Comma) {
                     advance();
                     args.push_back(parseExpr());
                 }
@@ -291,8 +295,13 @@ unique_ptr<Expr> Parser::parsePrimary() {
     } else if (current.kind == TokenKind::Identifier) {
         auto node = make_unique<Expr>(current.line, current.column);
         node->kind = ExprKind::Identifier;
-        node->string_value = current.text;
+        node->name = current.text;
         advance();
+
+        if (current.kind == TokenKind::LParen) {
+            // Call such as range(0, 10) or a user function
+            parseCallArgs(node.get());
+        }
         return node;
         
     } else if (current.kind == TokenKind::LParen) {
@@ -316,10 +325,23 @@ unique_ptr<Expr> Parser::parsePrimary() {
         }
         expect(TokenKind::RBracket); // Expect closing RBracket
         return node;
+    } else if (current.kind == TokenKind::LBrace) {
+        // A brace never starts any other expression, so no block is mistaken for a map
+        auto node = make_unique<Expr>(current.line, current.column);
+        node->kind = ExprKind::MapLiteral;
+        advance();
+        while (current.kind != TokenKind::RBrace) {
+            node->elements.push_back(parseExpr());
+            expect(TokenKind::Colon);
+            node->args.push_back(parseExpr());
+            if (current.kind != TokenKind::Comma) break;
+            advance();
+        }
+        expect(TokenKind::RBrace);
+        return node;
     }
     
-    cerr << "Parse error at line " << current.line << ": unexpected token\n";
-    exit(1);
+    compileError("Parse error at line " + to_string(current.line) + ": unexpected token");
 }
 
 unique_ptr<PrintStmt> Parser::parsePrint() {
@@ -333,15 +355,166 @@ unique_ptr<PrintStmt> Parser::parsePrint() {
     return stmt;
 }
 
+void Parser::parseCallArgs(Expr* node) {
+    expect(TokenKind::LParen);
+    node->kind = ExprKind::Call;
+    if (current.kind != TokenKind::RParen) {
+        node->args.push_back(parseExpr());
+        while (current.kind == TokenKind::Comma) {
+            advance();
+            node->args.push_back(parseExpr());
+        }
+    }
+    expect(TokenKind::RParen);
+}
+
+// `name = expr`, or a call statement `name(args)`
+unique_ptr<Stmt> Parser::parseAssignOrCall() {
+    string name = current.text;
+    int line = current.line;
+    int column = current.column;
+    expect(TokenKind::Identifier);
+
+    if (current.kind == TokenKind::LParen) {
+        auto call = make_unique<Expr>(line, column);
+        call->name = name;
+        parseCallArgs(call.get());
+        auto stmt = make_unique<ExprStmt>();
+        stmt->expr = std::move(call);
+        return stmt;
+    }
+
+    auto stmt = make_unique<AssignStmt>();
+    stmt->name = name;
+    expect(TokenKind::Equal);
+    stmt->expr = parseExpr();
+    return stmt;
+}
+
+unique_ptr<FunctionDecl> Parser::parseFunction() {
+    expect(TokenKind::KeywordFn);
+    auto fn = make_unique<FunctionDecl>();
+    fn->name = current.text;
+    expect(TokenKind::Identifier);
+
+    expect(TokenKind::LParen);
+    while (current.kind != TokenKind::RParen) {
+        Param param;
+        param.name = current.text;
+        expect(TokenKind::Identifier);
+        expect(TokenKind::Colon);
+        param.type = parseType();
+        fn->params.push_back(param);
+        if (current.kind != TokenKind::Comma) break;
+        advance();
+    }
+    expect(TokenKind::RParen);
+
+    if (current.kind == TokenKind::Arrow) {
+        advance();
+        fn->return_type = parseType();
+    }
+    fn->body = parseBlock();
+    return fn;
+}
+
+unique_ptr<ReturnStmt> Parser::parseReturn() {
+    expect(TokenKind::KeywordReturn);
+    auto stmt = make_unique<ReturnStmt>();
+    // A bare return has to close its block
+    if (current.kind != TokenKind::RBrace) {
+        stmt->expr = parseExpr();
+    }
+    return stmt;
+}
+
+vector<unique_ptr<Stmt>> Parser::parseBlock() {
+    expect(TokenKind::LBrace);
+    vector<unique_ptr<Stmt>> body;
+    while (current.kind != TokenKind::RBrace) {
+        if (current.kind == TokenKind::EndOfFile) {
+            compileError("Parse error at line " + to_string(current.line) + ": expected '}' before end of file");
+        }
+        body.push_back(parseStatement());
+    }
+    expect(TokenKind::RBrace);
+    return body;
+}
+
+unique_ptr<WhileStmt> Parser::parseWhile() {
+    expect(TokenKind::KeywordWhile);
+    auto stmt = make_unique<WhileStmt>();
+    stmt->condition = parseExpr();
+    stmt->body = parseBlock();
+    return stmt;
+}
+
+unique_ptr<ForStmt> Parser::parseFor() {
+    expect(TokenKind::KeywordFor);
+    auto stmt = make_unique<ForStmt>();
+    stmt->var = current.text;
+    expect(TokenKind::Identifier);
+    expect(TokenKind::KeywordIn);
+    stmt->iterable = parseExpr();
+    stmt->body = parseBlock();
+    return stmt;
+}
+
+unique_ptr<IfStmt> Parser::parseIf() {
+    int line = current.line;
+    int column = current.column;
+    expect(TokenKind::KeywordIf);
+    auto stmt = make_unique<IfStmt>();
+    stmt->line = line;
+    stmt->column = column;
+    stmt->condition = parseExpr();
+    stmt->then_body = parseBlock();
+    if (current.kind == TokenKind::KeywordElse) {
+        advance();
+        if (current.kind == TokenKind::KeywordIf) {
+            stmt->else_body.push_back(parseIf());
+        } else {
+            stmt->else_body = parseBlock();
+        }
+    }
+    return stmt;
+}
+
 unique_ptr<Stmt> Parser::parseStatement() {
-    if (current.kind == TokenKind::KeywordLet) {
-        return parseLet();
+    int line = current.line;
+    int column = current.column;
+    unique_ptr<Stmt> stmt;
+
+    if (current.kind == TokenKind::KeywordLet || current.kind == TokenKind::KeywordConst) {
+        stmt = parseLet();
     } else if (current.kind == TokenKind::KeywordPrint) {
-        return parsePrint();
+        stmt = parsePrint();
+    } else if (current.kind == TokenKind::KeywordWhile) {
+        stmt = parseWhile();
+    } else if (current.kind == TokenKind::KeywordFor) {
+        stmt = parseFor();
+    } else if (current.kind == TokenKind::KeywordIf) {
+        stmt = parseIf();
+    } else if (current.kind == TokenKind::KeywordFn) {
+        stmt = parseFunction();
+    } else if (current.kind == TokenKind::KeywordReturn) {
+        stmt = parseReturn();
+    } else if (current.kind == TokenKind::Identifier) {
+        stmt = parseAssignOrCall();
+    } else {
+        compileError("Parse error at line " + to_string(current.line) + ": unexpected token in statement");
     }
-    
-    cerr << "Parse error at line " << current.line << ": unexpected token in statement\n";
-    exit(1);
+
+    stmt->line = line;
+    stmt->column = column;
+    return stmt;
+}
+
+unique_ptr<Stmt> Parser::parseNext() {
+    if (current.kind == TokenKind::EndOfFile) {
+        return nullptr;
+    }
+    return parseStatement();
 }
 
 vector<unique_ptr<Stmt>> Parser::parseProgram() {
@@ -379,6 +552,41 @@ Type Parser::parseType() {
         advance();
         return f64Type();
     }
+    if (current.kind == TokenKind::KeywordF16) {
+        advance();
+        return f16Type();
+    }
+    if (current.kind == TokenKind::KeywordBF16) {
+        advance();
+        return bf16Type();
+    }
+    if (current.kind == TokenKind::KeywordQ8) {
+        advance();
+        Type q8 = q8Type();
+        // Optional quantization parameters: q8(scale, zero_point)
+        if (current.kind == TokenKind::LParen) {
+            advance();
+            string scaleText = current.text;
+            expect(TokenKind::Number);
+            q8.scale = stod(scaleText);
+            expect(TokenKind::Comma);
+            bool negative = false;
+            if (current.kind == TokenKind::Minus) {
+                negative = true;
+                advance();
+            }
+            string zeroText = current.text;
+            expect(TokenKind::Number);
+            q8.zero_point = stoi(zeroText);
+            if (negative) q8.zero_point = -q8.zero_point;
+            expect(TokenKind::RParen);
+            if (q8.scale <= 0.0 || q8.zero_point < -128 || q8.zero_point > 127) {
+                compileError("Parse error at line " + to_string(current.line) +
+                             ": invalid q8 quantization parameters");
+            }
+        }
+        return q8;
+    }
     if (current.kind == TokenKind::KeywordString) {
         advance();
         return stringType();
@@ -390,7 +598,23 @@ Type Parser::parseType() {
         expect(TokenKind::RBracket);
         return listType(new Type(elem));
     }
+    if (current.kind == TokenKind::KeywordFuture) {
+        advance();
+        expect(TokenKind::LBracket);
+        Type elem = parseType();
+        expect(TokenKind::RBracket);
+        return futureType(new Type(elem));
+    }
+    // Not a keyword, since map is also the list method
+    if (current.kind == TokenKind::Identifier && current.text == "map") {
+        advance();
+        expect(TokenKind::LBracket);
+        Type key = parseType();
+        expect(TokenKind::Comma);
+        Type value = parseType();
+        expect(TokenKind::RBracket);
+        return mapType(new Type(key), new Type(value));
+    }
     
-    cerr << "Parse error at line " << current.line << ": unexpected token when parsing type\n";
-    exit(1);
+    compileError("Parse error at line " + to_string(current.line) + ": unexpected token when parsing type");
 }
\ No newline at end of file
@@ -10,6 +10,8 @@ class Parser {
 public:
     Parser(Lexer& lexer);
     std::vector<std::unique_ptr<Stmt>> parseProgram();
+    // The next top-level statement, or null at the end of the input
+    std::unique_ptr<Stmt> parseNext();
 
 private:
     Lexer& lexer;
@@ -22,6 +24,13 @@ private:
     std::unique_ptr<Stmt> parseStatement();
     std::unique_ptr<LetStmt> parseLet();
     std::unique_ptr<PrintStmt> parsePrint();
+    std::unique_ptr<Stmt> parseAssignOrCall();
+    std::unique_ptr<FunctionDecl> parseFunction();
+    std::unique_ptr<ReturnStmt> parseReturn();
+    std::unique_ptr<WhileStmt> parseWhile();
+    std::unique_ptr<ForStmt> parseFor();
+    std::unique_ptr<IfStmt> parseIf();
+    std::vector<std::unique_ptr<Stmt>> parseBlock();
 
     std::unique_ptr<Expr> parseExpr();
     std::unique_ptr<Expr> parseLogicalOr();
@@ -33,6 +42,7 @@ private:
     std::unique_ptr<Expr> parseUnary();
     std::unique_ptr<Expr> parsePostfix();
     std::unique_ptr<Expr> parsePrimary();
+    void parseCallArgs(Expr* node);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "memory.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// Replacements for the global allocation functions, feeding the counts in
+// memory.h. The nothrow and array forms of the standard library forward to
+// these. Linked into the executables only, never into libexotic.
+void* operator new(size_t size) {
+    if (allocationCounting.load(memory_order_relaxed)) {
+        allocationBytes.fetch_add(size, memory_order_relaxed);
+    }
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* block = malloc(size)) return block;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
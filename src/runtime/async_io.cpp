@@ -0,0 +1,367 @@
+#include "async_io.h"
+#include "thread_pool.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define EXOTIC_IO_URING 1
+#endif
+
+using namespace std;
+
+// Large enough to keep a disk busy with few requests, small enough that a
+// file's chunks spread over the ring
+static const size_t kIoChunk = 1 << 20;
+// Submission queue entries, and so the most chunks in flight at once
+static const unsigned kRingEntries = 256;
+static const size_t kIoThreads = 4;
+// Times a submission the kernel keeps refusing, with nothing else in
+// flight, is retried a millisecond apart before its requests fail
+static const unsigned kMaxSubmitRetries = 1000;
+
+void IoRequest::wait() {
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [this] { return complete; });
+}
+
+bool IoRequest::done() {
+    lock_guard<mutex> guard(lock);
+    return complete;
+}
+
+void IoRequest::fail(const string& message) {
+    if (failure.empty()) {
+        failure = (writing ? "could not write " : "could not read ") + path + ": " + message;
+    }
+}
+
+void IoRequest::finish() {
+    if (fd >= 0) {
+        if (close(fd) != 0 && writing) fail(strerror(errno));
+        fd = -1;
+    }
+    lock_guard<mutex> guard(lock);
+    complete = true;
+    finished.notify_all();
+}
+
+#ifdef EXOTIC_IO_URING
+
+struct IoChunk {
+    shared_ptr<IoRequest> request;
+    size_t offset;
+    size_t length;
+};
+
+// A raw io_uring: the kernel's submission and completion rings mapped into
+// memory, fed under a lock by any thread and drained by one reaper thread
+struct IoRing {
+    int fd = -1;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    mutex lock;
+    // Chunks waiting for room in the ring, which never holds more than
+    // kRingEntries so the completion ring can't overflow
+    deque<IoChunk*> pending;
+    // Entries in the ring, including the unsubmitted ones
+    size_t inFlight = 0;
+    // Entries published at the tail that no io_uring_enter has taken yet
+    unsigned unsubmitted = 0;
+
+    // False if the kernel has no io_uring or it lacks read and write
+    bool open() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, kRingEntries, &params);
+        if (fd < 0) return false;
+
+        io_uring_probe* probe = static_cast<io_uring_probe*>(
+            calloc(1, sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op)));
+        bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                         probe->last_op >= IORING_OP_WRITE &&
+                         (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+                         (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+        free(probe);
+        if (!supported) return false;
+
+        size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        void* sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        void* cq = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        void* entries = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sq == MAP_FAILED || cq == MAP_FAILED || entries == MAP_FAILED) return false;
+
+        char* sqBase = static_cast<char*>(sq);
+        sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+        sqes = static_cast<io_uring_sqe*>(entries);
+        char* cqBase = static_cast<char*>(cq);
+        cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+        thread(&IoRing::reap, this).detach();
+        return true;
+    }
+
+    void submit(const shared_ptr<IoRequest>& request) {
+        vector<shared_ptr<IoRequest>> failed;
+        {
+            lock_guard<mutex> guard(lock);
+            for (size_t offset = 0; offset < request->length; offset += kIoChunk) {
+                pending.push_back(new IoChunk{request, offset, min(kIoChunk, request->length - offset)});
+                request->chunksLeft++;
+            }
+            pump(failed);
+        }
+        for (const auto& failedRequest : failed) {
+            failedRequest->finish();
+        }
+    }
+
+    // Moves pending chunks into the ring while it has room, then offers the
+    // kernel every entry it hasn't taken yet; called locked. Requests that
+    // fail because the kernel won't take the ring are added to finished.
+    void pump(vector<shared_ptr<IoRequest>>& finished) {
+        unsigned tail = *sqTail;
+        unsigned added = 0;
+        while (!pending.empty() && inFlight < kRingEntries) {
+            IoChunk* chunk = pending.front();
+            pending.pop_front();
+            unsigned index = tail & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = chunk->request->writing ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe.fd = chunk->request->fd;
+            sqe.addr = (uint64_t)(uintptr_t)(chunk->request->bytes + chunk->offset);
+            sqe.len = (unsigned)chunk->length;
+            sqe.off = chunk->offset;
+            sqe.user_data = (uint64_t)(uintptr_t)chunk;
+            sqArray[index] = index;
+            tail++;
+            added++;
+            inFlight++;
+        }
+        if (added > 0) {
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+            unsubmitted += added;
+        }
+
+        unsigned retries = 0;
+        while (unsubmitted > 0) {
+            int submitted = (int)syscall(__NR_io_uring_enter, fd, unsubmitted, 0, 0, nullptr, 0);
+            if (submitted > 0) {
+                unsubmitted -= (unsigned)submitted;
+                continue;
+            }
+            if (submitted < 0 && errno == EINTR) continue;
+            bool busy = submitted == 0 || errno == EAGAIN || errno == EBUSY;
+            if (busy && inFlight > unsubmitted) {
+                // The kernel is out of resources for now; the reaper offers
+                // the rest again once entries it took complete
+                break;
+            }
+            if (busy && ++retries < kMaxSubmitRetries) {
+                // Nothing the kernel holds will complete and wake the reaper
+                this_thread::sleep_for(chrono::milliseconds(1));
+                continue;
+            }
+            abandon(submitted < 0 ? strerror(errno) : "the kernel accepted no I/O", finished);
+            break;
+        }
+    }
+
+    // Takes the entries the kernel never took back out of the ring and fails
+    // them along with every pending chunk; called locked. The kernel only
+    // reads the ring inside io_uring_enter calls that submit, which all hold
+    // the lock, so the tail can move back.
+    void abandon(const string& error, vector<shared_ptr<IoRequest>>& finished) {
+        unsigned tail = *sqTail;
+        vector<IoChunk*> chunks(pending.begin(), pending.end());
+        pending.clear();
+        for (unsigned i = unsubmitted; i > 0; --i) {
+            const io_uring_sqe& sqe = sqes[sqArray[(tail - i) & sqMask]];
+            chunks.push_back(reinterpret_cast<IoChunk*>((uintptr_t)sqe.user_data));
+        }
+        __atomic_store_n(sqTail, tail - unsubmitted, __ATOMIC_RELEASE);
+        inFlight -= unsubmitted;
+        unsubmitted = 0;
+        for (IoChunk* chunk : chunks) {
+            IoRequest& request = *chunk->request;
+            request.fail(error);
+            if (--request.chunksLeft == 0) finished.push_back(chunk->request);
+            delete chunk;
+        }
+    }
+
+    void reap() {
+        while (true) {
+            if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            vector<shared_ptr<IoRequest>> finished;
+            {
+                lock_guard<mutex> guard(lock);
+                for (; head != tail; ++head) {
+                    const io_uring_cqe& cqe = cqes[head & cqMask];
+                    IoChunk* chunk = reinterpret_cast<IoChunk*>((uintptr_t)cqe.user_data);
+                    IoRequest& request = *chunk->request;
+                    inFlight--;
+                    if (cqe.res > 0 && (size_t)cqe.res < chunk->length) {
+                        // Short read or write: the rest goes round again
+                        chunk->offset += (size_t)cqe.res;
+                        chunk->length -= (size_t)cqe.res;
+                        pending.push_front(chunk);
+                        continue;
+                    }
+                    if (cqe.res < 0) {
+                        request.fail(strerror(-cqe.res));
+                    } else if (cqe.res == 0) {
+                        request.fail("the file changed size");
+                    }
+                    if (--request.chunksLeft == 0) finished.push_back(chunk->request);
+                    delete chunk;
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                pump(finished);
+            }
+            for (const auto& request : finished) {
+                request->finish();
+            }
+        }
+    }
+};
+
+#else
+
+struct IoRing {
+    bool open() { return false; }
+    void submit(const shared_ptr<IoRequest>&) {}
+};
+
+#endif
+
+AsyncIo& AsyncIo::instance() {
+    static AsyncIo& io = *new AsyncIo;
+    return io;
+}
+
+AsyncIo::AsyncIo() {
+    const char* forced = getenv("EXOTIC_ASYNC_IO");
+    if (!forced || strcmp(forced, "threads") != 0) {
+        ring = make_unique<IoRing>();
+        if (!ring->open()) ring.reset();
+    }
+    if (!ring) {
+        threads = make_unique<ThreadPool>(kIoThreads);
+    }
+}
+
+const char* AsyncIo::backend() const {
+    return ring ? "io_uring" : "threads";
+}
+
+// Reads or writes the whole request with blocking calls, on an I/O thread
+static void transfer(unsigned char* into, const unsigned char* from, size_t length, int fd, bool writing,
+                     string& error) {
+    size_t done = 0;
+    while (done < length) {
+        size_t chunk = min(kIoChunk, length - done);
+        ssize_t count = writing ? pwrite(fd, from + done, chunk, (off_t)done)
+                                : pread(fd, into + done, chunk, (off_t)done);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            error = count < 0 ? strerror(errno) : "the file changed size";
+            return;
+        }
+        done += (size_t)count;
+    }
+}
+
+void AsyncIo::start(const shared_ptr<IoRequest>& request) {
+    if (request->length == 0) {
+        request->finish();
+        return;
+    }
+    if (ring) {
+        ring->submit(request);
+        return;
+    }
+    threads->submit([request] {
+        string error;
+        transfer(request->owned.get(), request->bytes, request->length, request->fd, request->writing, error);
+        if (!error.empty()) request->fail(error);
+        request->finish();
+    });
+}
+
+shared_ptr<IoRequest> AsyncIo::read(const string& path) {
+    auto request = make_shared<IoRequest>();
+    request->path = path;
+    request->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (request->fd < 0 || fstat(request->fd, &info) != 0) {
+        request->fail(strerror(errno));
+        request->finish();
+        return request;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        request->fail("not a regular file");
+        request->finish();
+        return request;
+    }
+    request->length = (size_t)info.st_size;
+    // Left uninitialized, since every byte is about to be read over
+    request->owned.reset(new (nothrow) unsigned char[request->length ? request->length : 1]);
+    if (!request->owned) {
+        request->fail("out of memory");
+        request->finish();
+        return request;
+    }
+    request->bytes = request->owned.get();
+    start(request);
+    return request;
+}
+
+shared_ptr<IoRequest> AsyncIo::write(const string& path, const unsigned char* data, size_t size,
+                                     shared_ptr<const void> keep) {
+    auto request = make_shared<IoRequest>();
+    request->path = path;
+    request->writing = true;
+    request->bytes = data;
+    request->length = size;
+    request->keep = std::move(keep);
+    request->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (request->fd < 0) {
+        request->fail(strerror(errno));
+        request->finish();
+        return request;
+    }
+    start(request);
+    return request;
+}
@@ -0,0 +1,82 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class ThreadPool;
+struct IoRing;
+
+// One whole-file read or write running in the background. Started by
+// AsyncIo; the caller does other work and calls wait() when it needs the
+// result. Nothing but done() and wait() may be used before wait() returns.
+class IoRequest {
+public:
+    void wait();
+    bool done();
+
+    // Set if the operation failed
+    const std::string& error() const { return failure; }
+    // The file's contents after a read, or the bytes written
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    friend class AsyncIo;
+    friend struct IoRing;
+
+    std::string path;
+    bool writing = false;
+    int fd = -1;
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    // Backs bytes for reads
+    std::unique_ptr<unsigned char[]> owned;
+    // Keeps the bytes of a write alive
+    std::shared_ptr<const void> keep;
+    // Chunks not yet completed
+    size_t chunksLeft = 0;
+    std::string failure;
+
+    std::mutex lock;
+    std::condition_variable finished;
+    bool complete = false;
+
+    void fail(const std::string& message);
+    void finish();
+};
+
+// Asynchronous file I/O for the whole process. Files are read and written
+// in 1 MiB chunks through an io_uring when the kernel offers one, with many
+// chunks in flight and one thread reaping completions. Where io_uring is
+// missing or disabled, or EXOTIC_ASYNC_IO=threads is set, each request
+// runs on a small pool of threads of its own doing blocking reads and
+// writes instead. Those threads never run program code, so waiting on a
+// request from any thread, thread pool workers included, cannot deadlock.
+class AsyncIo {
+public:
+    // Started on first use and never torn down, so requests still running
+    // at exit don't hold it up
+    static AsyncIo& instance();
+
+    std::shared_ptr<IoRequest> read(const std::string& path);
+    // Replaces the file with size bytes at data, which keep keeps alive
+    std::shared_ptr<IoRequest> write(const std::string& path, const unsigned char* data, size_t size,
+                                     std::shared_ptr<const void> keep);
+
+    // "io_uring" or "threads"
+    const char* backend() const;
+
+private:
+    AsyncIo();
+
+    std::unique_ptr<IoRing> ring;
+    std::unique_ptr<ThreadPool> threads;
+
+    void start(const std::shared_ptr<IoRequest>& request);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "csv.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Large enough that reading costs few system calls per megabyte
+static const size_t kCsvBuffer = 1 << 20;
+
+CsvReader::CsvReader() : buffer(kCsvBuffer) {}
+
+CsvReader::~CsvReader() {
+    if (fd >= 0) close(fd);
+}
+
+bool CsvReader::open(const string& path, string& error) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "could not open " + path + ": " + strerror(errno);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+bool CsvReader::refill() {
+    if (fd < 0) return false;
+    position = 0;
+    filled = 0;
+    while (true) {
+        ssize_t got = read(fd, buffer.data(), buffer.size());
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) readError = strerror(errno);
+        if (got <= 0) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        filled = (size_t)got;
+        return true;
+    }
+}
+
+bool CsvReader::startRecord() {
+    while (peek() == '\n' || peek() == '\r') {
+        get();
+    }
+    recordLine = currentLine;
+    return peek() >= 0;
+}
+
+int CsvReader::readField(string* field) {
+    if (field) field->clear();
+    bool quoted = peek() == '"';
+    if (quoted) get();
+    while (true) {
+        if (!quoted) {
+            // Copy up to the next separator straight from the buffer
+            size_t start = position;
+            while (position < filled) {
+                char c = buffer[position];
+                if (c == ',' || c == '\n' || c == '"') break;
+                position++;
+            }
+            if (field) field->append(buffer.data() + start, position - start);
+        }
+        int c = get();
+        if (c < 0 || (!quoted && (c == ',' || c == '\n'))) {
+            if (field && !field->empty() && field->back() == '\r') field->pop_back();
+            return c;
+        }
+        if (c == '"' && quoted) {
+            if (peek() == '"') {
+                get();
+            } else {
+                quoted = false;
+                continue;
+            }
+        }
+        if (field) field->push_back((char)c);
+    }
+}
+
+bool CsvReader::next(size_t column, string& field, bool& found) {
+    if (!startRecord()) return false;
+    found = false;
+    for (size_t index = 0;; ++index) {
+        int end = readField(index == column ? &field : nullptr);
+        if (index == column) found = true;
+        if (end != ',') return true;
+    }
+}
+
+bool CsvReader::next(vector<string>& fields) {
+    fields.clear();
+    if (!startRecord()) return false;
+    while (true) {
+        fields.emplace_back();
+        if (readField(&fields.back()) != ',') return true;
+    }
+}
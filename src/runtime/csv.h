@@ -0,0 +1,58 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Reads a CSV file one buffer at a time, so a file of any size costs one
+// buffer plus whatever the caller keeps of it. Fields are separated by
+// commas and records by newlines, CRLF included. A field in double quotes
+// may hold commas, newlines and "" for a quote. Blank lines are skipped.
+class CsvReader {
+public:
+    CsvReader();
+    ~CsvReader();
+
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+
+    // False with a message in error if the file can't be opened
+    bool open(const std::string& path, std::string& error);
+
+    // Reads the next record, keeping only the field at index column. False
+    // at the end of the file; found is false if the record is shorter.
+    bool next(size_t column, std::string& field, bool& found);
+    // Reads every field of the next record
+    bool next(std::vector<std::string>& fields);
+
+    // Line the last record read started on
+    size_t line() const { return recordLine; }
+    // Set if reading stopped on an I/O error rather than the end of the file
+    const std::string& error() const { return readError; }
+
+private:
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t filled = 0;
+    size_t currentLine = 1;
+    size_t recordLine = 0;
+    std::string readError;
+
+    bool refill();
+    int peek() { return position < filled || refill() ? (unsigned char)buffer[position] : -1; }
+    int get() {
+        int c = peek();
+        if (c >= 0) position++;
+        if (c == '\n') currentLine++;
+        return c;
+    }
+    // Skips blank lines; false at the end of the file
+    bool startRecord();
+    // Reads one field into field, or past it when field is null, and
+    // returns what ended it: ',', '\n' or -1 at the end of the file
+    int readField(std::string* field);
+};
+
+#endif
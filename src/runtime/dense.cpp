@@ -0,0 +1,182 @@
+#include "dense.h"
+#include "numeric.h"
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+template <typename T>
+static T loadAt(const unsigned char* data, size_t index) {
+    T value;
+    memcpy(&value, data + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+bool isDenseKind(TypeKind kind) {
+    return isNumericKind(kind);
+}
+
+size_t denseElementSize(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::I8:
+        case TypeKind::Q8:
+            return 1;
+        case TypeKind::I16:
+        case TypeKind::F16:
+        case TypeKind::BF16:
+            return 2;
+        case TypeKind::I32:
+        case TypeKind::F32:
+            return 4;
+        case TypeKind::I64:
+        case TypeKind::F64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+double DenseArray::valueAt(size_t index) const {
+    const unsigned char* bytes = data();
+    switch (element.kind) {
+        case TypeKind::I8: return loadAt<int8_t>(bytes, index);
+        case TypeKind::I16: return loadAt<int16_t>(bytes, index);
+        case TypeKind::I32: return loadAt<int32_t>(bytes, index);
+        case TypeKind::I64: return (double)loadAt<int64_t>(bytes, index);
+        case TypeKind::F32: return loadAt<float>(bytes, index);
+        case TypeKind::F64: return loadAt<double>(bytes, index);
+        case TypeKind::F16: return halfToFloat(loadAt<uint16_t>(bytes, index));
+        case TypeKind::BF16: return bfloat16ToFloat(loadAt<uint16_t>(bytes, index));
+        case TypeKind::Q8:
+            return dequantizeQ8(loadAt<int8_t>(bytes, index), (float)element.scale, element.zero_point);
+        default: return 0.0;
+    }
+}
+
+template <typename T>
+static void storeIntegers(vector<unsigned char>& storage, const vector<double>& values) {
+    T* out = reinterpret_cast<T*>(storage.data());
+    for (size_t i = 0; i < values.size(); ++i) {
+        out[i] = static_cast<T>(static_cast<long long>(values[i]));
+    }
+}
+
+shared_ptr<DenseArray> makeDenseArray(const Type& element, const vector<double>& values) {
+    auto array = make_shared<DenseArray>();
+    array->element = element;
+    array->element.element = nullptr;
+    array->count = values.size();
+    array->storage.resize(values.size() * denseElementSize(element.kind));
+
+    switch (element.kind) {
+        case TypeKind::I8: storeIntegers<int8_t>(array->storage, values); break;
+        case TypeKind::I16: storeIntegers<int16_t>(array->storage, values); break;
+        case TypeKind::I32: storeIntegers<int32_t>(array->storage, values); break;
+        case TypeKind::I64: storeIntegers<int64_t>(array->storage, values); break;
+        case TypeKind::F64:
+            memcpy(array->storage.data(), values.data(), values.size() * sizeof(double));
+            break;
+        default: {
+            // The narrow float formats all convert from f32 in bulk
+            vector<float> floats(values.begin(), values.end());
+            unsigned char* out = array->storage.data();
+            if (element.kind == TypeKind::F32) {
+                memcpy(out, floats.data(), floats.size() * sizeof(float));
+            } else if (element.kind == TypeKind::F16) {
+                convertFloatToHalf(floats.data(), reinterpret_cast<uint16_t*>(out), floats.size());
+            } else if (element.kind == TypeKind::BF16) {
+                convertFloatToBFloat16(floats.data(), reinterpret_cast<uint16_t*>(out), floats.size());
+            } else if (element.kind == TypeKind::Q8) {
+                quantizeQ8(floats.data(), reinterpret_cast<int8_t*>(out), floats.size(),
+                           (float)element.scale, element.zero_point);
+            }
+            break;
+        }
+    }
+    return array;
+}
+
+template <typename T>
+static void appendBytes(vector<unsigned char>& storage, T value) {
+    size_t at = storage.size();
+    storage.resize(at + sizeof(T));
+    memcpy(storage.data() + at, &value, sizeof(T));
+}
+
+void appendDense(DenseArray& array, double value) {
+    vector<unsigned char>& storage = array.storage;
+    switch (array.element.kind) {
+        case TypeKind::I8: appendBytes(storage, (int8_t)(long long)value); break;
+        case TypeKind::I16: appendBytes(storage, (int16_t)(long long)value); break;
+        case TypeKind::I32: appendBytes(storage, (int32_t)(long long)value); break;
+        case TypeKind::I64: appendBytes(storage, (int64_t)(long long)value); break;
+        case TypeKind::F32: appendBytes(storage, (float)value); break;
+        case TypeKind::F64: appendBytes(storage, value); break;
+        case TypeKind::F16: appendBytes(storage, floatToHalf((float)value)); break;
+        case TypeKind::BF16: appendBytes(storage, floatToBFloat16((float)value)); break;
+        case TypeKind::Q8:
+            appendBytes(storage, quantizeQ8((float)value, (float)array.element.scale, array.element.zero_point));
+            break;
+        default: return;
+    }
+    array.count++;
+}
+
+void denseToFloats(const DenseArray& array, float* out) {
+    const unsigned char* bytes = array.data();
+    switch (array.element.kind) {
+        case TypeKind::F32:
+            memcpy(out, bytes, array.count * sizeof(float));
+            break;
+        case TypeKind::F16:
+            convertHalfToFloat(reinterpret_cast<const uint16_t*>(bytes), out, array.count);
+            break;
+        case TypeKind::BF16:
+            convertBFloat16ToFloat(reinterpret_cast<const uint16_t*>(bytes), out, array.count);
+            break;
+        case TypeKind::Q8:
+            dequantizeQ8(reinterpret_cast<const int8_t*>(bytes), out, array.count,
+                         (float)array.element.scale, array.element.zero_point);
+            break;
+        default:
+            for (size_t i = 0; i < array.count; ++i) {
+                out[i] = (float)array.valueAt(i);
+            }
+            break;
+    }
+}
+
+double denseDot(const DenseArray& a, const DenseArray& b) {
+    size_t count = a.count < b.count ? a.count : b.count;
+
+    if (a.element.kind == TypeKind::Q8 && b.element.kind == TypeKind::Q8) {
+        // sum((qa - za) * (qb - zb)) expanded so the hot loop stays in int8
+        const int8_t* qa = reinterpret_cast<const int8_t*>(a.data());
+        const int8_t* qb = reinterpret_cast<const int8_t*>(b.data());
+        int64_t za = a.element.zero_point;
+        int64_t zb = b.element.zero_point;
+        int64_t raw = dotQ8(qa, qb, count);
+        if (za != 0) raw -= za * sumQ8(qb, count);
+        if (zb != 0) raw -= zb * sumQ8(qa, count);
+        raw += (int64_t)count * za * zb;
+        return (double)raw * a.element.scale * b.element.scale;
+    }
+
+    if (a.element.kind == TypeKind::F64 || b.element.kind == TypeKind::F64 ||
+        isIntegerKind(a.element.kind) || isIntegerKind(b.element.kind)) {
+        double total = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            total += a.valueAt(i) * b.valueAt(i);
+        }
+        return total;
+    }
+
+    vector<float> fa(a.count), fb(b.count);
+    denseToFloats(a, fa.data());
+    denseToFloats(b, fb.data());
+    double total = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        total += (double)fa[i] * fb[i];
+    }
+    return total;
+}
@@ -0,0 +1,35 @@
+#ifndef DENSE_H
+#define DENSE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "../semantics/types.h"
+
+// Packed storage for lists of numbers. Elements are kept at their declared
+// width (2 bytes for f16/bf16, 1 byte for q8/i8, ...) instead of one Symbol
+// per element. They live in storage, or in memory someone else owns, such
+// as a mapped file, which is never written.
+struct DenseArray {
+    Type element;
+    size_t count = 0;
+    std::vector<unsigned char> storage;
+    // Set when the elements are not in storage
+    const unsigned char* external = nullptr;
+    // Keeps external's memory alive
+    std::shared_ptr<const void> owner;
+
+    const unsigned char* data() const { return external ? external : storage.data(); }
+    double valueAt(size_t index) const;
+};
+
+bool isDenseKind(TypeKind kind);
+size_t denseElementSize(TypeKind kind);
+
+std::shared_ptr<DenseArray> makeDenseArray(const Type& element, const std::vector<double>& values);
+// Appends one element to an array kept in storage
+void appendDense(DenseArray& array, double value);
+void denseToFloats(const DenseArray& array, float* out);
+double denseDot(const DenseArray& a, const DenseArray& b);
+
+#endif
@@ -0,0 +1,155 @@
+#include "device.h"
+#include "thread_pool.h"
+#include <iomanip>
+
+using namespace std;
+
+void Event::wait() {
+    unique_lock<mutex> guard(lock);
+    completed.wait(guard, [this] { return finished.load(); });
+}
+
+shared_ptr<Event> Stream::enqueue(const string& label, Kernel kernel, vector<shared_ptr<Event>> dependencies) {
+    if (last) {
+        dependencies.push_back(last);
+    }
+    last = device.enqueue(label, std::move(kernel), dependencies);
+    return last;
+}
+
+void Stream::synchronize() {
+    if (last) {
+        last->wait();
+    }
+}
+
+CpuDevice::CpuDevice(ThreadPool& pool) : pool(pool), started(chrono::steady_clock::now()) {}
+
+CpuDevice::~CpuDevice() {
+    waitIdle();
+}
+
+shared_ptr<Event> CpuDevice::enqueue(const string& label, Kernel kernel,
+                                     const vector<shared_ptr<Event>>& dependencies) {
+    auto event = make_shared<Event>();
+    event->label = label;
+    event->kernel = std::move(kernel);
+    event->enqueuedAt = chrono::steady_clock::now();
+
+    {
+        lock_guard<mutex> guard(statsLock);
+        inFlight++;
+    }
+
+    // One extra count held while registering, so the kernel cannot start
+    // before every dependency has been looked at
+    event->unresolved = 1;
+    for (const auto& dependency : dependencies) {
+        if (!dependency) continue;
+        lock_guard<mutex> guard(dependency->lock);
+        if (!dependency->finished) {
+            dependency->dependents.push_back(event);
+            lock_guard<mutex> own(event->lock);
+            event->unresolved++;
+        }
+    }
+
+    bool ready;
+    {
+        lock_guard<mutex> guard(event->lock);
+        ready = --event->unresolved == 0;
+    }
+    if (ready) {
+        launch(event);
+    }
+    return event;
+}
+
+void CpuDevice::launch(const shared_ptr<Event>& event) {
+    pool.submit([this, event] { run(event); });
+}
+
+void CpuDevice::run(const shared_ptr<Event>& event) {
+    auto begin = chrono::steady_clock::now();
+    bool failed;
+    {
+        lock_guard<mutex> guard(statsLock);
+        running++;
+        if (running > peakRunning) peakRunning = running;
+        totalQueuedSeconds += chrono::duration<double>(begin - event->enqueuedAt).count();
+        failed = error != nullptr;
+    }
+
+    // Later kernels may depend on what a failed one left unwritten
+    if (!failed) {
+        try {
+            event->kernel();
+        } catch (...) {
+            lock_guard<mutex> guard(statsLock);
+            if (!error) error = current_exception();
+        }
+    }
+    event->kernel = nullptr;
+
+    auto end = chrono::steady_clock::now();
+
+    vector<shared_ptr<Event>> dependents;
+    {
+        lock_guard<mutex> guard(event->lock);
+        event->finished = true;
+        dependents.swap(event->dependents);
+    }
+    event->completed.notify_all();
+
+    for (const auto& dependent : dependents) {
+        bool ready;
+        {
+            lock_guard<mutex> guard(dependent->lock);
+            ready = --dependent->unresolved == 0;
+        }
+        if (ready) {
+            launch(dependent);
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(statsLock);
+        running--;
+        kernelsRun++;
+        totalRunSeconds += chrono::duration<double>(end - begin).count();
+        if (--inFlight == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+void CpuDevice::synchronize() {
+    waitIdle();
+    exception_ptr thrown;
+    {
+        // Reported once; kernels enqueued after this run again
+        lock_guard<mutex> guard(statsLock);
+        thrown = std::move(error);
+        error = nullptr;
+    }
+    if (thrown) {
+        rethrow_exception(thrown);
+    }
+}
+
+void CpuDevice::waitIdle() {
+    unique_lock<mutex> guard(statsLock);
+    idle.wait(guard, [this] { return inFlight == 0; });
+}
+
+void CpuDevice::printStats(ostream& out) const {
+    lock_guard<mutex> guard(statsLock);
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    out << "device " << name() << ": " << kernelsRun << " kernels on " << pool.size() << " threads\n"
+        << fixed << setprecision(3)
+        << "  kernel time " << totalRunSeconds << "s, wall " << wall << "s, average parallelism "
+        << (wall > 0 ? totalRunSeconds / wall : 0.0) << "\n"
+        << "  peak concurrent kernels " << peakRunning << ", average queue wait "
+        << (kernelsRun ? 1000.0 * totalQueuedSeconds / kernelsRun : 0.0) << "ms\n"
+        << defaultfloat;
+}
@@ -0,0 +1,101 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+using Kernel = std::function<void()>;
+
+// Completion handle for an enqueued kernel. Other kernels list it as a
+// dependency; the host can wait on it.
+class Event {
+public:
+    bool done() const { return finished; }
+    void wait();
+
+private:
+    friend class CpuDevice;
+
+    std::string label;
+    Kernel kernel;
+    std::atomic<bool> finished{false};
+    // Guards dependents, unresolved and the wait condition
+    std::mutex lock;
+    std::condition_variable completed;
+    std::vector<std::shared_ptr<Event>> dependents;
+    size_t unresolved = 0;
+    std::chrono::steady_clock::time_point enqueuedAt;
+};
+
+// A device executes kernels asynchronously and out of order; a kernel starts
+// once every event it depends on has completed.
+class Device {
+public:
+    virtual ~Device() = default;
+
+    virtual std::string name() const = 0;
+    virtual std::shared_ptr<Event> enqueue(const std::string& label, Kernel kernel,
+                                           const std::vector<std::shared_ptr<Event>>& dependencies) = 0;
+    // Blocks until every enqueued kernel has finished, then rethrows the
+    // first exception a kernel threw since the last synchronize, if any
+    virtual void synchronize() = 0;
+    virtual void printStats(std::ostream& out) const = 0;
+};
+
+// An in-order queue on a device: each kernel also waits for the previous one
+class Stream {
+public:
+    explicit Stream(Device& device) : device(device) {}
+
+    std::shared_ptr<Event> enqueue(const std::string& label, Kernel kernel,
+                                   std::vector<std::shared_ptr<Event>> dependencies = {});
+    void synchronize();
+
+private:
+    Device& device;
+    std::shared_ptr<Event> last;
+};
+
+// Reference device that runs kernels on a host thread pool. Once a kernel
+// has thrown, the kernels still queued are skipped.
+class CpuDevice : public Device {
+public:
+    explicit CpuDevice(ThreadPool& pool);
+    ~CpuDevice() override;
+
+    std::string name() const override { return "cpu"; }
+    std::shared_ptr<Event> enqueue(const std::string& label, Kernel kernel,
+                                   const std::vector<std::shared_ptr<Event>>& dependencies) override;
+    void synchronize() override;
+    void printStats(std::ostream& out) const override;
+
+private:
+    ThreadPool& pool;
+    std::chrono::steady_clock::time_point started;
+
+    mutable std::mutex statsLock;
+    std::condition_variable idle;
+    size_t inFlight = 0;
+    size_t running = 0;
+    size_t peakRunning = 0;
+    size_t kernelsRun = 0;
+    double totalQueuedSeconds = 0.0;
+    double totalRunSeconds = 0.0;
+    std::exception_ptr error;
+
+    void waitIdle();
+    void launch(const std::shared_ptr<Event>& event);
+    void run(const std::shared_ptr<Event>& event);
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 64-bit hash of a byte string: 8 bytes at a time through a multiply and
+// shift, then a final mix so every input bit reaches the low and high bits.
+// Short tails are read with overlapping fixed-size loads rather than a
+// byte loop or a variable-length copy.
+inline uint64_t hashKey(const char* data, size_t size) {
+    const uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+    uint64_t hash = 0x2545f4914f6cdd1dull ^ (size * kMultiplier);
+    auto mix = [&](uint64_t word) {
+        hash = (hash ^ word) * kMultiplier;
+        hash ^= hash >> 29;
+    };
+    size_t rest = size;
+    while (rest >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        mix(word);
+        data += 8;
+        rest -= 8;
+    }
+    if (rest > 0) {
+        uint64_t word;
+        if (size >= 8) {
+            // The last 8 bytes, overlapping ones already mixed in
+            memcpy(&word, data + rest - 8, 8);
+        } else if (rest >= 4) {
+            uint32_t first, last;
+            memcpy(&first, data, 4);
+            memcpy(&last, data + rest - 4, 4);
+            word = ((uint64_t)first << 32) | last;
+        } else {
+            word = ((uint64_t)(unsigned char)data[0] << 16) | ((uint64_t)(unsigned char)data[rest / 2] << 8) |
+                   (unsigned char)data[rest - 1];
+        }
+        mix(word);
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Open-addressing hash table from byte strings to V, laid out like a
+// SwissTable. Every slot has a control byte holding 7 bits of its key's
+// hash, or marking it empty or erased. A lookup compares a group of 16
+// control bytes at once (one SSE2 compare where available) and only looks
+// at the keys whose byte matches, so it mostly reads one line of control
+// bytes, one slot and one key.
+//
+// Keys are copied back to back into one arena rather than allocated one by
+// one, and slots point straight at them. Values are kept in insertion
+// order, which is the order forEach walks them in; erasing leaves a hole
+// that the next rehash closes.
+template <typename V>
+class HashMap {
+public:
+    size_t size() const { return live; }
+
+    const V* find(std::string_view key) const {
+        size_t slot = findSlot(key, hashKey(key.data(), key.size()));
+        return slot == kNotFound ? nullptr : &values[slots[slot].entry];
+    }
+    V* find(std::string_view key) {
+        size_t slot = findSlot(key, hashKey(key.data(), key.size()));
+        return slot == kNotFound ? nullptr : &values[slots[slot].entry];
+    }
+
+    // Inserts key, or overwrites its value if already present
+    void set(std::string_view key, V value) {
+        uint64_t hash = hashKey(key.data(), key.size());
+        size_t slot = findSlot(key, hash);
+        if (slot != kNotFound) {
+            values[slots[slot].entry] = std::move(value);
+            return;
+        }
+        // Also rehashes once erased entries pile up, since a key erased and
+        // set again takes a fresh entry but may reuse its old slot
+        if (used + 1 > capacity() / 8 * 7 || entries.size() >= capacity()) {
+            rehash(live + 1);
+        }
+        slot = freeSlot(hash);
+        if (control[slot] == kEmpty) used++;
+        control[slot] = (int8_t)(hash & 0x7f);
+        slots[slot] = Slot{arena.size(), (uint32_t)key.size(), (uint32_t)entries.size()};
+        entries.push_back(Entry{arena.size(), (uint32_t)key.size()});
+        arena.append(key.data(), key.size());
+        values.push_back(std::move(value));
+        live++;
+    }
+
+    // False if key was not present
+    bool erase(std::string_view key) {
+        size_t slot = findSlot(key, hashKey(key.data(), key.size()));
+        if (slot == kNotFound) return false;
+        uint32_t entry = slots[slot].entry;
+        entries[entry].length = kErased;
+        values[entry] = V();
+        // Still counted in used: probes for other keys must go past it
+        control[slot] = kDeleted;
+        live--;
+        return true;
+    }
+
+    // Room for count keys without rehashing
+    void reserve(size_t count) {
+        if (count > capacity() / 8 * 7) rehash(count);
+    }
+
+    // Calls visit(key, value) for every key, in insertion order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].length == kErased) continue;
+            visit(std::string_view(arena.data() + entries[i].offset, entries[i].length), values[i]);
+        }
+    }
+
+private:
+    static constexpr size_t kGroup = 16;
+    static constexpr size_t kNotFound = (size_t)-1;
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+    static constexpr uint32_t kErased = UINT32_MAX;
+
+    // Where a full slot's key is, and which entry it is
+    struct Slot {
+        size_t offset;
+        uint32_t length;
+        uint32_t entry;
+    };
+    // Keys in insertion order, parallel to values
+    struct Entry {
+        size_t offset;
+        uint32_t length;
+    };
+
+    std::vector<int8_t> control;
+    std::vector<Slot> slots;
+    std::vector<Entry> entries;
+    std::vector<V> values;
+    std::string arena;
+    size_t live = 0;
+    // Slots not empty: full or erased
+    size_t used = 0;
+    size_t capacity() const { return control.size(); }
+
+    // Bit i set where group[i] == byte
+    static uint32_t match(const int8_t* group, int8_t byte) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte)));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < kGroup; ++i) bits |= (uint32_t)(group[i] == byte) << i;
+        return bits;
+#endif
+    }
+
+    // Bit i set where group[i] is empty or erased, the only negative bytes
+    static uint32_t matchFree(const int8_t* group) {
+#if defined(__SSE2__)
+        return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group)));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < kGroup; ++i) bits |= (uint32_t)(group[i] < 0) << i;
+        return bits;
+#endif
+    }
+
+    // Groups are visited in triangular steps, which reach every group of a
+    // power-of-two table
+    size_t firstGroup(uint64_t hash) const { return (size_t)(hash >> 7) & (capacity() / kGroup - 1); }
+
+    size_t findSlot(std::string_view key, uint64_t hash) const {
+        if (control.empty()) return kNotFound;
+        size_t groupMask = capacity() / kGroup - 1;
+        int8_t tag = (int8_t)(hash & 0x7f);
+        size_t group = firstGroup(hash);
+        for (size_t step = 1;; ++step) {
+            const int8_t* bytes = control.data() + group * kGroup;
+            for (uint32_t bits = match(bytes, tag); bits; bits &= bits - 1) {
+                size_t slot = group * kGroup + (size_t)__builtin_ctz(bits);
+                const Slot& candidate = slots[slot];
+                if (candidate.length == key.size() &&
+                    memcmp(arena.data() + candidate.offset, key.data(), key.size()) == 0) {
+                    return slot;
+                }
+            }
+            // The key would have been placed no further than the first
+            // empty slot on its path
+            if (match(bytes, kEmpty)) return kNotFound;
+            group = (group + step) & groupMask;
+        }
+    }
+
+    size_t freeSlot(uint64_t hash) const {
+        size_t groupMask = capacity() / kGroup - 1;
+        size_t group = firstGroup(hash);
+        for (size_t step = 1;; ++step) {
+            uint32_t bits = matchFree(control.data() + group * kGroup);
+            if (bits) return group * kGroup + (size_t)__builtin_ctz(bits);
+            group = (group + step) & groupMask;
+        }
+    }
+
+    // Rebuilds the table with room for twice count keys, dropping erased
+    // entries and their key bytes
+    void rehash(size_t count) {
+        size_t newCapacity = kGroup;
+        while (newCapacity / 8 * 7 < count * 2) newCapacity *= 2;
+
+        std::vector<Entry> oldEntries;
+        std::vector<V> oldValues;
+        std::string oldArena;
+        oldEntries.swap(entries);
+        oldValues.swap(values);
+        oldArena.swap(arena);
+        control.assign(newCapacity, kEmpty);
+        slots.assign(newCapacity, Slot{0, 0, 0});
+        entries.reserve(count);
+        values.reserve(count);
+        arena.reserve(oldArena.size());
+        used = 0;
+
+        for (size_t i = 0; i < oldEntries.size(); ++i) {
+            const Entry& old = oldEntries[i];
+            if (old.length == kErased) continue;
+            const char* key = oldArena.data() + old.offset;
+            uint64_t hash = hashKey(key, old.length);
+            size_t slot = freeSlot(hash);
+            control[slot] = (int8_t)(hash & 0x7f);
+            slots[slot] = Slot{arena.size(), old.length, (uint32_t)entries.size()};
+            entries.push_back(Entry{arena.size(), old.length});
+            arena.append(key, old.length);
+            values.push_back(std::move(oldValues[i]));
+            used++;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "mapped_file.h"
+#include "dense.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char kTensorMagic[4] = {'G', 'T', 'N', 'S'};
+// Past any shape a list index can reach
+static const uint32_t kMaxRank = 32;
+
+shared_ptr<const MappedFile> MappedFile::open(const string& path, string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "could not open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        error = path + " is not a regular file";
+        close(fd);
+        return nullptr;
+    }
+    shared_ptr<MappedFile> file(new MappedFile);
+    // An empty file can't be mapped and needs no mapping
+    if (info.st_size > 0) {
+        void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            error = "could not map " + path + ": " + strerror(errno);
+            close(fd);
+            return nullptr;
+        }
+        // Data files are mostly scanned front to back
+        madvise(mapped, (size_t)info.st_size, MADV_SEQUENTIAL);
+        file->bytes = static_cast<const unsigned char*>(mapped);
+        file->length = (size_t)info.st_size;
+    }
+    close(fd);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+}
+
+bool hasTensorHeader(const unsigned char* data, size_t size) {
+    return size >= sizeof(kTensorMagic) && memcmp(data, kTensorMagic, sizeof(kTensorMagic)) == 0;
+}
+
+bool readTensorHeader(const unsigned char* data, size_t size, TensorHeader& header, string& error) {
+    if (size < 16 || !hasTensorHeader(data, size)) {
+        error = "the tensor header is truncated";
+        return false;
+    }
+    string name(reinterpret_cast<const char*>(data) + 4, 4);
+    name.resize(strnlen(name.c_str(), 4));
+    if (!elementTypeNamed(name, header.element)) {
+        error = "the tensor header names an unknown element type '" + name + "'";
+        return false;
+    }
+    uint32_t rank;
+    memcpy(&rank, data + 8, sizeof(rank));
+    if (rank > kMaxRank || size < 16 + (size_t)rank * 8) {
+        error = "the tensor header is truncated";
+        return false;
+    }
+    header.shape.resize(rank);
+    uint64_t count = 1;
+    for (uint32_t i = 0; i < rank; ++i) {
+        memcpy(&header.shape[i], data + 16 + i * 8, sizeof(uint64_t));
+        if (header.shape[i] != 0 && count > UINT64_MAX / header.shape[i]) {
+            error = "the tensor shape overflows";
+            return false;
+        }
+        count *= header.shape[i];
+    }
+    header.dataOffset = 16 + (size_t)rank * 8;
+    size_t elementSize = denseElementSize(header.element.kind);
+    if (count > (size - header.dataOffset) / elementSize ||
+        count * elementSize != size - header.dataOffset) {
+        error = "the file holds " + to_string(size - header.dataOffset) + " bytes of elements, the header " +
+                to_string(count) + " elements of " + to_string(elementSize) + " bytes";
+        return false;
+    }
+    return true;
+}
+
+bool elementTypeNamed(const string& name, Type& type) {
+    static const pair<const char*, TypeKind> kinds[] = {
+        {"i8", TypeKind::I8},   {"i16", TypeKind::I16}, {"i32", TypeKind::I32},   {"i64", TypeKind::I64},
+        {"f16", TypeKind::F16}, {"bf16", TypeKind::BF16}, {"f32", TypeKind::F32}, {"f64", TypeKind::F64}};
+    for (const auto& kind : kinds) {
+        if (name == kind.first) {
+            type = Type{kind.second};
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "../semantics/types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A file mapped read-only into memory and unmapped with its last
+// reference. Lists loaded from it point straight into the mapping, so
+// pages are read from disk only when touched and never copied.
+class MappedFile {
+public:
+    // Null with a message in error if the file can't be opened or mapped
+    static std::shared_ptr<const MappedFile> open(const std::string& path, std::string& error);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile() = default;
+
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Tensor files are a header followed by the elements, little-endian:
+//
+//   "GTNS"          magic
+//   char[4]         element type, e.g. "f32", "i8" or "bf16", NUL padded
+//   u32             rank
+//   u32             0
+//   u64[rank]       dimensions, outermost first
+//   elements        product of the dimensions, row-major
+//
+// The header is a multiple of 8 bytes long, so mapped elements stay
+// aligned. Files without the magic are raw arrays of elements.
+struct TensorHeader {
+    Type element;
+    std::vector<uint64_t> shape;
+    // Where the elements start
+    size_t dataOffset = 0;
+};
+
+bool hasTensorHeader(const unsigned char* data, size_t size);
+// False with a message in error if the header is malformed or the file
+// doesn't hold exactly the elements it announces
+bool readTensorHeader(const unsigned char* data, size_t size, TensorHeader& header, std::string& error);
+
+// The element types a data file can hold: i8 to i64, f16, bf16, f32, f64
+bool elementTypeNamed(const std::string& name, Type& type);
+
+#endif
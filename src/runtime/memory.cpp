@@ -0,0 +1,14 @@
+#include "memory.h"
+
+using namespace std;
+
+atomic<bool> allocationCounting{false};
+atomic<uint64_t> allocationBytes{0};
+
+void countAllocations(bool on) {
+    allocationCounting.store(on, memory_order_relaxed);
+}
+
+uint64_t allocatedBytes() {
+    return allocationBytes.load(memory_order_relaxed);
+}
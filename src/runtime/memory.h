@@ -0,0 +1,20 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <atomic>
+#include <cstdint>
+
+// Byte counts of heap allocations made through operator new, on any
+// thread. Counting is off until enabled, and costs one flag test per
+// allocation while off. Allocations are only seen by executables linking
+// allocation_hooks.cpp, which replaces the global operator new; libexotic
+// leaves its host's allocator alone, so there the count stays 0.
+void countAllocations(bool on);
+// Bytes requested since counting was enabled
+uint64_t allocatedBytes();
+
+// Updated by the replacement operator new
+extern std::atomic<bool> allocationCounting;
+extern std::atomic<uint64_t> allocationBytes;
+
+#endif
@@ -0,0 +1,229 @@
+#include "numeric.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EXOTIC_X86 1
+#endif
+
+using namespace std;
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) {
+        // Inf stays inf, NaN stays a quiet NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+
+    int halfExponent = (int)exponent - 127 + 15;
+    if (halfExponent >= 0x1f) {
+        return sign | 0x7c00; // Overflow to infinity
+    }
+
+    if (halfExponent <= 0) {
+        if (halfExponent < -10) {
+            return sign; // Too small even for a subnormal
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - halfExponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++; // A carry into the exponent correctly rounds up to the next binade or inf
+    }
+    return sign | half;
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) {
+        float magnitude = mantissa * (1.0f / 16777216.0f); // mantissa * 2^-24
+        return sign ? -magnitude : magnitude;
+    }
+
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+uint16_t floatToBFloat16(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        return (uint16_t)((bits >> 16) | 0x40); // Keep NaN quiet after truncation
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+float bfloat16ToFloat(uint16_t value) {
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+int8_t quantizeQ8(float value, float scale, int zeroPoint) {
+    float q = nearbyintf(value / scale) + zeroPoint;
+    if (q < -128.0f) q = -128.0f;
+    if (q > 127.0f) q = 127.0f;
+    return (int8_t)q;
+}
+
+float dequantizeQ8(int8_t value, float scale, int zeroPoint) {
+    return (float)(value - zeroPoint) * scale;
+}
+
+#ifdef EXOTIC_X86
+static bool hasF16C() {
+    static const bool supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return supported;
+}
+
+static bool hasAVX2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+__attribute__((target("avx,f16c")))
+static size_t convertFloatToHalfF16C(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 values = _mm256_loadu_ps(src + i);
+        __m128i halves = _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i*)(dst + i), halves);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static size_t convertHalfToFloatF16C(const uint16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i halves = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(halves));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int64_t dotQ8AVX2(const int8_t* a, const int8_t* b, size_t count, size_t& done) {
+    int64_t total = 0;
+    size_t i = 0;
+    while (i + 16 <= count) {
+        // Flush the 32-bit lanes before they can overflow
+        size_t blockEnd = i + 65536;
+        if (blockEnd > count) blockEnd = count;
+
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 16 <= blockEnd; i += 16) {
+            __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+            __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+        }
+
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int lane = 0; lane < 8; ++lane) {
+            total += lanes[lane];
+        }
+    }
+    done = i;
+    return total;
+}
+#endif
+
+void convertFloatToHalf(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+#ifdef EXOTIC_X86
+    if (hasF16C()) {
+        i = convertFloatToHalfF16C(src, dst, count);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+void convertHalfToFloat(const uint16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#ifdef EXOTIC_X86
+    if (hasF16C()) {
+        i = convertHalfToFloatF16C(src, dst, count);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = halfToFloat(src[i]);
+    }
+}
+
+void convertFloatToBFloat16(const float* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = floatToBFloat16(src[i]);
+    }
+}
+
+void convertBFloat16ToFloat(const uint16_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = bfloat16ToFloat(src[i]);
+    }
+}
+
+void quantizeQ8(const float* src, int8_t* dst, size_t count, float scale, int zeroPoint) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = quantizeQ8(src[i], scale, zeroPoint);
+    }
+}
+
+void dequantizeQ8(const int8_t* src, float* dst, size_t count, float scale, int zeroPoint) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = (float)(src[i] - zeroPoint) * scale;
+    }
+}
+
+int64_t dotQ8(const int8_t* a, const int8_t* b, size_t count) {
+    int64_t total = 0;
+    size_t i = 0;
+#ifdef EXOTIC_X86
+    if (hasAVX2()) {
+        total = dotQ8AVX2(a, b, count, i);
+    }
+#endif
+    for (; i < count; ++i) {
+        total += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return total;
+}
+
+int64_t sumQ8(const int8_t* values, size_t count) {
+    int64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += values[i];
+    }
+    return total;
+}
@@ -0,0 +1,30 @@
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Scalar conversions between f32 and the 16-bit storage formats.
+// All conversions round to nearest even.
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+uint16_t floatToBFloat16(float value);
+float bfloat16ToFloat(uint16_t value);
+
+// Affine int8 quantization: real = (q - zero_point) * scale
+int8_t quantizeQ8(float value, float scale, int zeroPoint);
+float dequantizeQ8(int8_t value, float scale, int zeroPoint);
+
+// Bulk conversion kernels. The f16 kernels use F16C when the CPU supports it.
+void convertFloatToHalf(const float* src, uint16_t* dst, size_t count);
+void convertHalfToFloat(const uint16_t* src, float* dst, size_t count);
+void convertFloatToBFloat16(const float* src, uint16_t* dst, size_t count);
+void convertBFloat16ToFloat(const uint16_t* src, float* dst, size_t count);
+void quantizeQ8(const float* src, int8_t* dst, size_t count, float scale, int zeroPoint);
+void dequantizeQ8(const int8_t* src, float* dst, size_t count, float scale, int zeroPoint);
+
+// Integer dot product of two int8 vectors (AVX2 when available)
+int64_t dotQ8(const int8_t* a, const int8_t* b, size_t count);
+int64_t sumQ8(const int8_t* values, size_t count);
+
+#endif
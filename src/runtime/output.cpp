@@ -0,0 +1,90 @@
+#include "output.h"
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+OutputBuffer::OutputBuffer(streambuf* target, size_t capacity) : target(target), buffer(capacity) {
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+void OutputBuffer::setTarget(streambuf* newTarget) {
+    flush();
+    target = newTarget;
+}
+
+void OutputBuffer::write(const char* text, size_t length) {
+    if (length > (size_t)(epptr() - pptr())) {
+        flush();
+        // Too big to be worth copying
+        if (length >= buffer.size()) {
+            target->sputn(text, length);
+            return;
+        }
+    }
+    memcpy(pptr(), text, length);
+    pbump((int)length);
+}
+
+void OutputBuffer::writeInt(long long value) {
+    // 20 digits and a sign
+    char* begin = reserve(21);
+    char* end = to_chars(begin, epptr(), value).ptr;
+    pbump((int)(end - begin));
+}
+
+void OutputBuffer::writeDouble(double value) {
+    // Sign, six digits, point and a four-digit exponent
+    char* begin = reserve(16);
+    char* end = to_chars(begin, epptr(), value, chars_format::general, 6).ptr;
+    pbump((int)(end - begin));
+}
+
+void OutputBuffer::flush() {
+    size_t length = pptr() - pbase();
+    if (length > 0) {
+        target->sputn(pbase(), length);
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    target->pubsync();
+}
+
+int OutputBuffer::overflow(int c) {
+    flush();
+    if (c != traits_type::eof()) {
+        write((char)c);
+    }
+    return traits_type::not_eof(c);
+}
+
+streamsize OutputBuffer::xsputn(const char* text, streamsize length) {
+    write(text, (size_t)length);
+    if (lineMode && memchr(text, '\n', (size_t)length)) flush();
+    return length;
+}
+
+int OutputBuffer::sync() {
+    flush();
+    return 0;
+}
+
+OutputBuffer& standardOutput() {
+    static OutputBuffer output(cout.rdbuf());
+    static ostream tied(&output);
+    static bool ready = [] {
+        output.setLineMode(isatty(STDOUT_FILENO));
+        cerr.tie(&tied);
+        // tied is destroyed at exit before cerr is
+        atexit([] { cerr.tie(&cout); });
+        return true;
+    }();
+    (void)ready;
+    return output;
+}
@@ -0,0 +1,83 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Buffered writer for program output. Text collects in one large buffer and
+// reaches the target stream buffer only when it fills, on flush(), or at the
+// end of every line when line mode is on, so printing costs no system call
+// per statement. Numbers are formatted with std::to_chars straight into the
+// buffer. It is itself a streambuf, so an ostream can be put in front of it.
+// Not synchronized: callers must not write from two threads at once.
+class OutputBuffer : public std::streambuf {
+public:
+    explicit OutputBuffer(std::streambuf* target, size_t capacity = 64 * 1024);
+    ~OutputBuffer() override;
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    // Flushes what was written so far to the old target first
+    void setTarget(std::streambuf* target);
+    void setLineMode(bool on) { lineMode = on; }
+
+    void write(const char* text, size_t length);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    void write(char c) {
+        if (pptr() == epptr()) flush();
+        *pptr() = c;
+        pbump(1);
+    }
+    void writeInt(long long value);
+    // Same digits as an ostream with default formatting, i.e. "%g"
+    void writeDouble(double value);
+    // Ends a line; flushes in line mode
+    void newline() {
+        write('\n');
+        if (lineMode) flush();
+    }
+    void flush();
+
+protected:
+    int overflow(int c) override;
+    std::streamsize xsputn(const char* text, std::streamsize length) override;
+    int sync() override;
+
+private:
+    std::streambuf* target;
+    std::vector<char> buffer;
+    bool lineMode = false;
+
+    // Room for at least `bytes` more characters
+    char* reserve(size_t bytes) {
+        if ((size_t)(epptr() - pptr()) < bytes) flush();
+        return pptr();
+    }
+};
+
+// Stream buffer that keeps everything written to it, for collecting what
+// an OutputBuffer flushes as a string
+class StringSink : public std::streambuf {
+public:
+    std::string text;
+
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) text += (char)c;
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char* data, std::streamsize length) override {
+        text.append(data, (size_t)length);
+        return length;
+    }
+};
+
+// Program output on stdout, set up on first use: line buffered when stdout
+// is a terminal, flushed at exit and whenever std::cerr is written to, so
+// error messages stay in order with the output before them.
+OutputBuffer& standardOutput();
+
+#endif
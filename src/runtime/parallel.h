@@ -0,0 +1,67 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Lists shorter than this are processed serially; splitting them costs more
+// than it saves.
+const size_t kParallelThreshold = 8192;
+
+// Whether forEachChunk(count, ...) splits the work between threads
+inline bool runsInParallel(size_t count) {
+    return count >= kParallelThreshold && configuredThreadCount() > 1;
+}
+
+// Runs body(begin, end) over [0, count), in parallel on the default pool
+// for large inputs and inline for small ones.
+inline void forEachChunk(size_t count, const std::function<void(size_t, size_t)>& body) {
+    if (!runsInParallel(count)) {
+        body(0, count);
+        return;
+    }
+    ThreadPool& pool = defaultThreadPool();
+    size_t grain = std::max(kParallelThreshold / 4, count / (pool.size() * 4));
+    pool.parallelFor(count, grain, body);
+}
+
+// Sorts chunks in parallel, then merges neighbouring runs pairwise until one
+// run remains.
+template <typename T, typename Compare>
+void parallelSort(std::vector<T>& values, Compare less) {
+    size_t count = values.size();
+    if (count < kParallelThreshold || configuredThreadCount() <= 1) {
+        std::stable_sort(values.begin(), values.end(), less);
+        return;
+    }
+
+    ThreadPool& pool = defaultThreadPool();
+    size_t runs = std::min(pool.size() * 2, count / (kParallelThreshold / 4));
+    if (runs < 2) runs = 2;
+    size_t runSize = (count + runs - 1) / runs;
+
+    pool.parallelFor(runs, 1, [&](size_t first, size_t last) {
+        for (size_t run = first; run < last; ++run) {
+            size_t begin = std::min(count, run * runSize);
+            size_t end = std::min(count, begin + runSize);
+            std::stable_sort(values.begin() + begin, values.begin() + end, less);
+        }
+    });
+
+    for (size_t width = runSize; width < count; width *= 2) {
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, 1, [&](size_t first, size_t last) {
+            for (size_t pair = first; pair < last; ++pair) {
+                size_t begin = pair * 2 * width;
+                size_t middle = std::min(count, begin + width);
+                size_t end = std::min(count, begin + 2 * width);
+                std::inplace_merge(values.begin() + begin, values.begin() + middle,
+                                   values.begin() + end, less);
+            }
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <cstddef>
+
+// Arithmetic sequence produced by range(); elements are computed on demand
+struct LazyRange {
+    long long start = 0;
+    long long stop = 0;
+    long long step = 1;
+
+    size_t size() const {
+        if (step > 0) {
+            return start < stop ? (size_t)((stop - start + step - 1) / step) : 0;
+        }
+        return start > stop ? (size_t)((start - stop - step - 1) / -step) : 0;
+    }
+
+    long long at(size_t index) const { return start + (long long)index * step; }
+
+    long long sum() const {
+        long long count = (long long)size();
+        return count * start + step * (count * (count - 1) / 2);
+    }
+};
+
+#endif
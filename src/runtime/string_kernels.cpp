@@ -0,0 +1,166 @@
+#include "string_kernels.h"
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EXOTIC_X86 1
+#endif
+
+using namespace std;
+
+#ifdef EXOTIC_X86
+static bool hasAVX2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Searches the candidate positions whose last needle byte still lies within
+// a full 32-byte block, and sets done to the first position not searched
+__attribute__((target("avx2")))
+static size_t findAVX2(const char* text, size_t size, string_view needle, size_t from, size_t& done) {
+    size_t length = needle.size();
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[length - 1]);
+    size_t i = from;
+    for (; i + length - 1 + 32 <= size; i += 32) {
+        __m256i starts = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i ends = _mm256_loadu_si256((const __m256i*)(text + i + length - 1));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(starts, first), _mm256_cmpeq_epi8(ends, last)));
+        for (; bits; bits &= bits - 1) {
+            size_t at = i + (size_t)__builtin_ctz(bits);
+            if (memcmp(text + at + 1, needle.data() + 1, length - 2) == 0) return at;
+        }
+    }
+    done = i;
+    return string_view::npos;
+}
+
+// Bytes in [low, high] get bit 5 flipped, which swaps an ASCII letter's case
+__attribute__((target("avx2")))
+static size_t flipCaseAVX2(const char* src, char* dst, size_t count, char low, char high) {
+    __m256i below = _mm256_set1_epi8((char)(low - 1));
+    __m256i above = _mm256_set1_epi8((char)(high + 1));
+    __m256i flip = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(src + i));
+        // Signed compares, so bytes from 0x80 up never count as letters
+        __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, below), _mm256_cmpgt_epi8(above, bytes));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(bytes, _mm256_and_si256(letters, flip)));
+    }
+    return i;
+}
+#endif
+
+#if defined(__SSE2__)
+static size_t findSSE2(const char* text, size_t size, string_view needle, size_t from, size_t& done) {
+    size_t length = needle.size();
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[length - 1]);
+    size_t i = from;
+    for (; i + length - 1 + 16 <= size; i += 16) {
+        __m128i starts = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i ends = _mm_loadu_si128((const __m128i*)(text + i + length - 1));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, last)));
+        for (; bits; bits &= bits - 1) {
+            size_t at = i + (size_t)__builtin_ctz(bits);
+            if (memcmp(text + at + 1, needle.data() + 1, length - 2) == 0) return at;
+        }
+    }
+    done = i;
+    return string_view::npos;
+}
+
+static size_t flipCaseSSE2(const char* src, char* dst, size_t count, char low, char high) {
+    __m128i below = _mm_set1_epi8((char)(low - 1));
+    __m128i above = _mm_set1_epi8((char)(high + 1));
+    __m128i flip = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(bytes, below), _mm_cmpgt_epi8(above, bytes));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(bytes, _mm_and_si128(letters, flip)));
+    }
+    return i;
+}
+#endif
+
+size_t findText(string_view text, string_view needle, size_t from) {
+    if (needle.empty()) return from <= text.size() ? from : string_view::npos;
+    if (from >= text.size() || needle.size() > text.size() - from) return string_view::npos;
+    if (needle.size() == 1) {
+        const void* found = memchr(text.data() + from, needle[0], text.size() - from);
+        return found ? (size_t)((const char*)found - text.data()) : string_view::npos;
+    }
+
+    size_t done = from;
+#ifdef EXOTIC_X86
+    if (hasAVX2()) {
+        size_t at = findAVX2(text.data(), text.size(), needle, from, done);
+        if (at != string_view::npos) return at;
+    }
+#endif
+#if defined(__SSE2__)
+    size_t at = findSSE2(text.data(), text.size(), needle, done, done);
+    if (at != string_view::npos) return at;
+#endif
+    // The last few positions, too close to the end for a full block
+    return text.find(needle, done);
+}
+
+size_t countText(string_view text, string_view needle) {
+    size_t count = 0;
+    for (size_t at = findText(text, needle); at != string_view::npos; at = findText(text, needle, at + needle.size())) {
+        count++;
+    }
+    return count;
+}
+
+string replaceText(string_view text, string_view pattern, string_view replacement) {
+    vector<size_t> matches;
+    for (size_t at = findText(text, pattern); at != string_view::npos;
+         at = findText(text, pattern, at + pattern.size())) {
+        matches.push_back(at);
+    }
+    if (matches.empty()) return string(text);
+
+    string result(text.size() - matches.size() * pattern.size() + matches.size() * replacement.size(), '\0');
+    char* out = &result[0];
+    size_t copied = 0;
+    for (size_t at : matches) {
+        memcpy(out, text.data() + copied, at - copied);
+        out += at - copied;
+        memcpy(out, replacement.data(), replacement.size());
+        out += replacement.size();
+        copied = at + pattern.size();
+    }
+    memcpy(out, text.data() + copied, text.size() - copied);
+    return result;
+}
+
+static void flipCase(const char* src, char* dst, size_t count, char low, char high) {
+    size_t i = 0;
+#ifdef EXOTIC_X86
+    if (hasAVX2()) {
+        i = flipCaseAVX2(src, dst, count, low, high);
+    }
+#endif
+#if defined(__SSE2__)
+    i += flipCaseSSE2(src + i, dst + i, count - i, low, high);
+#endif
+    for (; i < count; ++i) {
+        char c = src[i];
+        dst[i] = c >= low && c <= high ? (char)(c ^ 0x20) : c;
+    }
+}
+
+void asciiUpper(const char* src, char* dst, size_t count) {
+    flipCase(src, dst, count, 'a', 'z');
+}
+
+void asciiLower(const char* src, char* dst, size_t count) {
+    flipCase(src, dst, count, 'A', 'Z');
+}
@@ -0,0 +1,28 @@
+#ifndef STRING_KERNELS_H
+#define STRING_KERNELS_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Search and case mapping behind the string methods. Substring search
+// compares a needle's first and last bytes against 32 (AVX2) or 16 (SSE2)
+// positions at once and only compares the rest of the needle where both
+// match. Case mapping changes ASCII letters only, like ::toupper and
+// ::tolower in the C locale.
+
+// Index of the first occurrence of needle at or after from, or npos. An
+// empty needle is found at from.
+size_t findText(std::string_view text, std::string_view needle, size_t from = 0);
+
+// Non-overlapping occurrences of a non-empty needle
+size_t countText(std::string_view text, std::string_view needle);
+
+// text with every non-overlapping occurrence of a non-empty pattern
+// replaced, left to right. The result is allocated once, at its final size.
+std::string replaceText(std::string_view text, std::string_view pattern, std::string_view replacement);
+
+void asciiUpper(const char* src, char* dst, size_t count);
+void asciiLower(const char* src, char* dst, size_t count);
+
+#endif
@@ -0,0 +1,222 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+
+using namespace std;
+
+// Index of the pool worker running on this thread, or -1 for other threads
+static thread_local long currentWorker = -1;
+
+ThreadPool::ThreadPool(size_t threadCount) : started(chrono::steady_clock::now()) {
+    if (threadCount == 0) threadCount = 1;
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers[i]->thread = thread([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.get_id() == this_thread::get_id()) {
+            worker->thread.detach(); // exit() called from inside a task
+        } else {
+            worker->thread.join();
+        }
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    size_t target = currentWorker >= 0 ? (size_t)currentWorker : nextQueue++ % workers.size();
+    {
+        // Counted before it is queued so pending never underflows when a thief is quick
+        lock_guard<mutex> guard(sleepLock);
+        pending++;
+    }
+    {
+        lock_guard<mutex> guard(workers[target]->lock);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::takeTask(size_t preferred, function<void()>& task, bool& stolen) {
+    {
+        Worker& own = *workers[preferred];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            stolen = false;
+            pending--;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(preferred + offset) % workers.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stolen = true;
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentWorker = (long)index;
+    Worker& self = *workers[index];
+
+    while (true) {
+        function<void()> task;
+        bool stolen = false;
+        if (takeTask(index, task, stolen)) {
+            auto begin = chrono::steady_clock::now();
+            task();
+            auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+            self.busyNanos += elapsed.count();
+            self.executed++;
+            if (stolen) self.stolen++;
+            continue;
+        }
+
+        unique_lock<mutex> guard(sleepLock);
+        wake.wait(guard, [this] { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+// Lets a thread that is waiting for results run queued work instead of blocking
+bool ThreadPool::runOneTask() {
+    size_t preferred = currentWorker >= 0 ? (size_t)currentWorker : 0;
+    function<void()> task;
+    bool stolen = false;
+    if (!takeTask(preferred, task, stolen)) {
+        return false;
+    }
+    if (currentWorker >= 0) {
+        Worker& self = *workers[currentWorker];
+        auto begin = chrono::steady_clock::now();
+        task();
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+        self.busyNanos += elapsed.count();
+        self.executed++;
+        if (stolen) self.stolen++;
+    } else {
+        task();
+    }
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1) {
+        body(0, count);
+        return;
+    }
+    size_t chunkSize = (count + chunks - 1) / chunks;
+
+    // Shared with the tasks so a late notify never touches a finished frame
+    struct Completion {
+        atomic<size_t> remaining;
+        mutex lock;
+        condition_variable done;
+        // The first exception a chunk threw, rethrown to the caller
+        exception_ptr error;
+    };
+    auto completion = make_shared<Completion>();
+    completion->remaining = chunks;
+    auto runChunk = [completion, &body](size_t begin, size_t end) {
+        try {
+            body(begin, end);
+        } catch (...) {
+            lock_guard<mutex> guard(completion->lock);
+            if (!completion->error) completion->error = current_exception();
+        }
+    };
+
+    // The calling thread takes the first chunk itself
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        size_t begin = chunk * chunkSize;
+        size_t end = min(count, begin + chunkSize);
+        submit([completion, runChunk, begin, end] {
+            runChunk(begin, end);
+            if (--completion->remaining == 0) {
+                lock_guard<mutex> guard(completion->lock);
+                completion->done.notify_all();
+            }
+        });
+    }
+    runChunk(0, min(count, chunkSize));
+    completion->remaining--;
+
+    while (completion->remaining > 0) {
+        if (runOneTask()) continue;
+        unique_lock<mutex> guard(completion->lock);
+        completion->done.wait_for(guard, chrono::microseconds(200),
+                                  [&] { return completion->remaining == 0; });
+    }
+    if (completion->error) {
+        rethrow_exception(completion->error);
+    }
+}
+
+void ThreadPool::printStats(ostream& out) const {
+    double lifetime = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    out << "thread pool: " << workers.size() << " workers, " << fixed << setprecision(3)
+        << lifetime << "s lifetime\n";
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const Worker& worker = *workers[i];
+        double busy = worker.busyNanos / 1e9;
+        double utilization = lifetime > 0 ? 100.0 * busy / lifetime : 0.0;
+        out << "  worker " << i << ": " << worker.executed << " tasks (" << worker.stolen
+            << " stolen), busy " << setprecision(3) << busy << "s, utilization "
+            << setprecision(1) << utilization << "%\n";
+    }
+    out << defaultfloat;
+}
+
+static size_t requestedThreads = 0;
+static unique_ptr<ThreadPool> sharedPool;
+static once_flag sharedPoolOnce;
+
+size_t configuredThreadCount() {
+    if (requestedThreads > 0) {
+        return requestedThreads;
+    }
+    if (const char* env = getenv("EXOTIC_THREADS")) {
+        long threads = strtol(env, nullptr, 10);
+        if (threads > 0) return (size_t)threads;
+    }
+    size_t hardware = thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void setConfiguredThreadCount(size_t threads) {
+    requestedThreads = threads;
+}
+
+ThreadPool& defaultThreadPool() {
+    call_once(sharedPoolOnce, [] { sharedPool = make_unique<ThreadPool>(configuredThreadCount()); });
+    return *sharedPool;
+}
+
+bool defaultThreadPoolStarted() {
+    return sharedPool != nullptr;
+}
@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own work
+// from the back and steals from the front of the other deques when idle.
+// Threads waiting on a parallelFor help run queued tasks, so nested parallel
+// calls from inside a task cannot deadlock.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Runs body(begin, end) over [0, count) in chunks of at least `grain`
+    // elements and returns once every chunk has finished. If chunks throw,
+    // the first exception is rethrown then.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    void printStats(std::ostream& out) const;
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<uint64_t> busyNanos{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<bool> stopping{false};
+    std::chrono::steady_clock::time_point started;
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t preferred, std::function<void()>& task, bool& stolen);
+    bool runOneTask();
+};
+
+// Thread count from --threads, then EXOTIC_THREADS, then the hardware
+size_t configuredThreadCount();
+void setConfiguredThreadCount(size_t threads);
+
+// The process-wide pool, created on first use
+ThreadPool& defaultThreadPool();
+bool defaultThreadPoolStarted();
+
+#endif
@@ -0,0 +1,282 @@
+#include "const_eval.h"
+#include "../evaluvator/values.h"
+#include "../util/diagnostics.h"
+
+using namespace std;
+
+// Work one initializer may do before it is taken not to terminate
+static const uint64_t kMaxSteps = 10000000;
+static const size_t kMaxDepth = 10000;
+
+static bool isElementBodyMethod(const Expr* expr) {
+    return expr->kind == ExprKind::MethodCall &&
+           (expr->method_name == "map" || expr->method_name == "filter" || expr->method_name == "reduce");
+}
+
+static bool isElementName(const string& name) {
+    return name == "it" || name == "acc";
+}
+
+// Parameters, lets and loop variables; everything else a function names is global
+static void collectLocals(const vector<unique_ptr<Stmt>>& body, unordered_set<Interned>& names) {
+    for (const auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
+            names.insert(letStmt->name);
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            collectLocals(whileStmt->body, names);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            names.insert(forStmt->var);
+            collectLocals(forStmt->body, names);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            collectLocals(ifStmt->then_body, names);
+            collectLocals(ifStmt->else_body, names);
+        }
+    }
+}
+
+static unique_ptr<Expr> integerLiteral(long long value, int line, int column) {
+    auto expr = make_unique<Expr>(line, column);
+    expr->kind = ExprKind::NumberLiteral;
+    expr->int_value = (int)value;
+    expr->type = i32Type();
+    return expr;
+}
+
+// Expression that evaluates to value again
+static unique_ptr<Expr> literalFor(const Symbol& value, int line, int column) {
+    if (value.type.kind == TypeKind::List && value.range) {
+        // Stays lazy instead of listing every element
+        auto call = make_unique<Expr>(line, column);
+        call->kind = ExprKind::Call;
+        call->name = "range";
+        call->type = value.type;
+        call->args.push_back(integerLiteral(value.range->start, line, column));
+        call->args.push_back(integerLiteral(value.range->stop, line, column));
+        call->args.push_back(integerLiteral(value.range->step, line, column));
+        return call;
+    }
+
+    auto expr = make_unique<Expr>(line, column);
+    expr->type = value.type;
+    if (value.type.kind == TypeKind::List) {
+        expr->kind = ExprKind::ListLiteral;
+        size_t length = listLength(value);
+        expr->elements.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            expr->elements.push_back(literalFor(listElement(value, i), line, column));
+        }
+    } else if (value.type.kind == TypeKind::Map) {
+        expr->kind = ExprKind::MapLiteral;
+        value.map->forEach([&](string_view key, const Symbol& element) {
+            expr->elements.push_back(literalFor(mapKeySymbol(key, *value.type.key), line, column));
+            expr->args.push_back(literalFor(element, line, column));
+        });
+    } else if (value.type.kind == TypeKind::String) {
+        expr->kind = ExprKind::StringLiteral;
+        expr->string_value = value.string_value;
+    } else {
+        expr->kind = ExprKind::NumberLiteral;
+        expr->int_value = value.int_value;
+        expr->double_value = value.double_value;
+    }
+    return expr;
+}
+
+void ConstEvaluator::evaluate(vector<unique_ptr<Stmt>>& program) {
+    // Functions called by an initializer run in frames like any other call
+    for (auto& stmt : program) {
+        if (auto fn = dynamic_cast<FunctionDecl*>(stmt.get())) {
+            frameLayout.layoutFunction(fn);
+        }
+    }
+
+    // In order, so every use of a constant comes after its value is known
+    rewriteBlock(program);
+}
+
+void ConstEvaluator::rewriteBlock(vector<unique_ptr<Stmt>>& body) {
+    for (auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<LetStmt*>(stmt.get())) {
+            rewrite(letStmt->expr, false);
+            if (letStmt->constant) {
+                fold(letStmt);
+            }
+        } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt.get())) {
+            rewrite(printStmt->expr, false);
+        } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt.get())) {
+            rewrite(assignStmt->expr, false);
+        } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt.get())) {
+            rewrite(whileStmt->condition, false);
+            rewriteBlock(whileStmt->body);
+        } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt.get())) {
+            rewrite(forStmt->iterable, false);
+            rewriteBlock(forStmt->body);
+        } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get())) {
+            rewrite(ifStmt->condition, false);
+            rewriteBlock(ifStmt->then_body);
+            rewriteBlock(ifStmt->else_body);
+        } else if (auto returnStmt = dynamic_cast<ReturnStmt*>(stmt.get())) {
+            rewrite(returnStmt->expr, false);
+        } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt.get())) {
+            rewrite(exprStmt->expr, false);
+        } else if (auto fn = dynamic_cast<FunctionDecl*>(stmt.get())) {
+            rewriteBlock(fn->body);
+        }
+    }
+}
+
+void ConstEvaluator::rewrite(unique_ptr<Expr>& expr, bool inElementBody) {
+    if (!expr) return;
+    if (expr->kind == ExprKind::Identifier) {
+        auto found = literals.find(expr->name);
+        if (found != literals.end() && !(inElementBody && isElementName(expr->name))) {
+            int line = expr->line;
+            int column = expr->column;
+            expr = cloneExpr(found->second.get());
+            expr->line = line;
+            expr->column = column;
+        }
+        return;
+    }
+    rewrite(expr->left, inElementBody);
+    rewrite(expr->right, inElementBody);
+    rewrite(expr->start, inElementBody);
+    rewrite(expr->end, inElementBody);
+    for (auto& element : expr->elements) {
+        rewrite(element, inElementBody);
+    }
+    for (size_t i = 0; i < expr->args.size(); ++i) {
+        rewrite(expr->args[i], inElementBody || (i == 0 && isElementBodyMethod(expr.get())));
+    }
+}
+
+void ConstEvaluator::fold(LetStmt* stmt) {
+    // Constants declared since may make a function callable now
+    callable.clear();
+    string reason = whyNotConstant(stmt->expr.get(), {}, false);
+    if (!reason.empty()) {
+        compileError("Semantic Error at line " + to_string(stmt->line) + ", column " + to_string(stmt->column) +
+                     ": const " + stmt->name + " is not compile-time evaluable: its initializer " + reason);
+    }
+
+    // The sandbox binds the converted value among the other constants
+    frameLayout.layoutStmt(stmt);
+    sandbox.setStepLimit(kMaxSteps, kMaxDepth);
+    try {
+        sandbox.execute(stmt);
+    } catch (const StepLimitExceeded& limit) {
+        compileError("Semantic Error at line " + to_string(stmt->line) + ", column " + to_string(stmt->column) +
+                     ": const " + stmt->name + " is not compile-time evaluable: constant evaluation " + limit.reason);
+    }
+    constants.insert(stmt->name);
+    Symbol value = sandbox.global(stmt->slot);
+
+    // The literal may not spell the exact type, e.g. q8 elements come out
+    // dequantized, so the binding converts it back
+    if (stmt->declared_type.kind == TypeKind::Unknown) {
+        stmt->declared_type = value.type;
+    }
+    stmt->expr = literalFor(value, stmt->expr->line, stmt->expr->column);
+    if (value.type.kind != TypeKind::List && value.type.kind != TypeKind::Map) {
+        literals[stmt->name] = cloneExpr(stmt->expr.get());
+    }
+    count++;
+}
+
+string ConstEvaluator::whyNotCallable(const FunctionDecl* fn) {
+    auto found = callable.find(fn);
+    if (found != callable.end()) {
+        return found->second;
+    }
+    // Recursive calls are judged by the rest of the body
+    callable[fn] = "";
+    checked.push_back(fn);
+    depth++;
+
+    unordered_set<Interned> locals;
+    for (const auto& param : fn->params) {
+        locals.insert(param.name);
+    }
+    collectLocals(fn->body, locals);
+    string reason = whyNotConstant(fn->body, locals);
+    callable[fn] = reason;
+
+    depth--;
+    if (depth == 0) {
+        if (!reason.empty()) {
+            // Functions cleared while a caller was assumed callable may
+            // only have passed because of that assumption
+            for (const FunctionDecl* other : checked) {
+                if (callable[other].empty()) callable.erase(other);
+            }
+        }
+        checked.clear();
+    }
+    return reason;
+}
+
+string ConstEvaluator::whyNotConstant(const vector<unique_ptr<Stmt>>& body, const unordered_set<Interned>& locals) {
+    string reason;
+    for (const auto& stmt : body) {
+        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
+            reason = whyNotConstant(letStmt->expr.get(), locals, false);
+        } else if (dynamic_cast<const PrintStmt*>(stmt.get())) {
+            reason = "prints";
+        } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt.get())) {
+            if (!locals.count(assignStmt->name)) {
+                reason = "assigns global " + assignStmt->name;
+            } else {
+                reason = whyNotConstant(assignStmt->expr.get(), locals, false);
+            }
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            reason = whyNotConstant(whileStmt->condition.get(), locals, false);
+            if (reason.empty()) reason = whyNotConstant(whileStmt->body, locals);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            reason = whyNotConstant(forStmt->iterable.get(), locals, false);
+            if (reason.empty()) reason = whyNotConstant(forStmt->body, locals);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            reason = whyNotConstant(ifStmt->condition.get(), locals, false);
+            if (reason.empty()) reason = whyNotConstant(ifStmt->then_body, locals);
+            if (reason.empty()) reason = whyNotConstant(ifStmt->else_body, locals);
+        } else if (auto returnStmt = dynamic_cast<const ReturnStmt*>(stmt.get())) {
+            reason = whyNotConstant(returnStmt->expr.get(), locals, false);
+        } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt.get())) {
+            reason = whyNotConstant(exprStmt->expr.get(), locals, false);
+        }
+        if (!reason.empty()) break;
+    }
+    return reason;
+}
+
+string ConstEvaluator::whyNotConstant(const Expr* expr, const unordered_set<Interned>& locals, bool inElementBody) {
+    if (!expr) return "";
+    if (expr->kind == ExprKind::Identifier) {
+        const string& name = expr->name;
+        if ((inElementBody && isElementName(name)) || locals.count(name) || constants.count(name)) {
+            return "";
+        }
+        return "reads variable " + name;
+    }
+    if (expr->kind == ExprKind::Call && isDataBuiltin(expr->name)) {
+        return "reads a file with " + expr->name;
+    }
+    if (expr->kind == ExprKind::Call && expr->function) {
+        string reason = whyNotCallable(expr->function);
+        if (!reason.empty()) {
+            return "calls " + expr->function->name + ", which " + reason;
+        }
+    }
+
+    string reason = whyNotConstant(expr->left.get(), locals, inElementBody);
+    if (reason.empty()) reason = whyNotConstant(expr->right.get(), locals, inElementBody);
+    if (reason.empty()) reason = whyNotConstant(expr->start.get(), locals, inElementBody);
+    if (reason.empty()) reason = whyNotConstant(expr->end.get(), locals, inElementBody);
+    for (size_t i = 0; reason.empty() && i < expr->elements.size(); ++i) {
+        reason = whyNotConstant(expr->elements[i].get(), locals, inElementBody);
+    }
+    for (size_t i = 0; reason.empty() && i < expr->args.size(); ++i) {
+        bool nested = inElementBody || (i == 0 && isElementBodyMethod(expr));
+        reason = whyNotConstant(expr->args[i].get(), locals, nested);
+    }
+    return reason;
+}
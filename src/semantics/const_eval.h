@@ -0,0 +1,51 @@
+#ifndef CONST_EVAL_H
+#define CONST_EVAL_H
+
+#include "../parser/ast.h"
+#include "frame_layout.h"
+#include "../evaluvator/evaluator.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Runs the initializer of every `const` binding while compiling, on an
+// Evaluator whose only globals are the constants before it, and replaces the
+// initializer with a literal of the result. Later uses of number and string
+// constants become copies of that literal. An initializer may call functions
+// that neither print, assign globals nor read variables; anything else is
+// reported as not compile-time evaluable, as is an initializer that runs too
+// many steps or nests calls too deeply. Must run after SemanticAnalyzer
+// and before the optimizers.
+class ConstEvaluator {
+public:
+    void evaluate(std::vector<std::unique_ptr<Stmt>>& program);
+
+    size_t folded() const { return count; }
+
+private:
+    size_t count = 0;
+    // Resolves functions and const initializers for the sandbox, whose only
+    // globals are the constants folded so far
+    FrameLayout frameLayout;
+    Evaluator sandbox;
+    std::unordered_set<Interned> constants;
+    // Literals substituted for uses of scalar constants
+    std::unordered_map<Interned, std::unique_ptr<Expr>> literals;
+    // Why each function checked so far can't run at compile time, empty if it can
+    std::unordered_map<const FunctionDecl*, std::string> callable;
+    // Functions entered by the outermost whyNotCallable still running
+    std::vector<const FunctionDecl*> checked;
+    size_t depth = 0;
+
+    void rewriteBlock(std::vector<std::unique_ptr<Stmt>>& body);
+    void rewrite(std::unique_ptr<Expr>& expr, bool inElementBody);
+    void fold(LetStmt* stmt);
+    std::string whyNotCallable(const FunctionDecl* fn);
+    std::string whyNotConstant(const std::vector<std::unique_ptr<Stmt>>& body,
+                               const std::unordered_set<Interned>& locals);
+    std::string whyNotConstant(const Expr* expr, const std::unordered_set<Interned>& locals,
+                               bool inElementBody);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "frame_layout.h"
+
+using namespace std;
+
+void FrameLayout::layout(vector<unique_ptr<Stmt>>& program) {
+    for (auto& stmt : program) {
+        if (auto fn = dynamic_cast<FunctionDecl*>(stmt.get())) {
+            layoutFunction(fn);
+        }
+    }
+    // Everything outside functions is global
+    layoutBlock(program);
+}
+
+void FrameLayout::layoutFunction(FunctionDecl* fn) {
+    slots.clear();
+    frameSize = 0;
+    inFunction = true;
+    Storage storage;
+    for (const auto& param : fn->params) {
+        declare(param.name, storage);
+    }
+    layoutBlock(fn->body);
+    fn->frame_size = frameSize;
+    inFunction = false;
+}
+
+int FrameLayout::declare(Interned name, Storage& storage) {
+    if (!inFunction) {
+        storage = Storage::Global;
+        return globalId(name);
+    }
+    storage = Storage::Local;
+    auto found = slots.find(name);
+    if (found != slots.end()) {
+        return found->second;
+    }
+    slots[name] = frameSize;
+    return frameSize++;
+}
+
+int FrameLayout::lookup(Interned name, Storage& storage) {
+    if (elementDepth > 0 && (name == "it" || name == "acc")) {
+        storage = Storage::Element;
+        return name == "it" ? 0 : 1;
+    }
+    if (inFunction) {
+        auto found = slots.find(name);
+        if (found != slots.end()) {
+            storage = Storage::Local;
+            return found->second;
+        }
+    }
+    // A function may read a global declared after it, which takes the same id
+    storage = Storage::Global;
+    return globalId(name);
+}
+
+int FrameLayout::globalId(Interned name) {
+    auto found = globals.find(name);
+    if (found != globals.end()) {
+        return found->second;
+    }
+    int id = (int)globals.size();
+    globals[name] = id;
+    return id;
+}
+
+void FrameLayout::layoutBlock(vector<unique_ptr<Stmt>>& body) {
+    for (auto& stmt : body) {
+        layoutStmt(stmt.get());
+    }
+}
+
+void FrameLayout::layoutStmt(Stmt* stmt) {
+    if (auto letStmt = dynamic_cast<LetStmt*>(stmt)) {
+        // The value is computed before the name is bound, so `let x = x`
+        // may still read a global x
+        layoutExpr(letStmt->expr.get());
+        letStmt->slot = declare(letStmt->name, letStmt->storage);
+    } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt)) {
+        layoutExpr(printStmt->expr.get());
+    } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt)) {
+        layoutExpr(assignStmt->expr.get());
+        assignStmt->slot = lookup(assignStmt->name, assignStmt->storage);
+    } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt)) {
+        layoutExpr(whileStmt->condition.get());
+        layoutBlock(whileStmt->body);
+    } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt)) {
+        layoutExpr(forStmt->iterable.get());
+        forStmt->slot = declare(forStmt->var, forStmt->storage);
+        layoutBlock(forStmt->body);
+    } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt)) {
+        layoutExpr(ifStmt->condition.get());
+        layoutBlock(ifStmt->then_body);
+        layoutBlock(ifStmt->else_body);
+    } else if (auto returnStmt = dynamic_cast<ReturnStmt*>(stmt)) {
+        layoutExpr(returnStmt->expr.get());
+    } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt)) {
+        layoutExpr(exprStmt->expr.get());
+    }
+}
+
+void FrameLayout::layoutExpr(Expr* expr) {
+    if (!expr) return;
+
+    if (expr->kind == ExprKind::Identifier) {
+        expr->slot = lookup(expr->name, expr->storage);
+        return;
+    }
+    layoutExpr(expr->left.get());
+    layoutExpr(expr->right.get());
+    layoutExpr(expr->start.get());
+    layoutExpr(expr->end.get());
+    for (auto& element : expr->elements) {
+        layoutExpr(element.get());
+    }
+
+    bool elementBody = expr->kind == ExprKind::MethodCall &&
+                       (expr->method_name == "map" || expr->method_name == "filter" || expr->method_name == "reduce");
+    for (size_t i = 0; i < expr->args.size(); ++i) {
+        if (elementBody && i == 0) elementDepth++;
+        layoutExpr(expr->args[i].get());
+        if (elementBody && i == 0) elementDepth--;
+    }
+}
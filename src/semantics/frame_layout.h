@@ -0,0 +1,49 @@
+#ifndef FRAME_LAYOUT_H
+#define FRAME_LAYOUT_H
+
+#include "../parser/ast.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Resolves every name to where the evaluator keeps it. Parameters and locals
+// of a function get a fixed slot in its call frame, top-level bindings and
+// whatever a function reads from outside get a global id, and `it`/`acc`
+// inside map/filter/reduce bodies name the element. Identifiers, lets,
+// assignments and loop variables are pointed at the result, so nothing is
+// looked up by name at run time. Runs last, after the optimizers have added
+// their own lets. Global ids persist across calls to layout, so statements
+// laid out one at a time share them.
+class FrameLayout {
+public:
+    void layout(std::vector<std::unique_ptr<Stmt>>& program);
+    void layoutFunction(FunctionDecl* fn);
+    // Lays out a top-level statement on its own
+    void layoutStmt(Stmt* stmt);
+
+    // Gives a global the program reads but never binds its id up front
+    int declareGlobal(Interned name) { return globalId(name); }
+    size_t globalCount() const { return globals.size(); }
+    // Id of a top-level binding, or -1
+    int findGlobal(Interned name) const {
+        auto found = globals.find(name);
+        return found != globals.end() ? found->second : -1;
+    }
+
+private:
+    std::unordered_map<Interned, int> globals;
+    std::unordered_map<Interned, int> slots;
+    int frameSize = 0;
+    // Set while laying out a function body
+    bool inFunction = false;
+    // Inside map/filter/reduce bodies `it` and `acc` name the element
+    int elementDepth = 0;
+
+    int declare(Interned name, Storage& storage);
+    int lookup(Interned name, Storage& storage);
+    int globalId(Interned name);
+    void layoutBlock(std::vector<std::unique_ptr<Stmt>>& body);
+    void layoutExpr(Expr* expr);
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "range_analysis.h"
+#include "semantic.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+using namespace std;
+
+// Runtime integers are held in an int, so anything outside i32 is unproven
+static Interval fitI32(long long lo, long long hi) {
+    if (lo < INT_MIN || hi > INT_MAX) {
+        return Interval::unknown();
+    }
+    return Interval::of(lo, hi);
+}
+
+static Interval hull(const Interval& a, const Interval& b) {
+    if (!a.known || !b.known) {
+        return Interval::unknown();
+    }
+    return Interval::of(min(a.lo, b.lo), max(a.hi, b.hi));
+}
+
+static Interval corners(long long a, long long b, long long c, long long d) {
+    return fitI32(min({a, b, c, d}), max({a, b, c, d}));
+}
+
+static Interval widthRange(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::I8: return Interval::of(-128, 127);
+        case TypeKind::I16: return Interval::of(-32768, 32767);
+        case TypeKind::I32: return Interval::of(INT_MIN, INT_MAX);
+        default: return Interval::unknown();
+    }
+}
+
+static int widthRank(TypeKind kind) {
+    switch (kind) {
+        case TypeKind::I8: return 1;
+        case TypeKind::I16: return 2;
+        case TypeKind::I32: return 3;
+        default: return 4;
+    }
+}
+
+static bool within(const Interval& inner, const Interval& outer) {
+    return inner.known && outer.known && inner.lo >= outer.lo && inner.hi <= outer.hi;
+}
+
+// Narrowest integer kind holding the whole range, or I32 if nothing smaller does
+static TypeKind narrowestKind(const Interval& range) {
+    if (within(range, widthRange(TypeKind::I8))) return TypeKind::I8;
+    if (within(range, widthRange(TypeKind::I16))) return TypeKind::I16;
+    return TypeKind::I32;
+}
+
+static bool isIntegerList(const Type& type) {
+    return type.kind == TypeKind::List && type.element && isIntegerKind(type.element->kind);
+}
+
+static void collectAssignTargets(const vector<unique_ptr<Stmt>>& body, unordered_set<Interned>& names) {
+    for (const auto& stmt : body) {
+        if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt.get())) {
+            names.insert(assignStmt->name);
+        } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt.get())) {
+            collectAssignTargets(whileStmt->body, names);
+        } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt.get())) {
+            collectAssignTargets(forStmt->body, names);
+        } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt.get())) {
+            collectAssignTargets(ifStmt->then_body, names);
+            collectAssignTargets(ifStmt->else_body, names);
+        }
+    }
+}
+
+Interval RangeAnalyzer::visitElementBody(Expr* body, const Interval& element, bool withAccumulator) {
+    // Bodies may refer to outer bindings named it/acc once they return
+    auto restore = [this](const string& name, bool had, const Interval& previous) {
+        if (had) ranges[name] = previous; else ranges.erase(name);
+    };
+    bool hadIt = ranges.count("it") > 0;
+    bool hadAcc = ranges.count("acc") > 0;
+    Interval previousIt = hadIt ? ranges["it"] : Interval::unknown();
+    Interval previousAcc = hadAcc ? ranges["acc"] : Interval::unknown();
+
+    ranges["it"] = element;
+    if (withAccumulator) {
+        ranges["acc"] = Interval::unknown(); // Grows with every step
+    }
+    Interval result = visit(body);
+
+    restore("it", hadIt, previousIt);
+    if (withAccumulator) {
+        restore("acc", hadAcc, previousAcc);
+    }
+    return result;
+}
+
+Interval RangeAnalyzer::visit(Expr* expr) {
+    if (!expr) {
+        return Interval::unknown();
+    }
+
+    switch (expr->kind) {
+        case ExprKind::NumberLiteral:
+            if (isIntegerKind(expr->type.kind)) {
+                return Interval::of(expr->int_value, expr->int_value);
+            }
+            return Interval::unknown();
+
+        case ExprKind::StringLiteral:
+            return Interval::unknown();
+
+        case ExprKind::Identifier: {
+            if (functionWrites.count(expr->name)) {
+                return Interval::unknown(); // Any call may have changed it
+            }
+            auto it = ranges.find(expr->name);
+            return it != ranges.end() ? it->second : Interval::unknown();
+        }
+
+        case ExprKind::Binary: {
+            Interval l = visit(expr->left.get());
+            Interval r = visit(expr->right.get());
+            const string& op = expr->op;
+
+            if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=" ||
+                op == "&&" || op == "||") {
+                return Interval::of(0, 1);
+            }
+            if (!isIntegerKind(expr->type.kind) || !l.known || !r.known) {
+                return Interval::unknown();
+            }
+            if (op == "+") return fitI32(l.lo + r.lo, l.hi + r.hi);
+            if (op == "-") return fitI32(l.lo - r.hi, l.hi - r.lo);
+            if (op == "*") return corners(l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi);
+            if (op == "/" || op == "//") {
+                // Truncating division is monotone on each corner once the divisor keeps its sign
+                if (r.lo > 0 || r.hi < 0) {
+                    return corners(l.lo / r.lo, l.lo / r.hi, l.hi / r.lo, l.hi / r.hi);
+                }
+                return Interval::unknown();
+            }
+            if (op == "%") {
+                long long bound = max(llabs(r.lo), llabs(r.hi)) - 1;
+                if (bound < 0) return Interval::unknown();
+                if (l.lo >= 0) return Interval::of(0, min(l.hi, bound));
+                if (l.hi <= 0) return Interval::of(max(l.lo, -bound), 0);
+                return Interval::of(-bound, bound);
+            }
+            return Interval::unknown();
+        }
+
+        case ExprKind::Unary: {
+            Interval operand = visit(expr->left.get());
+            if (expr->op == "!") {
+                return Interval::of(0, 1);
+            }
+            if (expr->op == "-" && operand.known && isIntegerKind(expr->type.kind)) {
+                return fitI32(-operand.hi, -operand.lo);
+            }
+            return Interval::unknown();
+        }
+
+        case ExprKind::ListLiteral: {
+            Interval elements = Interval::unknown();
+            for (size_t i = 0; i < expr->elements.size(); ++i) {
+                Interval range = visit(expr->elements[i].get());
+                elements = i == 0 ? range : hull(elements, range);
+            }
+            if (isIntegerList(expr->type) && elements.known) {
+                TypeKind narrow = narrowestKind(elements);
+                if (widthRank(narrow) < widthRank(expr->type.element->kind)) {
+                    // Built directly into packed storage by the evaluator
+                    expr->type = listType(new Type{narrow});
+                    temporaries++;
+                }
+            }
+            return elements;
+        }
+
+        case ExprKind::MapLiteral:
+            for (size_t i = 0; i < expr->elements.size(); ++i) {
+                visit(expr->elements[i].get());
+                visit(expr->args[i].get());
+            }
+            return Interval::unknown();
+
+        case ExprKind::MethodCall: {
+            Interval object = visit(expr->left.get());
+            const string& method = expr->method_name;
+
+            if (method == "map" || method == "filter" || method == "reduce") {
+                Interval body = Interval::unknown();
+                if (!expr->args.empty()) {
+                    body = visitElementBody(expr->args[0].get(), object, method == "reduce");
+                }
+                if (method == "map") return body;
+                if (method == "filter") return object;
+                return Interval::unknown();
+            }
+
+            for (auto& arg : expr->args) {
+                visit(arg.get());
+            }
+            if (method == "sort") return object;
+            if (method == "len" || method == "count") return Interval::of(0, INT_MAX);
+            if (method == "find") return Interval::of(-1, INT_MAX);
+            if (method == "contains" || method == "startswith" || method == "endswith") {
+                return Interval::of(0, 1);
+            }
+            return Interval::unknown();
+        }
+
+        case ExprKind::StringSlice: {
+            Interval object = visit(expr->left.get());
+            visit(expr->start.get());
+            visit(expr->end.get());
+            // Indexing or slicing a list keeps the element range
+            if (expr->left->type.kind == TypeKind::List) {
+                return object;
+            }
+            return Interval::unknown();
+        }
+
+        case ExprKind::Call: {
+            vector<Interval> args;
+            for (auto& arg : expr->args) {
+                args.push_back(visit(arg.get()));
+            }
+            if (expr->name != "range" || args.empty()) {
+                return Interval::unknown();
+            }
+            Interval start = args.size() == 1 ? Interval::of(0, 0) : args[0];
+            Interval stop = args.size() == 1 ? args[0] : args[1];
+            Interval step = args.size() == 3 ? args[2] : Interval::of(1, 1);
+            if (!start.known || !stop.known || !step.known) {
+                return Interval::unknown();
+            }
+            // Elements lie between start and the last value before stop
+            if (step.lo > 0) return Interval::of(start.lo, max(start.lo, stop.hi - 1));
+            if (step.hi < 0) return Interval::of(min(start.hi, stop.lo + 1), start.hi);
+            return Interval::unknown();
+        }
+    }
+    return Interval::unknown();
+}
+
+void RangeAnalyzer::analyzeStatement(Stmt* stmt) {
+    if (auto letStmt = dynamic_cast<LetStmt*>(stmt)) {
+        // Taken before visiting, which may narrow a list literal's own type
+        Type valueType = letStmt->expr->type;
+        Interval range = visit(letStmt->expr.get());
+
+        if (letStmt->declared_type.kind != TypeKind::Unknown) {
+            // Annotated bindings keep their width; a value outside it wraps
+            const Type& declared = letStmt->declared_type;
+            TypeKind kind = declared.kind == TypeKind::List && declared.element ? declared.element->kind : declared.kind;
+            Interval width = widthRange(kind);
+            if (isIntegerKind(kind)) {
+                ranges[letStmt->name] = within(range, width) ? range : width;
+            } else {
+                ranges.erase(letStmt->name);
+            }
+            return;
+        }
+
+        bool scalar = isIntegerKind(valueType.kind);
+        bool list = isIntegerList(valueType);
+        if (!range.known || (!scalar && !list)) {
+            ranges.erase(letStmt->name);
+            return;
+        }
+        ranges[letStmt->name] = range;
+        // Optimizer temporaries ($licmN, $srN) are re-bound often enough that
+        // converting them would cost more than it saves
+        if (reassigned.count(letStmt->name) || letStmt->name[0] == '$') {
+            return;
+        }
+
+        TypeKind current = scalar ? valueType.kind : valueType.element->kind;
+        TypeKind narrow = narrowestKind(range);
+        if (widthRank(narrow) < widthRank(current)) {
+            letStmt->storage_type = scalar ? Type{narrow} : listType(new Type{narrow});
+            narrowed.push_back({letStmt->line, letStmt->name, valueType, letStmt->storage_type, range});
+        }
+    } else if (auto printStmt = dynamic_cast<PrintStmt*>(stmt)) {
+        visit(printStmt->expr.get());
+    } else if (auto assignStmt = dynamic_cast<AssignStmt*>(stmt)) {
+        Interval range = visit(assignStmt->expr.get());
+        Interval width = widthRange(assignStmt->target_type.kind);
+        if (width.known) {
+            ranges[assignStmt->name] = within(range, width) ? range : width;
+        } else {
+            ranges.erase(assignStmt->name);
+        }
+    } else if (auto whileStmt = dynamic_cast<WhileStmt*>(stmt)) {
+        // Anything the body rebinds can hold any value on any iteration
+        forgetAssigned(whileStmt->body);
+        visit(whileStmt->condition.get());
+        analyzeBlock(whileStmt->body);
+        forgetAssigned(whileStmt->body);
+    } else if (auto forStmt = dynamic_cast<ForStmt*>(stmt)) {
+        Interval element = visit(forStmt->iterable.get());
+        forgetAssigned(forStmt->body);
+        if (element.known) {
+            ranges[forStmt->var] = element;
+        } else {
+            ranges.erase(forStmt->var);
+        }
+        analyzeBlock(forStmt->body);
+        forgetAssigned(forStmt->body);
+    } else if (auto exprStmt = dynamic_cast<ExprStmt*>(stmt)) {
+        visit(exprStmt->expr.get());
+    } else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt)) {
+        visit(ifStmt->condition.get());
+        auto before = ranges;
+        analyzeBlock(ifStmt->then_body);
+        auto afterThen = std::move(ranges);
+        ranges = std::move(before);
+        analyzeBlock(ifStmt->else_body);
+
+        // A binding is only known after the if when both branches agree on a bound
+        for (auto it = ranges.begin(); it != ranges.end();) {
+            auto other = afterThen.find(it->first);
+            Interval joined = other != afterThen.end() ? hull(it->second, other->second) : Interval::unknown();
+            if (joined.known) {
+                it->second = joined;
+                ++it;
+            } else {
+                it = ranges.erase(it);
+            }
+        }
+    }
+}
+
+void RangeAnalyzer::analyzeBlock(const vector<unique_ptr<Stmt>>& body) {
+    for (const auto& stmt : body) {
+        analyzeStatement(stmt.get());
+    }
+}
+
+void RangeAnalyzer::forgetAssigned(const vector<unique_ptr<Stmt>>& body) {
+    unordered_set<Interned> names;
+    collectAssignedNames(body, names);
+    for (const auto& name : names) {
+        ranges.erase(name);
+    }
+}
+
+void RangeAnalyzer::analyze(const vector<unique_ptr<Stmt>>& program) {
+    // Function bodies are not analyzed, but the globals they assign are
+    // never narrowed or trusted
+    for (const auto& stmt : program) {
+        if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+            collectAssignTargets(fn->body, functionWrites);
+        }
+    }
+    reassigned = functionWrites;
+    collectAssignTargets(program, reassigned);
+    analyzeBlock(program);
+}
+
+void RangeAnalyzer::printReport(ostream& out) const {
+    out << "range analysis: narrowed " << narrowed.size() << " binding(s), "
+        << temporaries << " list literal(s) built packed\n";
+    for (const auto& entry : narrowed) {
+        out << "  line " << entry.line << ": " << entry.name << " " << typeToString(entry.from)
+            << " -> " << typeToString(entry.to) << " (values in [" << entry.range.lo << ", "
+            << entry.range.hi << "])\n";
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef RANGE_ANALYSIS_H
+#define RANGE_ANALYSIS_H
+
+#include "../parser/ast.h"
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Closed interval of integer values; `known` is false when nothing is proven
+struct Interval {
+    bool known = false;
+    long long lo = 0;
+    long long hi = 0;
+
+    static Interval of(long long lo, long long hi) { return {true, lo, hi}; }
+    static Interval unknown() { return {}; }
+};
+
+struct Narrowing {
+    int line;
+    std::string name;
+    Type from;
+    Type to;
+    Interval range;
+};
+
+// Proves bounds on integer bindings of an analyzed program and gives
+// un-annotated integer lets and list literals the narrowest width (i8/i16)
+// that holds every value they can take. Must run after SemanticAnalyzer,
+// since it relies on the types recorded on expressions.
+class RangeAnalyzer {
+public:
+    void analyze(const std::vector<std::unique_ptr<Stmt>>& program);
+    void analyzeStatement(Stmt* stmt);
+
+    const std::vector<Narrowing>& narrowings() const { return narrowed; }
+    size_t packedLiterals() const { return temporaries; }
+    void printReport(std::ostream& out) const;
+
+private:
+    // Scalars map to their value range, lists to the range of their elements
+    std::unordered_map<Interned, Interval> ranges;
+    std::vector<Narrowing> narrowed;
+    size_t temporaries = 0;
+    // Bindings assigned somewhere in the program keep their inferred width
+    std::unordered_set<Interned> reassigned;
+    // Globals assigned inside function bodies
+    std::unordered_set<Interned> functionWrites;
+
+    Interval visit(Expr* expr);
+    void analyzeBlock(const std::vector<std::unique_ptr<Stmt>>& body);
+    void forgetAssigned(const std::vector<std::unique_ptr<Stmt>>& body);
+    Interval visitElementBody(Expr* body, const Interval& element, bool withAccumulator);
+};
+
+#endif
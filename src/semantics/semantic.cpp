@@ -1,4 +1,6 @@
 #include "semantic.h"
+#include "../runtime/mapped_file.h"
+#include "../util/diagnostics.h"
 #include <stdexcept>
 #include <map>
 
@@ -11,12 +13,22 @@ std::string typeToString(const Type& t) {
         case TypeKind::I64: return "i64";
         case TypeKind::F32: return "f32";
         case TypeKind::F64: return "f64";
+        case TypeKind::F16: return "f16";
+        case TypeKind::BF16: return "bf16";
+        case TypeKind::Q8: return "q8";
         case TypeKind::String: return "string";
         case TypeKind::List:
             if (t.element) {
                 return "list<" + typeToString(*t.element) + ">";
             }
             return "list<unknown>"; // Should not happen if well-formed
+        case TypeKind::Map:
+            if (t.key && t.element && t.key->kind != TypeKind::Unknown) {
+                return "map<" + typeToString(*t.key) + ", " + typeToString(*t.element) + ">";
+            }
+            return "map<unknown>"; // An empty literal, typed by its binding
+        case TypeKind::Future:
+            return "future<" + (t.element ? typeToString(*t.element) : string("unknown")) + ">";
         default: return "unknown";
     }
 }
@@ -24,6 +36,18 @@ std::string typeToString(const Type& t) {
 // Helper to check type compatibility
 bool isCompatible(const Type& t1, const Type& t2) {
     if (t1.kind == t2.kind) {
+        // A future's value is typed when the transfer starts and can't be
+        // converted afterwards
+        if (t1.kind == TypeKind::Future) return sameType(t1, t2);
+        if (t1.kind == TypeKind::Map) {
+            if (!t1.key || !t2.key || !t1.element || !t2.element) return false;
+            // An empty literal takes the type of whatever it is bound to
+            if (t1.key->kind == TypeKind::Unknown || t2.key->kind == TypeKind::Unknown) return true;
+            // Integer keys are all stored as 64 bits, so any width finds the same entry
+            bool keysMatch = t1.key->kind == t2.key->kind ||
+                             (isIntegerKind(t1.key->kind) && isIntegerKind(t2.key->kind));
+            return keysMatch && isCompatible(*t1.element, *t2.element);
+        }
         if (t1.kind == TypeKind::List) {
             if (!t1.element || !t2.element) return false; // Should not happen if types are well-formed
             return isCompatible(*t1.element, *t2.element);
@@ -31,64 +55,356 @@ bool isCompatible(const Type& t1, const Type& t2) {
         return true;
     }
 
-    // Implicit conversions (e.g., i8 to i32, i32 to f64)
-    if ((t1.kind == TypeKind::I8 || t1.kind == TypeKind::I16 || t1.kind == TypeKind::I32 || t1.kind == TypeKind::I64) &&
-        (t2.kind == TypeKind::I8 || t2.kind == TypeKind::I16 || t2.kind == TypeKind::I32 || t2.kind == TypeKind::I64)) {
-        return true; // All integer types are compatible with each other for now
+    // Implicit conversions (e.g., i8 to i32, i32 to f64, f32 to f16, f32 to q8)
+    if (isNumericKind(t1.kind) && isNumericKind(t2.kind)) {
+        return true; // All numeric types convert to each other for now
     }
-    if ((t1.kind == TypeKind::F32 || t1.kind == TypeKind::F64) &&
-        (t2.kind == TypeKind::F32 || t2.kind == TypeKind::F64)) {
-        return true; // All float types are compatible
+
+    return false;
+}
+
+bool sameType(const Type& a, const Type& b) {
+    if (a.kind != b.kind) return false;
+    if (a.kind == TypeKind::Map) {
+        return a.key && b.key && a.element && b.element && sameType(*a.key, *b.key) &&
+               sameType(*a.element, *b.element);
     }
-    if ((t1.kind == TypeKind::I8 || t1.kind == TypeKind::I16 || t1.kind == TypeKind::I32 || t1.kind == TypeKind::I64) &&
-        (t2.kind == TypeKind::F32 || t2.kind == TypeKind::F64)) {
-        return true; // Int to float conversion
+    if (a.kind == TypeKind::List || a.kind == TypeKind::Future) {
+        return a.element && b.element && sameType(*a.element, *b.element);
     }
-    if ((t2.kind == TypeKind::I8 || t2.kind == TypeKind::I16 || t2.kind == TypeKind::I32 || t2.kind == TypeKind::I64) &&
-        (t1.kind == TypeKind::F32 || t1.kind == TypeKind::F64)) {
-        return true; // Int to float conversion
+    if (a.kind == TypeKind::Q8) {
+        return a.scale == b.scale && a.zero_point == b.zero_point;
     }
+    return true;
+}
 
-    return false;
+// Symbol carrying only the type of a binding; values are the evaluator's job
+static Symbol bindingSymbol(const string& name, const Type& type) {
+    Symbol sym;
+    sym.name = name;
+    sym.type = type;
+    sym.int_value = 0;
+    sym.double_value = 0;
+    return sym;
 }
 
 // Helper for reporting errors
 void SemanticAnalyzer::error(const std::string& message, int line, int column) {
-    std::cerr << "Semantic Error at line " << line << ", column " << column << ": " << message << std::endl;
-    exit(1);
+    compileError("Semantic Error at line " + std::to_string(line) + ", column " + std::to_string(column) + ": " +
+                 message);
 }
 
 // Main analysis function
 void SemanticAnalyzer::analyze(const std::vector<std::unique_ptr<Stmt>>& program) {
+    // Functions may be called before their declaration, e.g. by each other
     for (const auto& stmt : program) {
-        if (auto letStmt = dynamic_cast<const LetStmt*>(stmt.get())) {
-            Type exprType = analyzeExpr(letStmt->expr.get());
+        if (auto fn = dynamic_cast<const FunctionDecl*>(stmt.get())) {
+            declareFunction(fn);
+        }
+    }
+    for (const auto& stmt : program) {
+        analyzeStatement(stmt.get());
+    }
+}
 
-            // Determine the actual type to store in the symbol table
-            Type actualStoredType;
-            // If a type was explicitly declared (i.e., not the default unknownType() from constructor)
-            bool typeExplicitlyDeclared = (letStmt->declared_type.kind != TypeKind::Unknown);
+void SemanticAnalyzer::analyzeBlock(const std::vector<std::unique_ptr<Stmt>>& body) {
+    blockDepth++;
+    for (const auto& stmt : body) {
+        analyzeStatement(stmt.get());
+    }
+    blockDepth--;
+}
 
-            if (typeExplicitlyDeclared) {
-                if (!isCompatible(letStmt->declared_type, exprType)) {
-                    error("Type mismatch in variable declaration. Expected " + 
-                          typeToString(letStmt->declared_type) + ", got " + 
-                          typeToString(exprType), letStmt->expr->line, letStmt->expr->column);
-                }
-                actualStoredType = letStmt->declared_type;
-            } else {
-                // No explicit type, infer from expression
-                actualStoredType = exprType;
+void SemanticAnalyzer::declareFunction(const FunctionDecl* fn) {
+    auto found = functions.find(fn->name);
+    if (found != functions.end() && found->second != fn) {
+        error("Function " + fn->name + " is already declared", fn->line, fn->column);
+    }
+    if (fn->name == "range" || isDataBuiltin(fn->name)) {
+        error("Cannot redefine builtin function " + fn->name, fn->line, fn->column);
+    }
+    functions[fn->name] = fn;
+}
+
+// Parameters and lets of a function live in their own scope over the globals
+void SemanticAnalyzer::analyzeFunction(const FunctionDecl* fn) {
+    if (currentFunction || blockDepth > 0) {
+        error("Functions must be declared at the top level", fn->line, fn->column);
+    }
+    declareFunction(fn);
+
+    SymbolTable local(&symbols);
+    for (size_t i = 0; i < fn->params.size(); ++i) {
+        const Param& param = fn->params[i];
+        for (size_t j = 0; j < i; ++j) {
+            if (fn->params[j].name == param.name) {
+                error("Duplicate parameter " + param.name + " in " + fn->name, fn->line, fn->column);
+            }
+        }
+        checkNotConstant(param.name, fn->line, fn->column);
+        local.set(param.name, bindingSymbol(param.name, param.type));
+    }
+
+    SymbolTable* outer = scope;
+    scope = &local;
+    currentFunction = fn;
+    analyzeBlock(fn->body);
+    currentFunction = nullptr;
+    scope = outer;
+}
+
+void SemanticAnalyzer::checkNotConstant(const std::string& name, int line, int column) {
+    if (constants.count(name)) {
+        error("Cannot redeclare constant " + name, line, column);
+    }
+}
+
+void SemanticAnalyzer::analyzeCondition(const Expr* condition) {
+    Type conditionType = analyzeExpr(condition);
+    if (!isNumericKind(conditionType.kind)) {
+        error("Condition must be numeric, got " + typeToString(conditionType), condition->line, condition->column);
+    }
+}
+
+void SemanticAnalyzer::analyzeStatement(const Stmt* stmt) {
+    if (auto letStmt = dynamic_cast<const LetStmt*>(stmt)) {
+        if (letStmt->constant && (currentFunction || blockDepth > 0)) {
+            error("const " + letStmt->name + " must be declared at the top level", stmt->line, stmt->column);
+        }
+        checkNotConstant(letStmt->name, stmt->line, stmt->column);
+        // Code before it may have assigned the variable it would replace
+        if (letStmt->constant && scope->exists(letStmt->name)) {
+            error("const " + letStmt->name + " redeclares a variable", stmt->line, stmt->column);
+        }
+        Type exprType = analyzeExpr(letStmt->expr.get());
+
+        // Determine the actual type to store in the symbol table
+        Type actualStoredType;
+        // If a type was explicitly declared (i.e., not the default unknownType() from constructor)
+        bool typeExplicitlyDeclared = (letStmt->declared_type.kind != TypeKind::Unknown);
+
+        if (typeExplicitlyDeclared) {
+            if (!isCompatible(letStmt->declared_type, exprType)) {
+                error("Type mismatch in variable declaration. Expected " + 
+                      typeToString(letStmt->declared_type) + ", got " + 
+                      typeToString(exprType), letStmt->expr->line, letStmt->expr->column);
+            }
+            actualStoredType = letStmt->declared_type;
+        } else {
+            // No explicit type, infer from expression
+            if (exprType.kind == TypeKind::Map && exprType.key && exprType.key->kind == TypeKind::Unknown) {
+                error("An empty map needs a declared type, such as let " + letStmt->name +
+                      ": map[string, i32] = {}", letStmt->expr->line, letStmt->expr->column);
             }
-            // Store the type in the symbol table
-            symbols.set(letStmt->name, Symbol{letStmt->name, actualStoredType, 0, 0, "", std::vector<Symbol>()});
-        } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt.get())) {
-            analyzeExpr(printStmt->expr.get()); // Just analyze for type correctness
+            actualStoredType = exprType;
+        }
+        // Store the type in the symbol table
+        scope->set(letStmt->name, bindingSymbol(letStmt->name, actualStoredType));
+        if (letStmt->constant) {
+            constants.insert(letStmt->name);
+        }
+    } else if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt)) {
+        analyzeExpr(printStmt->expr.get()); // Just analyze for type correctness
+    } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt)) {
+        if (!scope->exists(assignStmt->name)) {
+            error("Assignment to undeclared variable: " + assignStmt->name, stmt->line, stmt->column);
         }
-        // Add other statement types here
+        if (constants.count(assignStmt->name)) {
+            error("Cannot assign to constant " + assignStmt->name, stmt->line, stmt->column);
+        }
+        Type targetType = scope->get(assignStmt->name).type;
+        Type exprType = analyzeExpr(assignStmt->expr.get());
+        if (!isCompatible(targetType, exprType)) {
+            error("Type mismatch in assignment to " + assignStmt->name + ". Expected " +
+                  typeToString(targetType) + ", got " + typeToString(exprType),
+                  assignStmt->expr->line, assignStmt->expr->column);
+        }
+        const_cast<AssignStmt*>(assignStmt)->target_type = targetType;
+    } else if (auto whileStmt = dynamic_cast<const WhileStmt*>(stmt)) {
+        analyzeCondition(whileStmt->condition.get());
+        analyzeBlock(whileStmt->body);
+    } else if (auto forStmt = dynamic_cast<const ForStmt*>(stmt)) {
+        Type iterableType = analyzeExpr(forStmt->iterable.get());
+        if (iterableType.kind != TypeKind::List || !iterableType.element) {
+            error("for expects a list to iterate over, got " + typeToString(iterableType),
+                  forStmt->iterable->line, forStmt->iterable->column);
+        }
+        checkNotConstant(forStmt->var, stmt->line, stmt->column);
+        scope->set(forStmt->var, bindingSymbol(forStmt->var, *iterableType.element));
+        analyzeBlock(forStmt->body);
+    } else if (auto ifStmt = dynamic_cast<const IfStmt*>(stmt)) {
+        analyzeCondition(ifStmt->condition.get());
+        analyzeBlock(ifStmt->then_body);
+        analyzeBlock(ifStmt->else_body);
+    } else if (auto fn = dynamic_cast<const FunctionDecl*>(stmt)) {
+        analyzeFunction(fn);
+    } else if (auto returnStmt = dynamic_cast<const ReturnStmt*>(stmt)) {
+        analyzeReturn(returnStmt);
+    } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt)) {
+        voidCallAllowed = true;
+        analyzeExpr(exprStmt->expr.get());
+        voidCallAllowed = false;
     }
 }
 
+void SemanticAnalyzer::analyzeReturn(const ReturnStmt* stmt) {
+    if (!currentFunction) {
+        error("return outside of a function", stmt->line, stmt->column);
+    }
+    const Type& expected = currentFunction->return_type;
+    auto returnStmt = const_cast<ReturnStmt*>(stmt);
+    returnStmt->return_type = expected;
+
+    if (!stmt->expr) {
+        if (expected.kind != TypeKind::Unknown) {
+            error(currentFunction->name + " must return " + typeToString(expected), stmt->line, stmt->column);
+        }
+        return;
+    }
+    if (expected.kind == TypeKind::Unknown) {
+        error(currentFunction->name + " does not return a value", stmt->expr->line, stmt->expr->column);
+    }
+    Type actual = analyzeExpr(stmt->expr.get());
+    if (!isCompatible(expected, actual)) {
+        error("Type mismatch in return from " + currentFunction->name + ". Expected " +
+              typeToString(expected) + ", got " + typeToString(actual), stmt->expr->line, stmt->expr->column);
+    }
+
+    // The callee's result already has our return type, so no conversion is
+    // lost by returning it straight from the callee's frame
+    const Expr* value = stmt->expr.get();
+    returnStmt->tail_call = value->kind == ExprKind::Call && value->function &&
+                            sameType(value->function->return_type, expected);
+}
+
+// Bodies of map/filter/reduce see the current element as `it` and, for
+// reduce, the running value as `acc`
+Type SemanticAnalyzer::analyzeElementBody(const Expr* body, const Type& element, bool withAccumulator) {
+    SymbolTable local(scope);
+    local.set("it", bindingSymbol("it", element));
+    if (withAccumulator) {
+        local.set("acc", bindingSymbol("acc", element));
+    }
+
+    SymbolTable* outer = scope;
+    scope = &local;
+    Type result = analyzeExpr(body);
+    scope = outer;
+    return result;
+}
+
+void SemanticAnalyzer::checkMapKey(const Type& map, const Type& key, const Expr* where) {
+    if (map.key->kind == TypeKind::Unknown) {
+        error("Cannot look up a key in an empty map literal", where->line, where->column);
+    }
+    bool matches = map.key->kind == TypeKind::String ? key.kind == TypeKind::String : isIntegerKind(key.kind);
+    if (!matches) {
+        error("Key of " + typeToString(map) + " must be " + typeToString(*map.key) + ", got " + typeToString(key),
+              where->line, where->column);
+    }
+}
+
+// Maps are values like lists: set and remove give a changed copy, which
+// `m = m.set(k, v)` makes in place
+Type SemanticAnalyzer::analyzeMapMethod(const Expr* expr, const Type& map, const vector<Type>& argTypes) {
+    const string& method = expr->method_name;
+    if (map.key->kind == TypeKind::Unknown) {
+        error("Cannot call " + method + " on an empty map literal; bind it with a declared type first", expr->line,
+              expr->column);
+    }
+    size_t expected = 0;
+    if (method == "len" || method == "keys" || method == "values") {
+        expected = 0;
+    } else if (method == "has" || method == "remove") {
+        expected = 1;
+    } else if (method == "get" || method == "set") {
+        expected = 2;
+    } else {
+        error("Unknown map method " + method + "; maps have len, has, get, set, remove, keys and values",
+              expr->line, expr->column);
+    }
+    if (argTypes.size() != expected) {
+        error(method + " expects " + to_string(expected) + " argument(s), got " + to_string(argTypes.size()),
+              expr->line, expr->column);
+    }
+    if (expected > 0) {
+        checkMapKey(map, argTypes[0], expr->args[0].get());
+    }
+    if (expected == 2 && !isCompatible(*map.element, argTypes[1])) {
+        error(method + " expects a value of type " + typeToString(*map.element) + ", got " +
+              typeToString(argTypes[1]), expr->args[1]->line, expr->args[1]->column);
+    }
+
+    if (method == "len" || method == "has") return i32Type();
+    if (method == "get") return *map.element;
+    if (method == "keys") return listType(new Type(*map.key));
+    if (method == "values") return listType(new Type(*map.element));
+    return map;
+}
+
+// The element type is a string literal, since the list's type must be known
+// before the file is read
+Type SemanticAnalyzer::analyzeDataBuiltin(const Expr* expr, const vector<Type>& argTypes) {
+    const string& name = expr->name;
+    if (name == "await") {
+        if (argTypes.size() != 1 || argTypes[0].kind != TypeKind::Future || !argTypes[0].element) {
+            error("await expects one future, got " +
+                  (argTypes.size() == 1 ? typeToString(argTypes[0]) : to_string(argTypes.size()) + " arguments"),
+                  expr->line, expr->column);
+        }
+        return *argTypes[0].element;
+    }
+    size_t expected = name == "load_shape" ? 1 : name == "read_csv" ? 3 : 2;
+    if (argTypes.size() != expected) {
+        error(name + " expects " + to_string(expected) + " argument(s), got " + to_string(argTypes.size()),
+              expr->line, expr->column);
+    }
+    if (argTypes[0].kind != TypeKind::String) {
+        error(name + " expects a file path, got " + typeToString(argTypes[0]), expr->args[0]->line,
+              expr->args[0]->column);
+    }
+    if (name == "load_shape") {
+        return listType(new Type(i32Type()));
+    }
+    if (name == "write_async") {
+        // Strings are written as their bytes, numeric lists packed at their
+        // element type's width. Awaiting gives the length written, as len()
+        // would count it.
+        const Type& data = argTypes[1];
+        bool numericList = data.kind == TypeKind::List && data.element && isNumericKind(data.element->kind) &&
+                           data.element->kind != TypeKind::Q8;
+        if (data.kind != TypeKind::String && !numericList) {
+            error("write_async expects a string or a numeric list to write, got " + typeToString(data),
+                  expr->args[1]->line, expr->args[1]->column);
+        }
+        return futureType(new Type(i32Type()));
+    }
+    if (name == "read_csv" && !isIntegerKind(argTypes[1].kind) && argTypes[1].kind != TypeKind::String) {
+        error("read_csv expects a column index or name, got " + typeToString(argTypes[1]), expr->args[1]->line,
+              expr->args[1]->column);
+    }
+
+    const Expr* typeName = expr->args.back().get();
+    Type element;
+    if (typeName->kind != ExprKind::StringLiteral) {
+        error(name + " expects the element type as a string literal such as \"f32\"", typeName->line,
+              typeName->column);
+    }
+    if (name == "read_async" && typeName->string_value == "string") {
+        return futureType(new Type(stringType()));
+    }
+    if (name == "read_csv" && typeName->string_value == "string") {
+        element = stringType();
+    } else if (!elementTypeNamed(typeName->string_value, element)) {
+        error("Unknown element type \"" + typeName->string_value + "\" for " + name, typeName->line,
+              typeName->column);
+    }
+    if (name == "read_async") {
+        return futureType(new Type(listType(new Type(element))));
+    }
+    return listType(new Type(element));
+}
+
 // Expression analysis
 Type SemanticAnalyzer::analyzeExpr(const Expr* expr) {
     if (!expr) {
@@ -103,13 +419,13 @@ Type SemanticAnalyzer::analyzeExpr(const Expr* expr) {
         
         case ExprKind::Identifier: {
             // Look up identifier in symbol table
-            if (!symbols.exists(expr->string_value)) {
-                error("Undeclared identifier: " + expr->string_value, expr->line, expr->column);
+            if (!scope->exists(expr->name)) {
+                error("Undeclared identifier: " + expr->name, expr->line, expr->column);
             }
             // Assign the type from the symbol table to the expression node
             // Note: This modifies the AST during semantic analysis
-            const_cast<Expr*>(expr)->type = symbols.get(expr->string_value).type;
-            return symbols.get(expr->string_value).type;
+            const_cast<Expr*>(expr)->type = scope->get(expr->name).type;
+            return scope->get(expr->name).type;
         }
         
         case ExprKind::Binary: {
@@ -118,12 +434,21 @@ Type SemanticAnalyzer::analyzeExpr(const Expr* expr) {
 
             // Determine result type and check compatibility based on operator
             if (expr->op == "+" || expr->op == "-" || expr->op == "*" || expr->op == "/" || expr->op == "%" || expr->op == "//") {
-                if (isCompatible(leftType, rightType)) {
+                // Concatenation and repetition, e.g. "ab" + s and "-" * 3
+                bool concat = expr->op == "+" && leftType.kind == TypeKind::String && rightType.kind == TypeKind::String;
+                bool repeat = expr->op == "*" && leftType.kind == TypeKind::String && isIntegerKind(rightType.kind);
+                if (concat || repeat) {
+                    const_cast<Expr*>(expr)->type = stringType();
+                    return stringType();
+                }
+                if (isCompatible(leftType, rightType) && isNumericKind(leftType.kind)) {
                     // Promote type if necessary (e.g., i32 + f64 = f64)
                     if (leftType.kind == TypeKind::F64 || rightType.kind == TypeKind::F64) {
                         const_cast<Expr*>(expr)->type = f64Type();
                         return f64Type();
-                    } else if (leftType.kind == TypeKind::F32 || rightType.kind == TypeKind::F32) {
+                    } else if (isFloatKind(leftType.kind) || isFloatKind(rightType.kind) ||
+                               leftType.kind == TypeKind::Q8 || rightType.kind == TypeKind::Q8) {
+                        // f32, half precision and quantized operands are computed in f32
                         const_cast<Expr*>(expr)->type = f32Type();
                         return f32Type();
                     } else {
@@ -162,8 +487,11 @@ Type SemanticAnalyzer::analyzeExpr(const Expr* expr) {
         case ExprKind::Unary: {
             Type operandType = analyzeExpr(expr->left.get());
             if (expr->op == "-" || expr->op == "!") {
-                if ((operandType.kind == TypeKind::I32 || operandType.kind == TypeKind::I8 || operandType.kind == TypeKind::I16) || 
-                    (operandType.kind == TypeKind::F32 || operandType.kind == TypeKind::F64)) {
+                if (operandType.kind == TypeKind::Q8) {
+                    const_cast<Expr*>(expr)->type = f32Type(); // Quantized values are dequantized first
+                    return f32Type();
+                }
+                if (isNumericKind(operandType.kind)) {
                     const_cast<Expr*>(expr)->type = operandType; // Unary - preserves type
                     return operandType;
                 } else {
@@ -195,11 +523,219 @@ Type SemanticAnalyzer::analyzeExpr(const Expr* expr) {
             return listType(new Type(firstElementType));
         }
 
-        case ExprKind::StringSlice:
-        case ExprKind::MethodCall:
-            // Need to implement type checking for these
-            // For now, assume they return string or i32
-            return stringType(); // Placeholder
+        case ExprKind::MapLiteral: {
+            if (expr->elements.empty()) {
+                Type result = mapType(new Type(unknownType()), new Type(unknownType()));
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+            Type keyType = analyzeExpr(expr->elements[0].get());
+            Type valueType = analyzeExpr(expr->args[0].get());
+            if (keyType.kind != TypeKind::String && !isIntegerKind(keyType.kind)) {
+                error("Map keys must be strings or integers, got " + typeToString(keyType),
+                      expr->elements[0]->line, expr->elements[0]->column);
+            }
+            for (size_t i = 1; i < expr->elements.size(); ++i) {
+                Type currentKey = analyzeExpr(expr->elements[i].get());
+                Type currentValue = analyzeExpr(expr->args[i].get());
+                if (!isCompatible(keyType, currentKey) || !isCompatible(valueType, currentValue)) {
+                    error("Map entries must be of compatible types. Expected " + typeToString(keyType) + ": " +
+                          typeToString(valueType) + ", got " + typeToString(currentKey) + ": " +
+                          typeToString(currentValue), expr->elements[i]->line, expr->elements[i]->column);
+                }
+            }
+            Type result = mapType(new Type(keyType), new Type(valueType));
+            const_cast<Expr*>(expr)->type = result;
+            return result;
+        }
+
+        case ExprKind::MethodCall: {
+            Type objectType = analyzeExpr(expr->left.get());
+            const string& method = expr->method_name;
+
+            if (objectType.kind == TypeKind::Map) {
+                vector<Type> argTypes;
+                for (const auto& arg : expr->args) {
+                    argTypes.push_back(analyzeExpr(arg.get()));
+                }
+                Type result = analyzeMapMethod(expr, objectType, argTypes);
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+
+            if (method == "map" || method == "filter" || method == "reduce") {
+                if (objectType.kind != TypeKind::List || !objectType.element) {
+                    error(method + " expects a list, got " + typeToString(objectType), expr->line, expr->column);
+                }
+                if (expr->args.size() != 1) {
+                    error(method + " expects one expression argument", expr->line, expr->column);
+                }
+                Type element = *objectType.element;
+                Type bodyType = analyzeElementBody(expr->args[0].get(), element, method == "reduce");
+
+                Type result;
+                if (method == "map") {
+                    result = listType(new Type(bodyType));
+                } else if (method == "filter") {
+                    if (!isNumericKind(bodyType.kind)) {
+                        error("filter condition must be numeric, got " + typeToString(bodyType),
+                              expr->args[0]->line, expr->args[0]->column);
+                    }
+                    result = objectType;
+                } else {
+                    if (!isCompatible(element, bodyType)) {
+                        error("reduce expression must produce " + typeToString(element) + ", got " +
+                              typeToString(bodyType), expr->args[0]->line, expr->args[0]->column);
+                    }
+                    result = element;
+                }
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+
+            if (method == "sum" || method == "sort") {
+                if (objectType.kind != TypeKind::List || !objectType.element) {
+                    error(method + " expects a list, got " + typeToString(objectType), expr->line, expr->column);
+                }
+                TypeKind elementKind = objectType.element->kind;
+                if (method == "sum" && !isNumericKind(elementKind)) {
+                    error("sum expects a list of numbers, got " + typeToString(objectType), expr->line, expr->column);
+                }
+                if (method == "sort" && !isNumericKind(elementKind) && elementKind != TypeKind::String) {
+                    error("sort expects a list of numbers or strings, got " + typeToString(objectType),
+                          expr->line, expr->column);
+                }
+                Type result = objectType;
+                if (method == "sum") {
+                    result = isIntegerKind(elementKind) ? i32Type() : f64Type();
+                }
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+
+            vector<Type> argTypes;
+            for (const auto& arg : expr->args) {
+                argTypes.push_back(analyzeExpr(arg.get()));
+            }
+
+            Type result = stringType();
+            if (expr->method_name == "dot") {
+                bool numericList = objectType.kind == TypeKind::List && objectType.element &&
+                                   isNumericKind(objectType.element->kind);
+                bool numericArg = argTypes.size() == 1 && argTypes[0].kind == TypeKind::List &&
+                                  argTypes[0].element && isNumericKind(argTypes[0].element->kind);
+                if (!numericList || !numericArg) {
+                    error("dot expects two lists of numbers, got " + typeToString(objectType) +
+                          (argTypes.empty() ? string("") : " and " + typeToString(argTypes[0])),
+                          expr->line, expr->column);
+                }
+                result = f64Type();
+            } else if (method == "split" || method == "find" || method == "count") {
+                if (objectType.kind != TypeKind::String || argTypes.size() != 1 ||
+                    argTypes[0].kind != TypeKind::String) {
+                    error(method + " expects a string argument on a string", expr->line, expr->column);
+                }
+                result = method == "split" ? listType(new Type(stringType())) : i32Type();
+            } else if (method == "join") {
+                bool stringList = argTypes.size() == 1 && argTypes[0].kind == TypeKind::List && argTypes[0].element &&
+                                  argTypes[0].element->kind == TypeKind::String;
+                if (objectType.kind != TypeKind::String || !stringList) {
+                    error("join expects a separator string and a list of strings", expr->line, expr->column);
+                }
+            } else if (expr->method_name == "len" || expr->method_name == "contains" ||
+                       expr->method_name == "startswith" || expr->method_name == "endswith") {
+                result = i32Type();
+            }
+            const_cast<Expr*>(expr)->type = result;
+            return result;
+        }
+
+        case ExprKind::StringSlice: {
+            Type objectType = analyzeExpr(expr->left.get());
+            if (objectType.kind == TypeKind::Map) {
+                if (!expr->single_index) {
+                    error("Cannot slice a map", expr->line, expr->column);
+                }
+                checkMapKey(objectType, analyzeExpr(expr->start.get()), expr->start.get());
+                const_cast<Expr*>(expr)->type = *objectType.element;
+                return *objectType.element;
+            }
+            vector<const Expr*> bounds = { expr->start.get() };
+            if (!expr->single_index) {
+                bounds.push_back(expr->end.get());
+            }
+            for (const Expr* bound : bounds) {
+                if (!bound) continue;
+                Type boundType = analyzeExpr(bound);
+                if (!isIntegerKind(boundType.kind)) {
+                    error("Index must be an integer, got " + typeToString(boundType), bound->line, bound->column);
+                }
+            }
+
+            Type result = stringType();
+            if (objectType.kind == TypeKind::List && objectType.element) {
+                result = expr->single_index ? *objectType.element : objectType;
+            } else if (objectType.kind != TypeKind::String) {
+                error("Cannot index a value of type " + typeToString(objectType), expr->line, expr->column);
+            }
+            const_cast<Expr*>(expr)->type = result;
+            return result;
+        }
+
+        case ExprKind::Call: {
+            // Only the call of an expression statement may produce no value
+            bool allowVoid = voidCallAllowed;
+            voidCallAllowed = false;
+
+            vector<Type> argTypes;
+            for (const auto& arg : expr->args) {
+                argTypes.push_back(analyzeExpr(arg.get()));
+            }
+
+            if (expr->name == "range") {
+                if (argTypes.empty() || argTypes.size() > 3) {
+                    error("range expects 1 to 3 arguments, got " + to_string(argTypes.size()),
+                          expr->line, expr->column);
+                }
+                for (size_t i = 0; i < argTypes.size(); ++i) {
+                    if (!isIntegerKind(argTypes[i].kind)) {
+                        error("range arguments must be integers, got " + typeToString(argTypes[i]),
+                              expr->args[i]->line, expr->args[i]->column);
+                    }
+                }
+                Type result = listType(new Type(i32Type()));
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+            if (isDataBuiltin(expr->name)) {
+                Type result = analyzeDataBuiltin(expr, argTypes);
+                const_cast<Expr*>(expr)->type = result;
+                return result;
+            }
+
+            auto found = functions.find(expr->name);
+            if (found == functions.end()) {
+                error("Unknown function: " + expr->name, expr->line, expr->column);
+            }
+            const FunctionDecl* fn = found->second;
+            if (argTypes.size() != fn->params.size()) {
+                error(fn->name + " expects " + to_string(fn->params.size()) + " argument(s), got " +
+                      to_string(argTypes.size()), expr->line, expr->column);
+            }
+            for (size_t i = 0; i < argTypes.size(); ++i) {
+                if (!isCompatible(fn->params[i].type, argTypes[i])) {
+                    error("Argument " + fn->params[i].name + " of " + fn->name + " expects " +
+                          typeToString(fn->params[i].type) + ", got " + typeToString(argTypes[i]),
+                          expr->args[i]->line, expr->args[i]->column);
+                }
+            }
+            if (fn->return_type.kind == TypeKind::Unknown && !allowVoid) {
+                error(fn->name + " does not return a value", expr->line, expr->column);
+            }
+            const_cast<Expr*>(expr)->function = fn;
+            const_cast<Expr*>(expr)->type = fn->return_type;
+            return fn->return_type;
+        }
         
         default:
             return i32Type(); // Default or error type
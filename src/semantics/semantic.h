@@ -4,18 +4,45 @@
 #include "../parser/ast.h"
 #include "symbol_table.h"
 #include <vector>
+#include <map>
+#include <unordered_set>
 #include <memory>
 #include <iostream>
 
+std::string typeToString(const Type& t);
+bool isCompatible(const Type& t1, const Type& t2);
+// Identical types, so a value of one needs no conversion to the other
+bool sameType(const Type& a, const Type& b);
+
 class SemanticAnalyzer {
 public:
-    SemanticAnalyzer(SymbolTable& symbols) : symbols(symbols) {}
+    SemanticAnalyzer(SymbolTable& symbols) : symbols(symbols), scope(&symbols) {}
 
     void analyze(const std::vector<std::unique_ptr<Stmt>>& program);
+    void analyzeStatement(const Stmt* stmt);
     Type analyzeExpr(const Expr* expr);
 
 private:
     SymbolTable& symbols;
+    // Innermost scope; differs from symbols inside functions and list builtin bodies
+    SymbolTable* scope;
+    std::map<Interned, const FunctionDecl*> functions;
+    // Names declared with const so far; they can't be assigned or redeclared
+    std::unordered_set<Interned> constants;
+    const FunctionDecl* currentFunction = nullptr;
+    int blockDepth = 0;
+    bool voidCallAllowed = false;
+
+    void analyzeBlock(const std::vector<std::unique_ptr<Stmt>>& body);
+    void analyzeCondition(const Expr* condition);
+    void declareFunction(const FunctionDecl* fn);
+    void analyzeFunction(const FunctionDecl* fn);
+    void analyzeReturn(const ReturnStmt* stmt);
+    void checkNotConstant(const std::string& name, int line, int column);
+    Type analyzeElementBody(const Expr* body, const Type& element, bool withAccumulator);
+    Type analyzeDataBuiltin(const Expr* expr, const std::vector<Type>& argTypes);
+    void checkMapKey(const Type& map, const Type& key, const Expr* where);
+    Type analyzeMapMethod(const Expr* expr, const Type& map, const std::vector<Type>& argTypes);
 
     // Helper for reporting errors
     void error(const std::string& message, int line, int column);
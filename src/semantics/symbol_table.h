@@ -3,40 +3,66 @@
 
 #include <string>
 #include <unordered_map>
+#include <memory>
 #include "types.h"
+#include "../runtime/dense.h"
+#include "../runtime/range.h"
+#include "../runtime/async_io.h"
+#include "../runtime/hash_map.h"
+#include "../util/interner.h"
 using namespace std;
 
+struct Symbol;
+using MapTable = HashMap<Symbol>;
+
 struct Symbol{
     string name;
     Type type;
-    int int_value;
-    double double_value;
+    int int_value = 0;
+    double double_value = 0.0;
     string string_value;
     vector<Symbol> list_values;
+    // Set instead of list_values for lists of numbers stored at their declared width
+    shared_ptr<const DenseArray> dense;
+    // Set instead of list_values for range() results, which are never materialized
+    shared_ptr<const LazyRange> range;
+    // The I/O behind a future
+    shared_ptr<IoRequest> io;
+    // Entries of a map, shared between copies until one of them changes
+    shared_ptr<const MapTable> map;
 };
 
+// A scope may have a parent; lookups that miss fall through to it. Reads
+// never modify the table, so several threads can share a parent scope.
 class SymbolTable {
 public:
-    void set(const string& name, const Symbol& sym){
+    SymbolTable(const SymbolTable* parent = nullptr) : parent(parent) {}
+
+    void set(Interned name, const Symbol& sym){
         table[name] = sym;
     }
     
-    Symbol get(const string& name){
-        if (table.find(name) == table.end()) {
+    Symbol get(Interned name) const {
+        auto it = table.find(name);
+        if (it == table.end()) {
+            if (parent) {
+                return parent->get(name);
+            }
             Symbol empty;
             empty.type = i32Type();
             empty.int_value = 0;
             return empty;
         }
-        return table[name];
+        return it->second;
     }
     
-    bool exists(const string& name){
-        return table.find(name) != table.end();
+    bool exists(Interned name) const {
+        return table.find(name) != table.end() || (parent && parent->exists(name));
     }
 
 private:
-    unordered_map<string, Symbol> table;
+    unordered_map<Interned, Symbol> table;
+    const SymbolTable* parent;
 };
 
 #endif
\ No newline at end of file
@@ -11,14 +11,26 @@ enum class TypeKind {
     I64,
     F32,
     F64,
+    F16,
+    BF16,
+    Q8,
     String,
     List,
+    // Hash map from key to element
+    Map,
+    // Result of an asynchronous read or write, awaited for its value
+    Future,
     Unknown
 };
 
 struct Type{
     TypeKind kind;
     Type* element = nullptr;
+    // Quantization parameters, only meaningful for Q8
+    double scale = 1.0;
+    int zero_point = 0;
+    // Key type, only for Map
+    Type* key = nullptr;
 };
 
 inline Type i8Type(){ return {TypeKind::I8}; }
@@ -27,8 +39,26 @@ inline Type i32Type(){ return {TypeKind::I32}; }
 inline Type i64Type(){ return {TypeKind::I64}; }
 inline Type f32Type(){ return {TypeKind::F32}; }
 inline Type f64Type(){ return {TypeKind::F64}; }
+inline Type f16Type(){ return {TypeKind::F16}; }
+inline Type bf16Type(){ return {TypeKind::BF16}; }
+inline Type q8Type(double scale = 1.0, int zero_point = 0){ return {TypeKind::Q8, nullptr, scale, zero_point}; }
 inline Type stringType(){ return {TypeKind::String}; }
 inline Type listType(Type* element){ return {TypeKind::List, element}; }
+inline Type mapType(Type* key, Type* value){ Type type{TypeKind::Map, value}; type.key = key; return type; }
+inline Type futureType(Type* element){ return {TypeKind::Future, element}; }
 inline Type unknownType(){ return {TypeKind::Unknown}; }
 
+inline bool isIntegerKind(TypeKind kind){
+    return kind == TypeKind::I8 || kind == TypeKind::I16 || kind == TypeKind::I32 || kind == TypeKind::I64;
+}
+
+// Floating point kinds, including the half precision storage formats
+inline bool isFloatKind(TypeKind kind){
+    return kind == TypeKind::F16 || kind == TypeKind::BF16 || kind == TypeKind::F32 || kind == TypeKind::F64;
+}
+
+inline bool isNumericKind(TypeKind kind){
+    return isIntegerKind(kind) || isFloatKind(kind) || kind == TypeKind::Q8;
+}
+
 #endif
\ No newline at end of file
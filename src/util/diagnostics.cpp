@@ -0,0 +1,20 @@
+#include "diagnostics.h"
+
+using namespace std;
+
+void compileError(const string& message) {
+    throw CompileError(message);
+}
+
+void runtimeError(int line, const string& message) {
+    throw RuntimeError("Runtime error at line " + to_string(line) + ": " + message);
+}
+
+void Diagnostics::print(ostream& out) const {
+    for (const string& message : messages) {
+        if (!file.empty()) {
+            out << file << ": ";
+        }
+        out << message << "\n";
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Thrown by the lexer, parser and semantic passes at the first error in a
+// program. what() is the message as glc prints it, e.g.
+// "Parse error at line 3: unexpected token", without a trailing newline.
+class CompileError : public std::runtime_error {
+public:
+    explicit CompileError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Throws CompileError; the front end's only way of stopping on an error, so
+// a driver compiling many files can carry on with the others
+[[noreturn]] void compileError(const std::string& message);
+
+// Thrown by the evaluator when a running program fails, e.g.
+// "Runtime error at line 4: list index 9 out of range for length 3".
+// Worker threads hand it on to the thread that started the work.
+class RuntimeError : public std::runtime_error {
+public:
+    explicit RuntimeError(const std::string& message) : std::runtime_error(message) {}
+};
+
+[[noreturn]] void runtimeError(int line, const std::string& message);
+
+// Messages about one input, collected instead of printed so that inputs
+// compiled concurrently can report in order and without interleaving
+class Diagnostics {
+public:
+    explicit Diagnostics(std::string file = "") : file(std::move(file)) {}
+
+    void error(const std::string& message) {
+        messages.push_back(message);
+        errors++;
+    }
+    void note(const std::string& message) { messages.push_back(message); }
+
+    bool hasErrors() const { return errors > 0; }
+    // One line per message, prefixed with the file name when there is one
+    void print(std::ostream& out) const;
+
+private:
+    std::string file;
+    std::vector<std::string> messages;
+    size_t errors = 0;
+};
+
+#endif
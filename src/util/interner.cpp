@@ -0,0 +1,77 @@
+#include "interner.h"
+#include "../runtime/hash_map.h"
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+
+using namespace std;
+
+// Atoms sit in a deque, which never moves them, so Interned can keep
+// pointers to them
+struct InternTable::Atoms {
+    HashMap<const Interned::Atom*> index;
+    deque<Interned::Atom> atoms;
+};
+
+const Interned::Atom Interned::emptyAtom{string()};
+
+static thread_local InternTable* currentTable = nullptr;
+
+// For names made outside any InternScope, which live until exit. Several
+// threads may add to it, so it takes a lock.
+static InternTable& processTable() {
+    // Never destroyed: Interned values in static storage may outlive it
+    static InternTable& table = *new InternTable;
+    return table;
+}
+
+static mutex processTableLock;
+
+// A thread forking while another holds the lock would leave the child
+// with it locked for good, so fork waits for the lock and both sides
+// release it
+static const int forkHandlers = pthread_atfork([] { processTableLock.lock(); },
+                                               [] { processTableLock.unlock(); },
+                                               [] { processTableLock.unlock(); });
+
+InternTable::InternTable() : atoms(make_unique<Atoms>()) {}
+
+InternTable::~InternTable() = default;
+
+optional<Interned> InternTable::find(string_view text) const {
+    if (text.empty()) return Interned();
+    if (const Interned::Atom* const* found = atoms->index.find(text)) {
+        return Interned(*found);
+    }
+    return nullopt;
+}
+
+const Interned::Atom* InternTable::intern(string_view text) {
+    if (text.empty()) return &Interned::emptyAtom;
+    if (const Interned::Atom* const* found = atoms->index.find(text)) {
+        return *found;
+    }
+    atoms->atoms.push_back(Interned::Atom{string(text)});
+    const Interned::Atom* atom = &atoms->atoms.back();
+    atoms->index.set(text, atom);
+    return atom;
+}
+
+InternScope::InternScope(InternTable& table) : outer(currentTable) {
+    currentTable = &table;
+}
+
+InternScope::~InternScope() {
+    currentTable = outer;
+}
+
+Interned::Interned() : atom(&emptyAtom) {}
+
+Interned::Interned(string_view text) {
+    if (currentTable) {
+        atom = currentTable->intern(text);
+        return;
+    }
+    lock_guard<mutex> guard(processTableLock);
+    atom = processTable().intern(text);
+}
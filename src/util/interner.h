@@ -0,0 +1,108 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+class InternTable;
+
+// A name stored once per InternTable. The parser interns identifiers and
+// the names bound by let, assignment, for and fn, so the AST holds one copy
+// of each distinct name however often it appears, and comparing or hashing
+// two Interned compares or hashes a pointer. Literal text stays a plain
+// string. An Interned lives as long as the table it was added to, which is
+// the one an InternScope made current on this thread, or a process-wide
+// table when there is none.
+class Interned {
+public:
+    // The empty string
+    Interned();
+    Interned(std::string_view text);
+    Interned(const std::string& text) : Interned(std::string_view(text)) {}
+    Interned(const char* text) : Interned(std::string_view(text)) {}
+
+    const std::string& str() const { return atom->text; }
+    operator const std::string&() const { return atom->text; }
+
+    const char* c_str() const { return atom->text.c_str(); }
+    size_t size() const { return atom->text.size(); }
+    size_t length() const { return atom->text.size(); }
+    bool empty() const { return atom->text.empty(); }
+    char operator[](size_t index) const { return atom->text[index]; }
+
+    friend bool operator==(Interned a, Interned b) { return a.atom == b.atom; }
+    friend bool operator!=(Interned a, Interned b) { return a.atom != b.atom; }
+    // Against plain text, which has to be compared as text
+    friend bool operator==(Interned a, const std::string& b) { return a.atom->text == b; }
+    friend bool operator==(const std::string& a, Interned b) { return a == b.atom->text; }
+    friend bool operator==(Interned a, const char* b) { return a.atom->text == b; }
+    friend bool operator!=(Interned a, const std::string& b) { return a.atom->text != b; }
+    friend bool operator!=(const std::string& a, Interned b) { return a != b.atom->text; }
+    friend bool operator!=(Interned a, const char* b) { return a.atom->text != b; }
+    // Orders by text, so sorted output doesn't depend on interning order
+    friend bool operator<(Interned a, Interned b) { return a.atom->text < b.atom->text; }
+
+    friend std::string operator+(const std::string& a, Interned b) { return a + b.atom->text; }
+    friend std::string operator+(const char* a, Interned b) { return a + b.atom->text; }
+    friend std::string operator+(Interned a, const std::string& b) { return a.atom->text + b; }
+    friend std::string operator+(Interned a, const char* b) { return a.atom->text + b; }
+    friend std::ostream& operator<<(std::ostream& out, Interned a) { return out << a.atom->text; }
+
+private:
+    friend struct std::hash<Interned>;
+    friend class InternTable;
+
+    struct Atom {
+        std::string text;
+    };
+    const Atom* atom;
+
+    // Shared by every table, so Interned() equals Interned("") whichever made it
+    static const Atom emptyAtom;
+
+    explicit Interned(const Atom* atom) : atom(atom) {}
+};
+
+// Owns the names interned while it is current. Whatever holds them, usually
+// an AST, must be freed first. Only one thread at a time may add to a table.
+class InternTable {
+public:
+    InternTable();
+    ~InternTable();
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    // The name for text if this table has it, without adding it
+    std::optional<Interned> find(std::string_view text) const;
+
+private:
+    friend class Interned;
+    struct Atoms;
+    std::unique_ptr<Atoms> atoms;
+
+    const Interned::Atom* intern(std::string_view text);
+};
+
+// Makes table the one Interned values made on this thread are added to,
+// until the scope ends
+class InternScope {
+public:
+    explicit InternScope(InternTable& table);
+    ~InternScope();
+    InternScope(const InternScope&) = delete;
+    InternScope& operator=(const InternScope&) = delete;
+
+private:
+    InternTable* outer;
+};
+
+template <>
+struct std::hash<Interned> {
+    size_t operator()(Interned name) const { return std::hash<const void*>()(name.atom); }
+};
+
+#endif
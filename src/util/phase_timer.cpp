@@ -0,0 +1,69 @@
+#include "phase_timer.h"
+#include "../runtime/memory.h"
+#include <iomanip>
+#include <sys/resource.h>
+
+using namespace std;
+
+static uint64_t peakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux
+    return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+PhaseTimer::PhaseTimer() {
+    countAllocations(true);
+}
+
+void PhaseTimer::start(const string& name) {
+    stop();
+    phases.emplace_back();
+    phases.back().name = name;
+    running = true;
+    phaseBytes = allocatedBytes();
+    phaseStart = Clock::now();
+}
+
+void PhaseTimer::stop() {
+    if (!running) return;
+    Phase& phase = phases.back();
+    phase.seconds = chrono::duration<double>(Clock::now() - phaseStart).count();
+    phase.allocatedBytes = allocatedBytes() - phaseBytes;
+    phase.peakRssBytes = peakRss();
+    running = false;
+}
+
+void PhaseTimer::count(const string& name, uint64_t value) {
+    counts.emplace_back(name, value);
+}
+
+void PhaseTimer::printText(ostream& out) const {
+    double total = 0.0;
+    out << left << setw(20) << "phase" << right << setw(12) << "ms" << setw(16) << "allocated" << setw(16)
+        << "peak rss" << "\n";
+    for (const Phase& phase : phases) {
+        total += phase.seconds;
+        out << left << setw(20) << phase.name << right << fixed << setprecision(3) << setw(12)
+            << phase.seconds * 1000 << setw(16) << phase.allocatedBytes << setw(16) << phase.peakRssBytes << "\n";
+    }
+    out << left << setw(20) << "total" << right << setw(12) << total * 1000 << "\n" << defaultfloat;
+    for (const auto& entry : counts) {
+        out << left << setw(20) << entry.first << right << setw(12) << entry.second << "\n";
+    }
+}
+
+void PhaseTimer::printJson(ostream& out) const {
+    out << "{\"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase& phase = phases[i];
+        out << (i ? ", " : "") << "{\"name\": \"" << phase.name << "\", \"seconds\": " << setprecision(9)
+            << phase.seconds << ", \"allocated_bytes\": " << phase.allocatedBytes
+            << ", \"peak_rss_bytes\": " << phase.peakRssBytes << "}";
+    }
+    out << "], \"counts\": {";
+    for (size_t i = 0; i < counts.size(); ++i) {
+        out << (i ? ", " : "") << "\"" << counts[i].first << "\": " << counts[i].second;
+    }
+    out << "}}\n" << setprecision(6);
+}
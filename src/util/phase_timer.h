@@ -0,0 +1,43 @@
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Wall time, allocated bytes and the peak resident set size of each phase
+// of a run, plus counts of what the phases produced. Phases run one after
+// another: starting one ends the one before.
+class PhaseTimer {
+public:
+    PhaseTimer();
+
+    void start(const std::string& name);
+    void stop();
+    void count(const std::string& name, uint64_t value);
+
+    void printText(std::ostream& out) const;
+    void printJson(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name;
+        double seconds = 0.0;
+        uint64_t allocatedBytes = 0;
+        // High-water mark of the whole process when the phase ended
+        uint64_t peakRssBytes = 0;
+    };
+
+    std::vector<Phase> phases;
+    std::vector<std::pair<std::string, uint64_t>> counts;
+    bool running = false;
+    Clock::time_point phaseStart;
+    uint64_t phaseBytes = 0;
+};
+
+#endif